@@ -76,8 +76,11 @@ typedef int16_t lv_coord_t;
 /* LittelvGL's internal memory manager's settings.
  * The graphical objects and other related data are stored here. */
 
+/* 1: use the port's pooled allocator (my_port/my_mem.c, tuned in my_port_conf.h) */
+#define MY_USE_MEM         0
+
 /* 1: use custom malloc/free, 0: use the built-in `lv_mem_alloc` and `lv_mem_free` */
-#define LV_MEM_CUSTOM      0
+#define LV_MEM_CUSTOM      MY_USE_MEM
 #if LV_MEM_CUSTOM == 0
 /* Size of the memory used by `lv_mem_alloc` in bytes (>= 2kB)*/
 #  define LV_MEM_SIZE (256 * 1024)
@@ -92,9 +95,16 @@ typedef int16_t lv_coord_t;
 /* Automatically defrag. on free. Defrag. means joining the adjacent free cells. */
 #  define LV_MEM_AUTO_DEFRAG  1
 #else       /*LV_MEM_CUSTOM*/
-#  define LV_MEM_CUSTOM_INCLUDE <stdlib.h>   /*Header for the dynamic memory function*/
-#  define LV_MEM_CUSTOM_ALLOC   malloc       /*Wrapper to malloc*/
-#  define LV_MEM_CUSTOM_FREE    free         /*Wrapper to free*/
+#  if MY_USE_MEM
+/* `lv_mem_realloc` is alloc + copy + free, LVGL v7 doesn't use a custom realloc */
+#    define LV_MEM_CUSTOM_INCLUDE "my_port/my_mem.h"   /*Header for the dynamic memory function*/
+#    define LV_MEM_CUSTOM_ALLOC   my_mem_alloc       /*Wrapper to malloc*/
+#    define LV_MEM_CUSTOM_FREE    my_mem_free        /*Wrapper to free*/
+#  else
+#    define LV_MEM_CUSTOM_INCLUDE <stdlib.h>   /*Header for the dynamic memory function*/
+#    define LV_MEM_CUSTOM_ALLOC   malloc       /*Wrapper to malloc*/
+#    define LV_MEM_CUSTOM_FREE    free         /*Wrapper to free*/
+#  endif
 #endif     /*LV_MEM_CUSTOM*/
 
 /* Use the standard memcpy and memset instead of LVGL's own functions.
@@ -106,6 +116,7 @@ typedef int16_t lv_coord_t;
 #define LV_ENABLE_GC 0
 #if LV_ENABLE_GC != 0
 #  define LV_GC_INCLUDE "gc.h"                           /*Include Garbage Collector related things*/
+#  undef  LV_MEM_CUSTOM_REALLOC
 #  define LV_MEM_CUSTOM_REALLOC   your_realloc           /*Wrapper to realloc*/
 #  define LV_MEM_CUSTOM_GET_SIZE  your_mem_get_size      /*Wrapper to lv_mem_get_size*/
 #endif /* LV_ENABLE_GC */
@@ -160,8 +171,12 @@ typedef void * lv_anim_user_data_t;
 /* Allow buffering some shadow calculation
  * LV_SHADOW_CACHE_SIZE is the max. shadow size to buffer,
  * where shadow size is `shadow_width + radius`
- * Caching has LV_SHADOW_CACHE_SIZE^2 RAM cost*/
-#define LV_SHADOW_CACHE_SIZE    0
+ * Caching has LV_SHADOW_CACHE_SIZE^2 RAM cost
+ * It's a single entry: only the last shadow's corner is kept, keyed by shadow size and radius.
+ * It helps when objects with the same shadow are drawn after each other (the cards of the
+ * material theme), different shadows in between replace it. 64 covers the cards (4 kB).
+ * Compare the shadow scenes of `make release BENCH=1` with 0 to see the gain on the target. */
+#define LV_SHADOW_CACHE_SIZE    64
 #endif
 
 /*1: enable outline drawing on rectangles*/
@@ -219,7 +234,11 @@ typedef void * lv_fs_drv_user_data_t;
 #define LV_USE_USER_DATA 1
 
 /*1: Show CPU usage and FPS count in the right bottom corner*/
+#if defined(MY_BUILD_PROFILE)
+#define LV_USE_PERF_MONITOR     1
+#else
 #define LV_USE_PERF_MONITOR     0
+#endif
 
 /*1: Use the functions and types from the older API if possible */
 #define LV_USE_API_EXTENSION_V6  1
@@ -340,8 +359,14 @@ typedef void * lv_indev_drv_user_data_t;            /*Type of user data in the i
  *
  * The behavior of asserts can be overwritten by redefining them here.
  * E.g. #define LV_ASSERT_MEM(p)  <my_assert_code>
+ *
+ * `make release` and `make profile` drop the asserts, `make debug` keeps all of them.
  */
+#if defined(MY_BUILD_RELEASE) || defined(MY_BUILD_PROFILE)
+#define LV_USE_DEBUG        0
+#else
 #define LV_USE_DEBUG        1
+#endif
 #if LV_USE_DEBUG
 
 /*Check if the parameter is NULL. (Quite fast) */
@@ -378,9 +403,11 @@ typedef void * lv_indev_drv_user_data_t;            /*Type of user data in the i
  */
 
 /* Montserrat fonts with bpp = 4
- * https://fonts.google.com/specimen/Montserrat  */
-#define LV_FONT_MONTSERRAT_8  1
-#define LV_FONT_MONTSERRAT_10 1
+ * https://fonts.google.com/specimen/Montserrat
+ * Only the sizes used by the themes and the demos are compiled in,
+ * the others can be loaded from files with `my_font_get()` (MY_USE_FONT_LOADER in my_port_conf.h) */
+#define LV_FONT_MONTSERRAT_8  0
+#define LV_FONT_MONTSERRAT_10 0
 #define LV_FONT_MONTSERRAT_12 1
 #define LV_FONT_MONTSERRAT_14 1
 #define LV_FONT_MONTSERRAT_16 1
@@ -388,28 +415,28 @@ typedef void * lv_indev_drv_user_data_t;            /*Type of user data in the i
 #define LV_FONT_MONTSERRAT_20 1
 #define LV_FONT_MONTSERRAT_22 1
 #define LV_FONT_MONTSERRAT_24 1
-#define LV_FONT_MONTSERRAT_26 1
+#define LV_FONT_MONTSERRAT_26 0
 #define LV_FONT_MONTSERRAT_28 1
-#define LV_FONT_MONTSERRAT_30 1
+#define LV_FONT_MONTSERRAT_30 0
 #define LV_FONT_MONTSERRAT_32 1
-#define LV_FONT_MONTSERRAT_34 1
-#define LV_FONT_MONTSERRAT_36 1
-#define LV_FONT_MONTSERRAT_38 1
-#define LV_FONT_MONTSERRAT_40 1
-#define LV_FONT_MONTSERRAT_42 1
-#define LV_FONT_MONTSERRAT_44 1
-#define LV_FONT_MONTSERRAT_46 1
+#define LV_FONT_MONTSERRAT_34 0
+#define LV_FONT_MONTSERRAT_36 0
+#define LV_FONT_MONTSERRAT_38 0
+#define LV_FONT_MONTSERRAT_40 0
+#define LV_FONT_MONTSERRAT_42 0
+#define LV_FONT_MONTSERRAT_44 0
+#define LV_FONT_MONTSERRAT_46 0
 #define LV_FONT_MONTSERRAT_48 1
 
 /* Demonstrate special features */
 #define LV_FONT_MONTSERRAT_12_SUBPX 1
 #define LV_FONT_MONTSERRAT_28_COMPRESSED 1
-#define LV_FONT_DEJAVU_16_PERSIAN_HEBREW 1
-#define LV_FONT_SIMSUN_16_CJK 1
+#define LV_FONT_DEJAVU_16_PERSIAN_HEBREW 0  /*Large, load it with `my_font_get()`*/
+#define LV_FONT_SIMSUN_16_CJK 0             /*Large, load it with `my_font_get()`*/
 
 /*Pixel perfect monospace font
  * http://pelulamu.net/unscii/ */
-#define LV_FONT_UNSCII_8 1
+#define LV_FONT_UNSCII_8 0
 #define LV_FONT_UNSCII_16     0
 
 /* Optionally declare your custom fonts here.
@@ -4,7 +4,6 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
-#include <poll.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -17,6 +16,29 @@
 #include "lvgl/lvgl.h"
 #include "lv_examples/lv_examples.h"
 #include "my_apps/my_apps.h"
+#include "my_port_conf.h"
+#include "my_port/my_flush.h"
+#include "my_port/my_mem.h"
+#include "my_port/my_locked.h"
+#include "my_port/my_img_cache.h"
+#include "my_port/my_glyph_cache.h"
+#include "my_port/my_fs.h"
+#include "my_port/my_font.h"
+#include "my_port/my_boot.h"
+#include "my_port/my_splash.h"
+#include "my_port/my_drm.h"
+#include "my_port/my_vsync.h"
+#include "my_port/my_idle.h"
+#include "my_port/my_trace.h"
+#include "my_port/my_vnc.h"
+#include "my_port/my_capture.h"
+#include "my_port/my_shadow.h"
+#include "my_port/my_scroll.h"
+#include "my_port/my_layer.h"
+#include "my_port/my_cmd.h"
+#include "my_port/my_sched.h"
+#include "my_port/my_budget.h"
+#include "my_port/my_input.h"
 
 /* 
 	Linux frame buffer like /dev/fb0 
@@ -30,16 +52,25 @@ static int screen_size;
 static unsigned char *fb_base;
 static unsigned int line_width,pixel_width;
 
+#if MY_USE_DRM
+/* DRM/KMS is used instead of the framebuffer (LV_PORT_BACKEND=drm) */
+static bool use_drm = false;
+#endif
+
 /* touchpad data */
 static bool my_touchpad_touchdown = false;
 static int16_t last_x = 0;
 static int16_t last_y = 0;
 
-/* poll event of input device touchpad*/
+/* state of the touchpad events since the last SYN_REPORT */
+static bool tp_down = false;
+static int16_t tp_x = 0;
+static int16_t tp_y = 0;
+static bool tp_dropped = false;
+
+/* non-blocking input device touchpad */
 static int tp_fd;
-nfds_t nfds = 1;
-struct pollfd mpollfd[1];
-struct input_event my_event;
+static lv_task_t *tp_task;
 
 /* error handler */
 #define handle_error(msg) do {perror(msg);} \
@@ -51,11 +82,13 @@ struct input_event my_event;
 #define DISP_BUF_SIZE LV_HOR_RES_MAX * LV_VER_RES_MAX /10
 /* default to 5 milliseconds to keep the system responsive */
 #define SYSTEM_RESPONSE_TIME 5
-#define INPUT_SAMEPLING_TIME 1
+/* events read with one read() */
+#define INPUT_EVENT_BATCH 16
 
 void my_fb_init(void);
 void my_touchpad_init(void);
 void my_touchpad_thread(lv_task_t *task);
+static void my_touchpad_event(const struct input_event *ev);
 
 void my_disp_flush(lv_disp_drv_t *disp,const lv_area_t *area, lv_color_t *color_p);
 bool my_touchpad_read(lv_indev_drv_t * indev, lv_indev_data_t * data);
@@ -94,7 +127,13 @@ void my_fb_init(void)
 	}
 
 	/* alreay get the start addr of framebuffer */
+#if MY_FB_KEEP_SPLASH == 0
+#if MY_FAST_STARTUP
+	/* The first frame covers the whole screen only if LVGL's resolution is the panel's */
+	if(var.xres != LV_HOR_RES_MAX || var.yres != LV_VER_RES_MAX)
+#endif
 	memset(fb_base, 0xff, screen_size); /* clear the screen */
+#endif
 	
 }
 
@@ -106,20 +145,24 @@ void my_fb_init(void)
 void my_touchpad_init(void)
 {
 	
-	tp_fd = open(DEFAULT_LINUX_TOUCHPAD_PATH, O_RDWR);
+	/* Non-blocking: every pending event is read at once */
+	tp_fd = open(DEFAULT_LINUX_TOUCHPAD_PATH, O_RDWR | O_NONBLOCK);
 	if(tp_fd < 0){
 		handle_error("can not open /dev/input/event1");
 	}
 
-	mpollfd[0].fd = tp_fd;
-	mpollfd[0].events = POLLIN;
-	mpollfd[0].revents = 0;
+#if MY_USE_INPUT_TIMESTAMPS
+	/* Not fatal, the timestamps are on CLOCK_REALTIME then */
+	my_input_init(tp_fd);
+#endif
 
 }
 
 
 /**
  * A thread to collect input data of screen.
+ * The refresh can run only once per frame, so read every event
+ * which arrived since the last call, not only one.
  * @param
  * @return
  */
@@ -127,70 +170,79 @@ void my_touchpad_thread(lv_task_t *task)
 {
 	(void)task;
 
-	int len;
-	
-	len = poll(mpollfd, nfds, INPUT_SAMEPLING_TIME);
-	
-		if(len > 0){		/* There is data to read */
-			
-			len = read(tp_fd, &my_event, sizeof(my_event));
-			if(len == sizeof(my_event)){ /* On success */
-			
-				//printf("get event: type = 0x%x,code = 0x%x,value = 0x%x\n",my_event.type,my_event.code,my_event.value);
-				switch(my_event.type)
-				{
-					case EV_SYN:	/* Sync event. Do nonthing */
-						break;
-					case EV_KEY:	/* Key event. Provide the pressure data of touchscreen*/
-						if(my_event.code == BTN_TOUCH)		/* Screen touch event */
-						{
-							if(my_event.value == 0x1)		/* Touch down */
-							{
-								//printf("screen touchdown\n");
-								my_touchpad_touchdown = true;
-							}
-								
-							else if(my_event.value == 0x0)	/* Touch up */
-							{
-								my_touchpad_touchdown = false;
-								//printf("screen touchdown\n");
-							}
-	
-							else							/* Unexcepted data */
-								//printf("Unexcepted data\n");
-								goto touchdown_err;
-						}
-							
-						break;
-					case EV_ABS:	/* Abs event. Provide the position data of touchscreen*/
-						if(my_event.code == ABS_MT_POSITION_X)
-							last_x = my_event.value;
-						if(my_event.code == ABS_MT_POSITION_Y)
-							last_y = my_event.value;
-						break;
-						
-					default:
-						break;
-				}
-			}
-			else{			  /* On error */
-			
-				handle_error("read error\n");
+	struct input_event evs[INPUT_EVENT_BATCH];
+	ssize_t len;
+	size_t i;
+
+	while(1){
+		len = read(tp_fd, evs, sizeof(evs));
+		if(len < 0){
+			if(errno != EAGAIN && errno != EINTR){
+				handle_error("read error");
 			}
+			break;		/* No more events (or an error): ready for the next call */
 		}
-		else if(len == 0){	/* Time out */
-		
-			/* Do nothing */
-		}
-		else{	/* Error */
-			handle_error("poll error!");
+
+		my_trace_add(MY_TRACE_INPUT, 0, NULL);
+
+		for(i = 0; i < len / sizeof(struct input_event); i++){
+			my_touchpad_event(&evs[i]);
 		}
-	
 
-	
-touchdown_err:		/* Do nothing. Just return and ready for next event come. */
-	return;
+		if(len < (ssize_t)sizeof(evs)) break;	/* Drained */
+	}
+}
 
+/**
+ * Handle one event of the touchpad.
+ * Coordinates and touch state are collected until SYN_REPORT,
+ * then the complete frame becomes the state LVGL reads.
+ * @param ev the event
+ * @return
+ */
+static void my_touchpad_event(const struct input_event *ev)
+{
+	//printf("get event: type = 0x%x,code = 0x%x,value = 0x%x\n",ev->type,ev->code,ev->value);
+	switch(ev->type)
+	{
+		case EV_SYN:	/* Sync event. End of a frame */
+			if(ev->code == SYN_DROPPED){
+				/* The kernel's buffer overflowed: drop the frame which is in progress */
+				tp_dropped = true;
+			}
+			else if(ev->code == SYN_REPORT){
+				if(tp_dropped){
+					tp_dropped = false;
+					break;
+				}
+				my_touchpad_touchdown = tp_down;
+				last_x = tp_x;
+				last_y = tp_y;
+#if MY_USE_INPUT_TIMESTAMPS
+				/* A sample with the kernel's timestamp */
+				my_input_sample(ev, last_x, last_y, my_touchpad_touchdown);
+#endif
+			}
+			break;
+		case EV_KEY:	/* Key event. Provide the pressure data of touchscreen*/
+			if(ev->code == BTN_TOUCH){		/* Screen touch event */
+				if(ev->value == 0x1)		/* Touch down */
+					tp_down = true;
+				else if(ev->value == 0x0)	/* Touch up */
+					tp_down = false;
+				/* Unexcepted data: ignored */
+			}
+			break;
+		case EV_ABS:	/* Abs event. Provide the position data of touchscreen*/
+			if(ev->code == ABS_MT_POSITION_X)
+				tp_x = ev->value;
+			if(ev->code == ABS_MT_POSITION_Y)
+				tp_y = ev->value;
+			break;
+			
+		default:
+			break;
+	}
 }
 
 
@@ -203,16 +255,58 @@ touchdown_err:		/* Do nothing. Just return and ready for next event come. */
  */
 void my_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p)
 {
-	int32_t x,y;
-	for(y = area->y1; y<=area->y2;y++){
-		for (x=area->x1; x<=area->x2; x++){
-			memcpy(fb_base + x*pixel_width + y*line_width,
-						&color_p->full, sizeof(lv_color_t));
-			color_p++;
-		}
+	uint64_t trace_start = my_trace_now();
+
+	my_boot_flushed(disp);
+#if MY_USE_TASK_BUDGET
+	/* Read the input in the middle of a long refresh too */
+	my_budget_run_inputs();
+#endif
+#if MY_USE_IDLE
+	my_idle_flushed();
+#endif
+#if MY_USE_SHADOW
+	my_shadow_flush(area, color_p);
+#endif
+#if MY_USE_VNC
+	my_vnc_flush(disp, area);
+#endif
+#if MY_USE_CAPTURE
+	my_capture_flush(disp, area);
+#endif
+
+#if MY_USE_DRM
+	if(use_drm){
+		my_drm_flush(disp, area, color_p);
+		my_trace_add(MY_TRACE_FLUSH, trace_start, area);
+		lv_disp_flush_ready(disp);
+		return;
+	}
+#endif
+
+#if MY_FB_KEEP_SPLASH && MY_SPLASH_FADE_TIME
+	/* The splash on the top layer is rendered, it's already on the screen */
+	if(my_splash_covers()){
+		lv_disp_flush_ready(disp);
+		return;
 	}
+#endif
+
+#if MY_USE_FLUSH_WORKERS
+	/* The last worker calls lv_disp_flush_ready() */
+	my_flush_workers_submit(disp, area, color_p);
+	my_trace_add(MY_TRACE_FLUSH, trace_start, area);
+#elif MY_USE_TILE_HASH
+	my_flush_copy_changed(fb_base, line_width, pixel_width, area, color_p, area->y1, area->y2);
+	my_trace_add(MY_TRACE_FLUSH, trace_start, area);
+
+	lv_disp_flush_ready(disp);
+#else
+	my_flush_copy_lines(fb_base, line_width, pixel_width, area, color_p, area->y1, area->y2);
+	my_trace_add(MY_TRACE_FLUSH, trace_start, area);
 
 	lv_disp_flush_ready(disp);
+#endif
 }
 
 /**
@@ -223,38 +317,178 @@ void my_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color
  */
 bool my_touchpad_read(lv_indev_drv_t * indev, lv_indev_data_t * data)
 {
+#if MY_USE_VNC
+	/* The remote pointer while the touchpad isn't pressed */
+	if(my_touchpad_touchdown == false && my_vnc_read_pointer(data)){
+		return false;
+	}
+#endif
+
+#if MY_USE_INPUT_TIMESTAMPS
+	/* The position at evenly spaced times, from the timestamped samples */
+	my_input_read(indev, data);
+#else
 	/* store the collected data */
 	data->state = my_touchpad_touchdown ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
 	if(data->state == LV_INDEV_STATE_PR) {
 		data->point.x = last_x;
 		data->point.y = last_y;
 	}
+#endif
 
 	return false;
 }
 
+#if MY_USE_FS && MY_FS_BENCH
+static void my_fs_bench_task(lv_task_t *task)
+{
+	(void)task;
+
+	my_fs_bench(MY_FS_BENCH_FILE);
+}
+#endif
+
+#if MY_USE_FLUSH_WORKERS && MY_FLUSH_BENCH
+static void my_flush_bench_task(lv_task_t *task)
+{
+	(void)task;
+
+	if(fb_base) my_flush_bench(&lv_disp_get_default()->driver);
+}
+#endif
+
 /* main thread of lvgl */
 int main(void)
 {
+	my_boot_mark("start");
+
+#if MY_USE_SCHED
+	/* Before any thread is created, they inherit it */
+	if(my_sched_init() < 0){
+		/* The reason is printed by my_sched_init() */
+		fprintf(stderr, "invalid scheduling settings, see MY_SCHED_CONF_FILE and LV_PORT_SCHED_*\n");
+		return -1;
+	}
+#endif
+
+#if MY_USE_MEM
+	/* Map the heap before LVGL starts to allocate */
+	my_mem_init();
+#endif
 	lv_init();
+#if MY_USE_TRACE
+	my_trace_init();
+#endif
+#if MY_USE_FS
+	my_fs_init();
+#if MY_FS_BENCH
+	/* Don't delay the first frame */
+	my_boot_after_first_frame(my_fs_bench_task, NULL);
+#endif
+#endif
+	my_boot_mark("lv_init");
  
+	lv_coord_t hor_res = LV_HOR_RES_MAX;
+	lv_coord_t ver_res = LV_VER_RES_MAX;
+#if MY_USE_DRM
+	/* LV_PORT_BACKEND=drm LV_PORT_DRM_CARD=/dev/dri/card1 ./demo */
+	const char *backend = getenv("LV_PORT_BACKEND");
+	if(backend && strcmp(backend, "drm") == 0){
+		const char *card = getenv("LV_PORT_DRM_CARD");
+		use_drm = my_drm_init(card ? card : MY_DRM_DEFAULT_CARD, &hor_res, &ver_res) == 0;
+		if(use_drm == false){
+			fprintf(stderr, "drm backend failed, using %s\n", DEFAULT_LINUX_FB_PATH);
+		}
+	}
+	if(use_drm == false)
+#endif
 	my_fb_init();
+	my_boot_mark("fb init");
 	my_touchpad_init();
+	my_boot_mark("touchpad init");
+
+	/* The rendered pixels are copied to the framebuffer as they are */
+	if(fb_base && pixel_width != sizeof(lv_color_t)){
+		fprintf(stderr, "%s has %u bits per pixel, LV_COLOR_DEPTH is %d\n",
+				DEFAULT_LINUX_FB_PATH, var.bits_per_pixel, LV_COLOR_DEPTH);
+		return -1;
+	}
+
+#if MY_USE_TILE_HASH
+	if(fb_base && my_flush_tile_hash_init(var.xres, var.yres) < 0){
+		handle_error("can not start tile hashing");
+	}
+#endif
 
 	/* lvgl display buffer */
 	static lv_disp_buf_t disp_buf;
 	/* Declare a buffer for 1/10 screen size */
+#if MY_USE_LOCKED_MEM
+	lv_color_t *buf = my_locked_map(DISP_BUF_SIZE * sizeof(lv_color_t));
+	if(buf == NULL){
+		handle_error("can not map draw buffer");
+		return -1;
+	}
+#else
 	static lv_color_t buf[DISP_BUF_SIZE];
+#endif
+#if MY_USE_FLUSH_WORKERS
+	/* Render into the second buffer while the workers copy the first one */
+#if MY_USE_LOCKED_MEM
+	lv_color_t *buf2 = my_locked_map(DISP_BUF_SIZE * sizeof(lv_color_t));
+	if(buf2 == NULL){
+		handle_error("can not map draw buffer");
+		return -1;
+	}
+#else
+	static lv_color_t buf2[DISP_BUF_SIZE];
+#endif
+	lv_disp_buf_init(&disp_buf, buf, buf2, DISP_BUF_SIZE);
+	if(fb_base && my_flush_workers_init(fb_base, line_width, pixel_width) < 0){
+		handle_error("can not start flush workers");
+	}
+#if MY_FLUSH_BENCH
+	/* Don't delay the first frame */
+	my_boot_after_first_frame(my_flush_bench_task, NULL);
+#endif
+#else
 	/* Initialize the display buffer */
 	lv_disp_buf_init(&disp_buf, buf, NULL, DISP_BUF_SIZE);
+#endif
 
 	/* register display driver */
 	lv_disp_drv_t disp_drv;
 	lv_disp_drv_init(&disp_drv);
 	disp_drv.flush_cb = my_disp_flush;
 	disp_drv.buffer = &disp_buf;
+	disp_drv.hor_res = hor_res;
+	disp_drv.ver_res = ver_res;
+#if MY_USE_FLUSH_WORKERS
+	disp_drv.wait_cb = my_flush_workers_wait;
+#endif
+#if MY_USE_TRACE
+	disp_drv.monitor_cb = my_trace_monitor;
+#endif
 	lv_disp_drv_register(&disp_drv);
 
+#if MY_USE_VNC
+	if(my_vnc_init(hor_res, ver_res) < 0){
+		handle_error("can not start the vnc server");
+	}
+#endif
+
+#if MY_USE_CAPTURE
+	if(my_capture_init(hor_res, ver_res) < 0){
+		handle_error("can not start the capture");
+	}
+#endif
+
+#if MY_USE_LAYER_CACHE
+	if(my_layer_init(hor_res, ver_res) < 0){
+		handle_error("can not allocate the layer cache");
+	}
+#endif
+
 	/* register input device driver */
 	lv_indev_drv_t indev_drv;
 	lv_indev_drv_init(&indev_drv);
@@ -263,19 +497,111 @@ int main(void)
 	lv_indev_drv_register(&indev_drv); 
 
 	/* create a thread to collect screen input data */
-	lv_task_create(my_touchpad_thread, SYSTEM_RESPONSE_TIME, LV_TASK_PRIO_MID, NULL);
+	tp_task = lv_task_create(my_touchpad_thread, SYSTEM_RESPONSE_TIME, LV_TASK_PRIO_MID, NULL);
+	my_boot_mark("drivers");
+
+#if MY_USE_IMG_CACHE
+	/* After every other image decoder */
+	my_img_cache_init();
+#endif
+
+#if MY_USE_GLYPH_CACHE
+	my_glyph_cache_add_font(LV_THEME_DEFAULT_FONT_SMALL);
+	my_glyph_cache_add_font(LV_THEME_DEFAULT_FONT_NORMAL);
+	my_glyph_cache_add_font(LV_THEME_DEFAULT_FONT_SUBTITLE);
+	my_glyph_cache_add_font(LV_THEME_DEFAULT_FONT_TITLE);
+#if LV_FONT_MONTSERRAT_28_COMPRESSED
+	my_glyph_cache_add_font(&lv_font_montserrat_28_compressed);
+#endif
+#endif
+
+#if MY_USE_CMD_QUEUE
+	/* Before the app, it may start threads which post commands */
+	if(my_cmd_init() < 0){
+		handle_error("can not create the command queue");
+	}
+#endif
 
 	/* App here */
+#ifdef MY_RUN_BENCHMARK
+	/* `make <profile> BENCH=1` */
+	lv_demo_benchmark();
+#else
 	//lv_demo_benchmark();
 	//lv_demo_widgets();
 	lv_demo_printer();
 	//lv_demo_music();
 	//first_app_examples();
+#endif
+	my_boot_mark("app created");
+
+#if MY_USE_SCROLL_BLIT
+	if(fb_base && my_scroll_init(lv_disp_get_default(), fb_base, line_width) == 0){
+		my_scroll_attach_all(lv_scr_act());
+	}
+#endif
+
+#if MY_FB_KEEP_SPLASH && MY_SPLASH_FADE_TIME
+	if(fb_base){
+		my_splash_init(fb_base, var.xres, var.yres, line_width);
+	}
+#endif
+
+#if MY_USE_VSYNC
+	/* Pace the refresh to the panel */
+	uint32_t refresh_us = 0;
+	int vsync_fd = -1;
+	if(fb_base){
+		refresh_us = my_vsync_fb_period(&var);
+		vsync_fd = fd_fb;
+	}
+#if MY_USE_DRM
+	else{
+		my_drm_stats_t drm_stats;
+		my_drm_get_stats(&drm_stats);
+		refresh_us = drm_stats.refresh_us;
+	}
+#endif
+	my_vsync_init(lv_disp_get_default(), refresh_us, vsync_fd);
+#endif
+
+#if MY_USE_IDLE
+	/* Sleep on the touchpad while nothing changes */
+	my_idle_init(lv_disp_get_default(), tp_fd, fb_base ? fd_fb : -1);
+	my_idle_add_task(tp_task);
+#endif
+
+#if MY_USE_TASK_BUDGET
+	/* After the other modules changed the task callbacks */
+	my_budget_init(lv_disp_get_default());
+	my_budget_add_input(tp_task, tp_fd);
+#endif
+
+#if MY_FAST_STARTUP
+	lv_refr_now(NULL);
+#endif
 	
 	while(1) {
-		lv_task_handler();		
+#if MY_USE_IDLE
+		my_idle_handler();
+#endif
+#if MY_USE_CMD_QUEUE && !MY_USE_VSYNC
+		/* With MY_USE_VSYNC it's applied after the sleep till the frame */
+		my_cmd_handler();
+#endif
+#if MY_USE_VSYNC
+		my_vsync_handler();
+#else
+		/* The trace, latency and budget hooks are no-ops when they are disabled */
+		uint64_t trace_start = my_trace_now();
+		my_budget_task_handler();
+		my_trace_add(MY_TRACE_TASK_HANDLER, trace_start, NULL);
+
+		uint64_t due = my_sched_now_us() + SYSTEM_RESPONSE_TIME * 1000;
 		usleep(SYSTEM_RESPONSE_TIME * 1000);
+		my_sched_woke(due);
 		lv_tick_inc(SYSTEM_RESPONSE_TIME);
+#endif
 	}
 
 	return 0;
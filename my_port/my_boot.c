@@ -0,0 +1,146 @@
+/**
+ * @file my_boot.c
+ * Startup timing and work deferred after the first frame
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <time.h>
+
+#include "my_boot.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_BOOT_PHASE_MAX   16
+#define MY_BOOT_DEFER_MAX   8
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	const char *name;
+	uint32_t us;
+} my_boot_phase_t;
+
+typedef struct {
+	lv_task_cb_t cb;
+	void *user_data;
+} my_boot_defer_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static uint64_t my_boot_now_us(clockid_t clk);
+static void my_boot_run_later(lv_task_cb_t cb, void *user_data);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static my_boot_phase_t phases[MY_BOOT_PHASE_MAX];
+static uint32_t phase_cnt;
+static uint64_t start_us;
+static uint64_t last_us;
+static uint64_t start_since_boot_us;
+static my_boot_defer_t deferred[MY_BOOT_DEFER_MAX];
+static uint32_t deferred_cnt;
+static bool first_frame_done;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_boot_mark(const char *phase)
+{
+	uint64_t now = my_boot_now_us(CLOCK_MONOTONIC);
+
+	if(start_us == 0) {
+		start_us = now;
+		last_us = now;
+		start_since_boot_us = my_boot_now_us(CLOCK_BOOTTIME);
+		return;
+	}
+
+	if(phase_cnt < MY_BOOT_PHASE_MAX) {
+		phases[phase_cnt].name = phase;
+		phases[phase_cnt].us = now - last_us;
+		phase_cnt++;
+	}
+
+	last_us = now;
+}
+
+void my_boot_after_first_frame(lv_task_cb_t cb, void *user_data)
+{
+	if(first_frame_done) {
+		my_boot_run_later(cb, user_data);
+		return;
+	}
+
+	if(deferred_cnt >= MY_BOOT_DEFER_MAX) {
+		LV_LOG_WARN("my_boot_after_first_frame: too many tasks, running it now");
+		my_boot_run_later(cb, user_data);
+		return;
+	}
+
+	deferred[deferred_cnt].cb = cb;
+	deferred[deferred_cnt].user_data = user_data;
+	deferred_cnt++;
+}
+
+void my_boot_flushed(lv_disp_drv_t *disp)
+{
+	uint32_t i;
+
+	if(first_frame_done || lv_disp_flush_is_last(disp) == false) return;
+
+	first_frame_done = true;
+
+#if MY_USE_BOOT_TIMING
+	my_boot_mark("first frame");
+
+	printf("boot: process started %u ms after the kernel\n", (uint32_t)(start_since_boot_us / 1000));
+	for(i = 0; i < phase_cnt; i++) {
+		printf("boot: %-16s %6u us\n", phases[i].name, phases[i].us);
+	}
+	printf("boot: first frame after %u us\n", (uint32_t)(last_us - start_us));
+#endif
+
+	/* Low priority, so they run after the refresh which is in progress */
+	for(i = 0; i < deferred_cnt; i++) {
+		my_boot_run_later(deferred[i].cb, deferred[i].user_data);
+	}
+	deferred_cnt = 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Run a callback once in a low priority task.
+ * @param cb the callback
+ * @param user_data user data of the task
+ */
+static void my_boot_run_later(lv_task_cb_t cb, void *user_data)
+{
+	lv_task_t *task = lv_task_create(cb, 0, LV_TASK_PRIO_LOW, user_data);
+
+	if(task == NULL) {
+		LV_LOG_WARN("my_boot_run_later: can not create the task, it's not run");
+		return;
+	}
+
+	lv_task_once(task);
+}
+
+static uint64_t my_boot_now_us(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
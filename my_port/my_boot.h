@@ -0,0 +1,41 @@
+/**
+ * @file my_boot.h
+ * Startup timing and work deferred after the first frame
+ */
+
+#ifndef MY_BOOT_H
+#define MY_BOOT_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Close a startup phase, its duration is measured from the previous mark.
+ * The first call only starts the measurement.
+ * @param phase name of the phase, a string literal
+ */
+void my_boot_mark(const char *phase);
+
+/**
+ * Run a task once after the first frame is on the screen.
+ * Use it for the work which isn't needed for the first frame (off-screen pages, ...).
+ * @param cb the task callback
+ * @param user_data passed in `task->user_data`
+ */
+void my_boot_after_first_frame(lv_task_cb_t cb, void *user_data);
+
+/**
+ * Call it when an area is flushed. On the last area of the first frame
+ * the timings are printed and the deferred tasks are started.
+ * @param disp the display driver being flushed
+ */
+void my_boot_flushed(lv_disp_drv_t *disp);
+
+#endif /*MY_BOOT_H*/
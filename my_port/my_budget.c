@@ -0,0 +1,439 @@
+/**
+ * @file my_budget.c
+ * Time budget of the main loop's passes
+ *
+ * The callbacks of the LVGL tasks are wrapped, so every task run is timed.
+ * When a pass of `lv_task_handler()` is over MY_TASK_BUDGET_MS, the
+ * non-urgent tasks are put off to the next pass. A refresh renders only the
+ * invalid areas which fit in the rest of the budget with the measured
+ * rendering speed (pixels of invalid area per ms); the other areas are
+ * invalidated again for the next pass.
+ *
+ * The input tasks also run between the tasks and between the flushes when
+ * they are due, so the input is read at its rate during a long pass too.
+ * The overruns are printed with the longest task of the pass: its name if
+ * it's exported (link with -rdynamic), else `<binary>+<address>` with the
+ * address relative to the load base for PIE, so
+ * `addr2line -f -e <binary> <address>` gives its name.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <time.h>
+#include <poll.h>
+#include <dlfcn.h>
+#include <link.h>
+
+#include "my_budget.h"
+#include "my_scroll.h"
+
+#if MY_USE_TASK_BUDGET
+
+/*********************
+ *      DEFINES
+ *********************/
+#define BUDGET_US           (MY_TASK_BUDGET_MS * 1000)
+
+/* Shorter refreshes don't tell the rendering speed */
+#define RATE_MIN_US         1000
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	lv_task_t *task;
+	lv_task_cb_t cb;            /* The original callback of `task` */
+	uint64_t last_us;           /* Last run of an input task */
+	int fd;
+	bool input;
+	bool seen;
+	uint8_t defer_cnt;          /* Deferred in this many passes in a row */
+} my_budget_task_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void my_budget_task_cb(lv_task_t *task);
+static void my_budget_refr(lv_task_t *task, lv_task_cb_t cb);
+static void my_budget_scan(void);
+static my_budget_task_t *my_budget_find(const lv_task_t *task);
+static void my_budget_ran(lv_task_cb_t cb, bool refr, uint32_t us);
+static void my_budget_pass_end(void);
+static uint64_t my_budget_now_us(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_disp_t *budget_disp;
+static my_budget_task_t tasks[MY_TASK_BUDGET_MAX_TASKS];
+static bool in_input;
+
+static uint64_t pass_start;
+static bool pass_overrun;
+static lv_task_cb_t longest_cb;     /* The longest task of the pass */
+static bool longest_refr;
+static uint32_t longest_us;
+#if MY_TASK_BUDGET_LOG_PERIOD
+static uint32_t last_log;
+static uint32_t unlogged_cnt;
+#endif
+
+static my_budget_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_budget_init(lv_disp_t *disp)
+{
+	budget_disp = disp;
+	pass_start = my_budget_now_us();
+	my_budget_scan();
+}
+
+void my_budget_add_input(lv_task_t *task, int fd)
+{
+	my_budget_task_t *e;
+
+	if(task == NULL) return;
+
+	e = my_budget_find(task);
+	if(e == NULL) e = my_budget_find(NULL);
+	if(e == NULL) {
+		LV_LOG_WARN("my_budget_add_input: too many tasks, increase MY_TASK_BUDGET_MAX_TASKS");
+		return;
+	}
+
+	if(e->task != task || task->task_cb != my_budget_task_cb) {
+		e->task = task;
+		e->cb = task->task_cb;
+		lv_task_set_cb(task, my_budget_task_cb);
+	}
+	e->input = true;
+	e->fd = fd;
+	e->last_us = my_budget_now_us();
+}
+
+uint32_t my_budget_task_handler(void)
+{
+	uint32_t next;
+
+	/* Wrap the tasks created since the last pass */
+	my_budget_scan();
+
+	pass_start = my_budget_now_us();
+	pass_overrun = false;
+	longest_us = 0;
+
+	next = lv_task_handler();
+
+	stats.pass_cnt++;
+	my_budget_pass_end();
+
+	return next;
+}
+
+void my_budget_refr_now(lv_disp_t *disp)
+{
+	uint64_t t0 = my_budget_now_us();
+
+	if(disp == budget_disp) my_budget_refr(NULL, NULL);
+	else lv_refr_now(disp);
+
+	my_budget_ran(NULL, true, my_budget_now_us() - t0);
+	my_budget_pass_end();
+}
+
+void my_budget_run_inputs(void)
+{
+	struct pollfd pfd;
+	my_budget_task_t *e;
+	uint64_t now;
+	uint32_t i;
+
+	/* Not from an input task which flushes */
+	if(in_input) return;
+	in_input = true;
+
+	for(i = 0; i < MY_TASK_BUDGET_MAX_TASKS; i++) {
+		e = &tasks[i];
+		if(e->task == NULL || e->input == false) continue;
+
+		/* Suspended, e.g. while idle */
+		if(e->task->prio == LV_TASK_PRIO_OFF) continue;
+
+		/* The LVGL tick doesn't advance in a pass */
+		now = my_budget_now_us();
+		if(now - e->last_us < (uint64_t)e->task->period * 1000) continue;
+
+		if(e->fd >= 0) {
+			pfd.fd = e->fd;
+			pfd.events = POLLIN;
+			if(poll(&pfd, 1, 0) <= 0) continue;
+		}
+
+		e->last_us = now;
+		e->task->last_run = lv_tick_get();
+		e->cb(e->task);
+		stats.input_cnt++;
+	}
+
+	in_input = false;
+}
+
+void my_budget_get_stats(my_budget_stats_t *res)
+{
+	*res = stats;
+}
+
+void my_budget_print_stats(void)
+{
+	printf("budget: %u passes, %u over %u ms (max %u us), %u tasks deferred, %u refreshes split, "
+			"%u extra input reads, %u px/ms\n",
+			stats.pass_cnt, stats.overrun_cnt, MY_TASK_BUDGET_MS, stats.pass_max_us,
+			stats.defer_cnt, stats.split_cnt, stats.input_cnt, stats.px_per_ms);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void my_budget_task_cb(lv_task_t *task)
+{
+	my_budget_task_t *e = my_budget_find(task);
+	lv_task_cb_t cb;
+	bool refr;
+	uint64_t t0;
+
+	if(e == NULL) return;
+
+	cb = e->cb;
+	if(e->input) {
+		e->last_us = my_budget_now_us();
+		cb(task);
+		return;
+	}
+
+	/* Read the input before a possibly long task */
+	my_budget_run_inputs();
+
+	t0 = my_budget_now_us();
+	if(t0 - pass_start > BUDGET_US && task->prio <= MY_TASK_BUDGET_DEFER_PRIO &&
+		task->repeat_count < 0 && e->defer_cnt < MY_TASK_BUDGET_DEFER_MAX) {
+		/* Ready again in the next pass (one-shot tasks are never deferred, LVGL would delete them) */
+		task->last_run = lv_tick_get() - task->period;
+		e->defer_cnt++;
+		stats.defer_cnt++;
+		return;
+	}
+	e->defer_cnt = 0;
+
+	refr = budget_disp && task == _lv_disp_get_refr_task(budget_disp);
+	if(refr) my_budget_refr(task, cb);
+	else cb(task);
+
+	/* `task` may have been deleted */
+	my_budget_ran(cb, refr, my_budget_now_us() - t0);
+}
+
+/**
+ * Refresh the display with the invalid areas which fit in the rest of the budget.
+ * @param task the refresh task, NULL: refresh with `lv_refr_now()`
+ * @param cb the original callback of the refresh task
+ */
+static void my_budget_refr(lv_task_t *task, lv_task_cb_t cb)
+{
+	static lv_area_t rest[LV_INV_BUF_SIZE];
+	lv_disp_t *disp = budget_disp;
+	uint32_t rest_cnt = 0;
+	uint32_t k = 0;
+	uint32_t i;
+	uint32_t size;
+	uint32_t us;
+	uint32_t left;
+	uint64_t px = 0;
+	uint64_t px_max = UINT64_MAX;
+	uint64_t t0;
+
+#if MY_USE_SCROLL_BLIT
+	/* The blit moves the invalid areas, before they are split */
+	my_scroll_apply();
+#endif
+
+	t0 = my_budget_now_us();
+
+	if(stats.px_per_ms) {
+		/* At least a quarter of the budget, so a late pass still makes progress */
+		left = t0 - pass_start < BUDGET_US * 3 / 4 ? BUDGET_US - (t0 - pass_start) : BUDGET_US / 4;
+		px_max = (uint64_t)left * stats.px_per_ms / 1000;
+	}
+
+	/* Keep the first areas, at least one */
+	for(i = 0; i < disp->inv_p; i++) {
+		if(disp->inv_area_joined[i]) continue;
+
+		size = lv_area_get_size(&disp->inv_areas[i]);
+		if(k > 0 && px + size > px_max) {
+			rest[rest_cnt++] = disp->inv_areas[i];
+			continue;
+		}
+
+		disp->inv_areas[k] = disp->inv_areas[i];
+		disp->inv_area_joined[k] = 0;
+		k++;
+		px += size;
+	}
+	disp->inv_p = k;
+
+	if(task) cb(task);
+	else lv_refr_now(disp);
+
+	/* Follow the rendering speed, it depends on the content of the screen */
+	us = my_budget_now_us() - t0;
+	if(px && us >= RATE_MIN_US) {
+		uint32_t rate = px * 1000 / us;
+		stats.px_per_ms = stats.px_per_ms ? (stats.px_per_ms * 3 + rate) / 4 : rate;
+	}
+
+	if(rest_cnt) {
+		for(i = 0; i < rest_cnt; i++) _lv_inv_area(disp, &rest[i]);
+		stats.split_cnt++;
+
+		/* Continue in the next pass, not in the next refresh period */
+		if(task) task->last_run = lv_tick_get() - task->period;
+	}
+}
+
+/**
+ * Wrap the callbacks of the new tasks and forget the deleted ones.
+ */
+static void my_budget_scan(void)
+{
+	my_budget_task_t *e;
+	lv_task_t *task;
+	uint32_t i;
+
+	for(i = 0; i < MY_TASK_BUDGET_MAX_TASKS; i++) tasks[i].seen = false;
+
+	for(task = lv_task_get_next(NULL); task; task = lv_task_get_next(task)) {
+		e = my_budget_find(task);
+		if(e && task->task_cb == my_budget_task_cb) {
+			e->seen = true;
+			continue;
+		}
+		if(task->task_cb == NULL || task->task_cb == my_budget_task_cb) continue;
+
+		/* New, or its callback was changed with `lv_task_set_cb()` */
+		if(e == NULL) {
+			e = my_budget_find(NULL);
+			if(e == NULL) {
+				/* It runs as usual, without timing and deferring */
+				LV_LOG_WARN("my_budget_scan: too many tasks, increase MY_TASK_BUDGET_MAX_TASKS");
+				break;
+			}
+			e->task = task;
+			e->input = false;
+			e->fd = -1;
+			e->defer_cnt = 0;
+		}
+
+		e->cb = task->task_cb;
+		e->seen = true;
+		lv_task_set_cb(task, my_budget_task_cb);
+	}
+
+	for(i = 0; i < MY_TASK_BUDGET_MAX_TASKS; i++) {
+		if(tasks[i].seen == false) tasks[i].task = NULL;
+	}
+}
+
+static my_budget_task_t *my_budget_find(const lv_task_t *task)
+{
+	uint32_t i;
+
+	for(i = 0; i < MY_TASK_BUDGET_MAX_TASKS; i++) {
+		if(tasks[i].task == task) return &tasks[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * Remember the longest task of the pass.
+ * @param cb callback of the task
+ * @param refr true: it was the refresh
+ * @param us duration of the run
+ */
+static void my_budget_ran(lv_task_cb_t cb, bool refr, uint32_t us)
+{
+	if(us <= longest_us) return;
+
+	longest_us = us;
+	longest_cb = cb;
+	longest_refr = refr;
+}
+
+/**
+ * Check the duration of the pass so far and print the first overrun of it.
+ */
+static void my_budget_pass_end(void)
+{
+	uint32_t us = my_budget_now_us() - pass_start;
+
+	if(us > stats.pass_max_us) stats.pass_max_us = us;
+	if(us <= BUDGET_US || pass_overrun) return;
+
+	pass_overrun = true;
+	stats.overrun_cnt++;
+
+#if MY_TASK_BUDGET_LOG_PERIOD
+	if(lv_tick_elaps(last_log) < MY_TASK_BUDGET_LOG_PERIOD) {
+		unlogged_cnt++;
+		return;
+	}
+
+	if(longest_refr) {
+		fprintf(stderr, "budget: pass took %u us (%u not shown before), longest: refresh %u us\n",
+				us, unlogged_cnt, longest_us);
+	}
+	else {
+		void *addr = (void *)(uintptr_t)longest_cb;
+		Dl_info info;
+
+		if(dladdr(addr, &info) == 0 || info.dli_fname == NULL) {
+			fprintf(stderr, "budget: pass took %u us (%u not shown before), longest: task %p %u us\n",
+					us, unlogged_cnt, addr, longest_us);
+		}
+		else if(info.dli_sname && info.dli_saddr == addr) {
+			fprintf(stderr, "budget: pass took %u us (%u not shown before), longest: task %s %u us\n",
+					us, unlogged_cnt, info.dli_sname, longest_us);
+		}
+		else {
+			/* Static functions aren't in the dynamic symbol table, print the address for addr2line:
+			 * PIE and shared objects are loaded anywhere, their addresses are relative to the load base */
+			uintptr_t ofs = (uintptr_t)addr;
+			if(((const ElfW(Ehdr) *)info.dli_fbase)->e_type == ET_DYN) ofs -= (uintptr_t)info.dli_fbase;
+
+			fprintf(stderr, "budget: pass took %u us (%u not shown before), longest: task %s+%#lx %u us\n",
+					us, unlogged_cnt, info.dli_fname, (unsigned long)ofs, longest_us);
+		}
+	}
+
+	last_log = lv_tick_get();
+	unlogged_cnt = 0;
+#endif
+}
+
+static uint64_t my_budget_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /*MY_USE_TASK_BUDGET*/
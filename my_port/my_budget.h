@@ -0,0 +1,90 @@
+/**
+ * @file my_budget.h
+ * Time budget of the main loop's passes
+ */
+
+#ifndef MY_BUDGET_H
+#define MY_BUDGET_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_TASK_BUDGET
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t pass_cnt;
+	uint32_t overrun_cnt;       /* Passes longer than MY_TASK_BUDGET_MS */
+	uint32_t pass_max_us;
+	uint32_t defer_cnt;         /* Task runs deferred to the next pass */
+	uint32_t split_cnt;         /* Refreshes which left areas to the next pass */
+	uint32_t input_cnt;         /* Input task runs in the middle of a pass */
+	uint32_t px_per_ms;         /* Measured rendering speed */
+} my_budget_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Start budgeting the passes.
+ * @param disp the display whose refresh is split
+ */
+void my_budget_init(lv_disp_t *disp);
+
+/**
+ * Mark a task as an input task. It's never deferred and it also runs between
+ * the other tasks and between the flushes of a refresh when it's due.
+ * It must only read the input, not change objects.
+ * @param task the task
+ * @param fd the task runs early only if it's readable, -1: always when it's due
+ */
+void my_budget_add_input(lv_task_t *task, int fd);
+
+/**
+ * Run `lv_task_handler()` as one budgeted pass.
+ * @return time till the next task, like `lv_task_handler()`
+ */
+uint32_t my_budget_task_handler(void);
+
+/**
+ * Refresh a display like `lv_refr_now()`, with the invalid areas which fit
+ * in the rest of the budget. The others are left for the next pass.
+ * @param disp the display
+ */
+void my_budget_refr_now(lv_disp_t *disp);
+
+/**
+ * Run the input tasks which are due. Called between the flushes.
+ */
+void my_budget_run_inputs(void);
+
+/**
+ * Get the budget statistics.
+ * @param stats store the result here
+ */
+void my_budget_get_stats(my_budget_stats_t *stats);
+
+/**
+ * Print the statistics with printf.
+ */
+void my_budget_print_stats(void);
+
+#else
+
+/* Not budgeted: a plain `lv_task_handler()` */
+static inline uint32_t my_budget_task_handler(void)
+{
+	return lv_task_handler();
+}
+
+#endif /*MY_USE_TASK_BUDGET*/
+
+#endif /*MY_BUDGET_H*/
@@ -0,0 +1,628 @@
+/**
+ * @file my_capture.c
+ * Screenshots and continuous capture encoded off the UI thread
+ *
+ * The changed 64x64 tiles of the flushed areas are marked, their pixels
+ * are in the copy of the screen of my_shadow.c. A screenshot copies the screen, a frame of the
+ * continuous capture copies only the changed tiles; this copy is the only
+ * cost on the UI thread. The encoder thread writes QOI (fast, ~PNG size
+ * for UI screens) or PNG with stored (uncompressed) deflate blocks,
+ * so no zlib is needed.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "my_capture.h"
+#include "my_shadow.h"
+#include "my_sched.h"
+
+#if MY_USE_CAPTURE
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_CAPTURE_TILE         64
+#define MY_CAPTURE_PATH_MAX     256
+#define MY_CAPTURE_SIG_PERIOD   500     /* Check for SIGUSR2 this often [ms] */
+
+#define QOI_OP_INDEX    0x00
+#define QOI_OP_DIFF     0x40
+#define QOI_OP_LUMA     0x80
+#define QOI_OP_RUN      0xc0
+#define QOI_OP_RGB      0xfe
+
+/* The encoders read lv_color_t as XRGB8888 */
+#if LV_COLOR_DEPTH != 32
+#error "MY_USE_CAPTURE needs LV_COLOR_DEPTH 32"
+#endif
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void *my_capture_thread(void *arg);
+static void my_capture_write_frame(void);
+static void my_capture_write_shot(void);
+static uint32_t my_capture_qoi(uint8_t *out, const lv_color_t *px, uint32_t stride, uint32_t w, uint32_t h);
+static uint32_t my_capture_png(uint8_t *out, const lv_color_t *px, uint32_t w, uint32_t h);
+static uint32_t my_capture_png_chunk(uint8_t *out, const char *type, uint32_t len);
+static uint32_t my_capture_crc(uint32_t crc, const uint8_t *data, uint32_t len);
+static uint8_t *my_capture_put_u32(uint8_t *p, uint32_t v);
+static void my_capture_sig(int sig);
+static void my_capture_sig_task(lv_task_t *task);
+static uint64_t my_capture_now_us(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_coord_t scr_w;
+static lv_coord_t scr_h;
+static uint32_t tiles_x;
+static uint32_t tiles_y;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+/* Written by the UI thread */
+static uint8_t *dirty;              /* 1 per changed tile */
+
+/* Screenshot, owned by the encoder thread while `shot_pending` */
+static lv_color_t *shot_buf;
+static char shot_path[MY_CAPTURE_PATH_MAX];
+static bool shot_pending;
+
+/* Continuous capture, owned by the encoder thread while `frame_pending` */
+static lv_color_t *frame_buf;
+static uint8_t *frame_tiles;
+static uint32_t frame_ms;
+static bool frame_pending;
+static bool capturing;
+static FILE *capture_file;
+static uint32_t frame_no;
+static uint64_t capture_start_us;
+
+static uint8_t *enc_buf;            /* Output of the encoder */
+static uint32_t crc_table[256];
+static volatile sig_atomic_t shot_req;
+static my_capture_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int my_capture_init(lv_coord_t hor_res, lv_coord_t ver_res)
+{
+	struct sigaction sa;
+	pthread_t thread;
+	uint32_t px_cnt = hor_res * ver_res;
+	uint32_t i;
+	uint32_t k;
+
+	scr_w = hor_res;
+	scr_h = ver_res;
+	tiles_x = (scr_w + MY_CAPTURE_TILE - 1) / MY_CAPTURE_TILE;
+	tiles_y = (scr_h + MY_CAPTURE_TILE - 1) / MY_CAPTURE_TILE;
+
+	if(my_shadow_init(hor_res, ver_res) < 0) return -1;
+
+	/* Not from the LVGL heap, the encoder thread uses them.
+	 * The encoder's worst case is an uncompressed PNG, ~3 bytes/px + headers */
+	shot_buf = malloc(px_cnt * sizeof(lv_color_t));
+	frame_buf = malloc(px_cnt * sizeof(lv_color_t));
+	dirty = calloc(tiles_x * tiles_y, 1);
+	frame_tiles = calloc(tiles_x * tiles_y, 1);
+	enc_buf = malloc(px_cnt * 4 + scr_h * 8 + 1024);
+	if(shot_buf == NULL || frame_buf == NULL || dirty == NULL || frame_tiles == NULL ||
+		enc_buf == NULL) {
+		perror("can not allocate capture buffers");
+		return -1;
+	}
+
+	for(i = 0; i < 256; i++) {
+		uint32_t c = i;
+		for(k = 0; k < 8; k++) c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		crc_table[i] = c;
+	}
+
+	if(pthread_create(&thread, NULL, my_capture_thread, NULL) != 0) {
+		perror("can not start the capture thread");
+		return -1;
+	}
+	pthread_detach(thread);
+
+	sa.sa_handler = my_capture_sig;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR2, &sa, NULL);
+	lv_task_create(my_capture_sig_task, MY_CAPTURE_SIG_PERIOD, LV_TASK_PRIO_LOWEST, NULL);
+
+	return 0;
+}
+
+void my_capture_flush(lv_disp_drv_t *disp, const lv_area_t *area)
+{
+	/* Only the UI thread writes the shadow, no need to lock it here */
+	const lv_color_t *shadow = my_shadow_get();
+	lv_area_t a;
+	int32_t y;
+	uint32_t tx;
+	uint32_t ty;
+	uint32_t i;
+
+	a.x1 = 0;
+	a.y1 = 0;
+	a.x2 = scr_w - 1;
+	a.y2 = scr_h - 1;
+
+	pthread_mutex_lock(&lock);
+
+	if(_lv_area_intersect(&a, &a, area)) {
+		for(ty = a.y1 / MY_CAPTURE_TILE; ty <= (uint32_t)a.y2 / MY_CAPTURE_TILE; ty++) {
+			for(tx = a.x1 / MY_CAPTURE_TILE; tx <= (uint32_t)a.x2 / MY_CAPTURE_TILE; tx++) {
+				dirty[ty * tiles_x + tx] = 1;
+			}
+		}
+	}
+
+	if(capturing && lv_disp_flush_is_last(disp)) {
+		if(frame_pending) {
+			/* The tiles stay dirty, they go with the next frame */
+			stats.skip_cnt++;
+		}
+		else {
+			uint64_t t0 = my_capture_now_us();
+			uint32_t snap_us;
+
+			/* Copy the changed tiles only */
+			for(i = 0; i < tiles_x * tiles_y; i++) {
+				frame_tiles[i] = dirty[i];
+				if(dirty[i] == 0) continue;
+				dirty[i] = 0;
+
+				a.x1 = (i % tiles_x) * MY_CAPTURE_TILE;
+				a.y1 = (i / tiles_x) * MY_CAPTURE_TILE;
+				a.x2 = LV_MATH_MIN(a.x1 + MY_CAPTURE_TILE, scr_w) - 1;
+				a.y2 = LV_MATH_MIN(a.y1 + MY_CAPTURE_TILE, scr_h) - 1;
+				for(y = a.y1; y <= a.y2; y++) {
+					memcpy(&frame_buf[y * scr_w + a.x1], &shadow[y * scr_w + a.x1],
+							lv_area_get_width(&a) * sizeof(lv_color_t));
+				}
+			}
+
+			frame_ms = (t0 - capture_start_us) / 1000;
+			frame_pending = true;
+			pthread_cond_signal(&job_cond);
+
+			snap_us = my_capture_now_us() - t0;
+			if(snap_us > stats.snap_us_max) stats.snap_us_max = snap_us;
+		}
+	}
+
+	pthread_mutex_unlock(&lock);
+}
+
+int my_capture_screenshot(const char *path)
+{
+	uint64_t t0;
+	uint32_t snap_us;
+
+	pthread_mutex_lock(&lock);
+	if(shot_pending) {
+		pthread_mutex_unlock(&lock);
+		return -1;
+	}
+
+	t0 = my_capture_now_us();
+	memcpy(shot_buf, my_shadow_get(), scr_w * scr_h * sizeof(lv_color_t));
+	snap_us = my_capture_now_us() - t0;
+	if(snap_us > stats.snap_us_max) stats.snap_us_max = snap_us;
+
+	strncpy(shot_path, path, sizeof(shot_path) - 1);
+	shot_pending = true;
+	pthread_cond_signal(&job_cond);
+	pthread_mutex_unlock(&lock);
+
+	return 0;
+}
+
+int my_capture_start(const char *path)
+{
+	FILE *f;
+
+	my_capture_stop();
+
+	f = fopen(path, "wb");
+	if(f == NULL) {
+		perror("can not open capture file");
+		return -1;
+	}
+
+	pthread_mutex_lock(&lock);
+	capture_file = f;
+	frame_no = 0;
+	capture_start_us = my_capture_now_us();
+	/* The first frame has the whole screen */
+	memset(dirty, 1, tiles_x * tiles_y);
+	capturing = true;
+	pthread_mutex_unlock(&lock);
+
+	return 0;
+}
+
+void my_capture_stop(void)
+{
+	pthread_mutex_lock(&lock);
+	capturing = false;
+	while(frame_pending) pthread_cond_wait(&done_cond, &lock);
+	if(capture_file) {
+		fclose(capture_file);
+		capture_file = NULL;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void my_capture_get_stats(my_capture_stats_t *res)
+{
+	pthread_mutex_lock(&lock);
+	*res = stats;
+	pthread_mutex_unlock(&lock);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Encode the screenshots and the frames of the continuous capture.
+ * @param arg unused
+ * @return never returns
+ */
+static void *my_capture_thread(void *arg)
+{
+	bool shot;
+	bool frame;
+
+	(void)arg;
+
+#if MY_USE_SCHED
+	my_sched_apply(MY_SCHED_ROLE_BACKGROUND, "lv-capture");
+#endif
+
+	while(1) {
+		pthread_mutex_lock(&lock);
+		while(shot_pending == false && frame_pending == false) pthread_cond_wait(&job_cond, &lock);
+		shot = shot_pending;
+		frame = frame_pending;
+		pthread_mutex_unlock(&lock);
+
+		if(shot) {
+			my_capture_write_shot();
+			pthread_mutex_lock(&lock);
+			shot_pending = false;
+			pthread_mutex_unlock(&lock);
+		}
+
+		if(frame) {
+			my_capture_write_frame();
+			pthread_mutex_lock(&lock);
+			frame_pending = false;
+			pthread_cond_broadcast(&done_cond);
+			pthread_mutex_unlock(&lock);
+		}
+	}
+
+	return NULL;
+}
+
+static void my_capture_write_shot(void)
+{
+	FILE *f;
+	uint32_t len;
+	uint32_t path_len = strlen(shot_path);
+
+	if(path_len > 4 && strcmp(&shot_path[path_len - 4], ".png") == 0) {
+		len = my_capture_png(enc_buf, shot_buf, scr_w, scr_h);
+	}
+	else {
+		len = my_capture_qoi(enc_buf, shot_buf, scr_w, scr_w, scr_h);
+	}
+
+	f = fopen(shot_path, "wb");
+	if(f == NULL) {
+		perror("can not open screenshot file");
+		return;
+	}
+	if(fwrite(enc_buf, 1, len, f) != len) perror("can not write screenshot");
+	fclose(f);
+
+	pthread_mutex_lock(&lock);
+	stats.shot_cnt++;
+	stats.byte_cnt += len;
+	pthread_mutex_unlock(&lock);
+
+	printf("capture: screenshot written to %s\n", shot_path);
+}
+
+static void my_capture_write_frame(void)
+{
+	uint8_t hdr[16];
+	uint32_t tile_cnt = 0;
+	uint32_t bytes = 0;
+	uint32_t i;
+
+	for(i = 0; i < tiles_x * tiles_y; i++) tile_cnt += frame_tiles[i];
+
+	memcpy(hdr, "LVCF", 4);
+	my_capture_put_u32(&hdr[4], frame_no++);
+	my_capture_put_u32(&hdr[8], frame_ms);
+	my_capture_put_u32(&hdr[12], tile_cnt);
+	fwrite(hdr, 1, sizeof(hdr), capture_file);
+
+	for(i = 0; i < tiles_x * tiles_y; i++) {
+		uint32_t x;
+		uint32_t y;
+		uint32_t len;
+
+		if(frame_tiles[i] == 0) continue;
+
+		x = (i % tiles_x) * MY_CAPTURE_TILE;
+		y = (i / tiles_x) * MY_CAPTURE_TILE;
+		len = my_capture_qoi(enc_buf, &frame_buf[y * scr_w + x], scr_w,
+							 LV_MATH_MIN(MY_CAPTURE_TILE, scr_w - x), LV_MATH_MIN(MY_CAPTURE_TILE, scr_h - y));
+
+		my_capture_put_u32(&hdr[0], x);
+		my_capture_put_u32(&hdr[4], y);
+		my_capture_put_u32(&hdr[8], len);
+		fwrite(hdr, 1, 12, capture_file);
+		fwrite(enc_buf, 1, len, capture_file);
+		bytes += 12 + len;
+	}
+
+	pthread_mutex_lock(&lock);
+	stats.frame_cnt++;
+	stats.tile_cnt += tile_cnt;
+	stats.byte_cnt += sizeof(hdr) + bytes;
+	pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Encode an image in QOI format (3 channels).
+ * @param out store the image here, at least w * h * 4 + 22 bytes
+ * @param px the first pixel
+ * @param stride pixels in a line of `px`
+ * @param w width of the image
+ * @param h height of the image
+ * @return length of the image in bytes
+ */
+static uint32_t my_capture_qoi(uint8_t *out, const lv_color_t *px, uint32_t stride, uint32_t w, uint32_t h)
+{
+	uint8_t *p = out;
+	uint32_t index[64];
+	uint32_t prev = 0xff000000;     /* 0, 0, 0, 255 */
+	uint32_t run = 0;
+	uint32_t x;
+	uint32_t y;
+
+	memset(index, 0, sizeof(index));
+
+	memcpy(p, "qoif", 4);
+	p = my_capture_put_u32(p + 4, w);
+	p = my_capture_put_u32(p, h);
+	*p++ = 3;       /* RGB */
+	*p++ = 0;       /* sRGB */
+
+	for(y = 0; y < h; y++) {
+		const lv_color_t *row = &px[y * stride];
+		for(x = 0; x < w; x++) {
+			/* The alpha of the screen is ignored */
+			uint32_t c = row[x].full | 0xff000000;
+
+			if(c == prev) {
+				run++;
+				if(run == 62) {
+					*p++ = QOI_OP_RUN | (run - 1);
+					run = 0;
+				}
+				continue;
+			}
+
+			if(run) {
+				*p++ = QOI_OP_RUN | (run - 1);
+				run = 0;
+			}
+
+			{
+				uint8_t r = c >> 16;
+				uint8_t g = c >> 8;
+				uint8_t b = c;
+				uint32_t hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+
+				if(index[hash] == c) {
+					*p++ = QOI_OP_INDEX | hash;
+				}
+				else {
+					int8_t vr = r - (uint8_t)(prev >> 16);
+					int8_t vg = g - (uint8_t)(prev >> 8);
+					int8_t vb = b - (uint8_t)prev;
+					int8_t vg_r = vr - vg;
+					int8_t vg_b = vb - vg;
+
+					index[hash] = c;
+
+					if(vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+						*p++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+					}
+					else if(vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+						*p++ = QOI_OP_LUMA | (vg + 32);
+						*p++ = (vg_r + 8) << 4 | (vg_b + 8);
+					}
+					else {
+						*p++ = QOI_OP_RGB;
+						*p++ = r;
+						*p++ = g;
+						*p++ = b;
+					}
+				}
+			}
+			prev = c;
+		}
+	}
+
+	if(run) *p++ = QOI_OP_RUN | (run - 1);
+
+	/* End marker */
+	memcpy(p, "\0\0\0\0\0\0\0\1", 8);
+	p += 8;
+
+	return p - out;
+}
+
+/**
+ * Encode an image in PNG format with stored deflate blocks.
+ * @param out store the image here
+ * @param px the pixels
+ * @param w width of the image
+ * @param h height of the image
+ * @return length of the image in bytes
+ */
+static uint32_t my_capture_png(uint8_t *out, const lv_color_t *px, uint32_t w, uint32_t h)
+{
+	uint8_t *p = out;
+	uint8_t *idat;
+	uint32_t raw_len = h * (1 + w * 3);
+	uint32_t block = 0;         /* Bytes left in the current stored block */
+	uint32_t left = raw_len;
+	uint32_t a = 1;             /* Adler-32 */
+	uint32_t b = 0;
+	uint32_t x;
+	uint32_t y;
+	uint32_t i;
+
+	memcpy(p, "\x89PNG\r\n\x1a\n", 8);
+	p += 8;
+
+	my_capture_put_u32(p + 8, w);
+	my_capture_put_u32(p + 12, h);
+	memcpy(p + 16, "\x08\x02\x00\x00\x00", 5);     /* 8 bit RGB */
+	p += my_capture_png_chunk(p, "IHDR", 13);
+
+	idat = p;
+	p += 8;
+	*p++ = 0x78;    /* zlib, no compression */
+	*p++ = 0x01;
+
+	for(y = 0; y < h; y++) {
+		for(x = 0; x <= w; x++) {
+			uint8_t rgb[3];
+			uint32_t n;
+
+			/* Each line starts with the filter type 0 */
+			if(x == 0) {
+				rgb[0] = 0;
+				n = 1;
+			}
+			else {
+				lv_color_t c = px[y * w + x - 1];
+				rgb[0] = c.ch.red;
+				rgb[1] = c.ch.green;
+				rgb[2] = c.ch.blue;
+				n = 3;
+			}
+
+			for(i = 0; i < n; i++) {
+				if(block == 0) {
+					block = LV_MATH_MIN(left, 65535);
+					*p++ = block == left ? 1 : 0;   /* BFINAL, BTYPE 00 */
+					*p++ = block & 0xff;
+					*p++ = block >> 8;
+					*p++ = ~block & 0xff;
+					*p++ = (~block >> 8) & 0xff;
+				}
+				*p++ = rgb[i];
+				block--;
+				left--;
+				a = (a + rgb[i]) % 65521;
+				b = (b + a) % 65521;
+			}
+		}
+	}
+	p = my_capture_put_u32(p, (b << 16) | a);
+	p = idat + my_capture_png_chunk(idat, "IDAT", p - idat - 8);
+
+	p += my_capture_png_chunk(p, "IEND", 0);
+
+	return p - out;
+}
+
+/**
+ * Complete a PNG chunk whose data is already at `out + 8`.
+ * @param out start of the chunk
+ * @param type type of the chunk
+ * @param len length of the data
+ * @return length of the chunk
+ */
+static uint32_t my_capture_png_chunk(uint8_t *out, const char *type, uint32_t len)
+{
+	my_capture_put_u32(out, len);
+	memcpy(out + 4, type, 4);
+	my_capture_put_u32(out + 8 + len, my_capture_crc(0, out + 4, len + 4));
+
+	return len + 12;
+}
+
+static uint32_t my_capture_crc(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+	uint32_t i;
+
+	crc = ~crc;
+	for(i = 0; i < len; i++) crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+static uint8_t *my_capture_put_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+
+	return p + 4;
+}
+
+static void my_capture_sig(int sig)
+{
+	(void)sig;
+
+	shot_req = 1;
+}
+
+static void my_capture_sig_task(lv_task_t *task)
+{
+	(void)task;
+
+	if(shot_req == 0) return;
+	shot_req = 0;
+
+	if(my_capture_screenshot(MY_CAPTURE_FILE) < 0) {
+		LV_LOG_WARN("my_capture: the previous screenshot is still being written");
+	}
+}
+
+static uint64_t my_capture_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /*MY_USE_CAPTURE*/
@@ -0,0 +1,82 @@
+/**
+ * @file my_capture.h
+ * Screenshots and continuous capture encoded off the UI thread
+ */
+
+#ifndef MY_CAPTURE_H
+#define MY_CAPTURE_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_CAPTURE
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t shot_cnt;          /* Written screenshots */
+	uint32_t frame_cnt;         /* Frames written by the continuous capture */
+	uint32_t tile_cnt;          /* Tiles written by the continuous capture */
+	uint32_t skip_cnt;          /* Frames merged into the next one, the encoder was busy */
+	uint32_t snap_us_max;       /* Longest copy on the UI thread */
+	uint64_t byte_cnt;          /* Encoded bytes */
+} my_capture_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Allocate the copy of the screen and start the encoder thread.
+ * SIGUSR2 writes a screenshot to MY_CAPTURE_FILE.
+ * @param hor_res horizontal resolution of the screen
+ * @param ver_res vertical resolution of the screen
+ * @return 0 on success, -1 on error
+ */
+int my_capture_init(lv_coord_t hor_res, lv_coord_t ver_res);
+
+/**
+ * Mark the tiles of a flushed area as changed, its pixels must be
+ * in the copy of the screen already (`my_shadow_flush()`).
+ * @param disp the display driver being flushed
+ * @param area the flushed area
+ */
+void my_capture_flush(lv_disp_drv_t *disp, const lv_area_t *area);
+
+/**
+ * Take a screenshot. The screen is copied now and encoded on the encoder thread.
+ * @param path the file to write, PNG if it ends with ".png", QOI otherwise
+ * @return 0 if the screenshot was taken, -1 if the previous one is still being written
+ */
+int my_capture_screenshot(const char *path);
+
+/**
+ * Start to write the changed tiles of every frame into a capture file.
+ * Each frame is a header ("LVCF", frame number, time in ms, number of tiles)
+ * followed by the tiles (x, y, size of the QOI image, QOI image),
+ * all numbers are 32 bit big endian. The first frame has every tile.
+ * @param path the file to write
+ * @return 0 on success, -1 on error
+ */
+int my_capture_start(const char *path);
+
+/**
+ * Stop the continuous capture and close its file.
+ */
+void my_capture_stop(void);
+
+/**
+ * Get the capture statistics.
+ * @param stats store the result here
+ */
+void my_capture_get_stats(my_capture_stats_t *stats);
+
+#endif /*MY_USE_CAPTURE*/
+
+#endif /*MY_CAPTURE_H*/
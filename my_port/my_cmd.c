@@ -0,0 +1,278 @@
+/**
+ * @file my_cmd.c
+ * Queue of UI commands posted by other threads
+ *
+ * A bounded lock-free queue with many producers and one consumer: every slot
+ * has a sequence number which tells whether it's free for the position being
+ * posted or holds a command for the position being read. A producer claims
+ * a position with a compare-and-swap, fills the slot and publishes it by
+ * advancing the slot's sequence; nothing waits for a lock.
+ *
+ * The main loop takes every published command once per frame. The commands
+ * are scanned from the newest: a coalesced command is dropped if a newer one
+ * has the same object and callback, so only the latest value is applied.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "my_cmd.h"
+
+#if MY_USE_CMD_QUEUE
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_CMD_MASK         (MY_CMD_QUEUE_SIZE - 1)
+#define MY_CMD_SEEN_SIZE    (MY_CMD_QUEUE_SIZE * 2)
+
+#if MY_CMD_QUEUE_SIZE & MY_CMD_MASK
+#error "MY_CMD_QUEUE_SIZE has to be a power of 2"
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t seq;               /* == position: free; == position + 1: published */
+	lv_obj_t *obj;
+	my_cmd_cb_t cb;
+	bool coalesce;
+	my_cmd_value_t value;
+} my_cmd_slot_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static bool my_cmd_seen(lv_obj_t *obj, my_cmd_cb_t cb);
+static void my_cmd_label_text_cb(lv_obj_t *obj, const my_cmd_value_t *value);
+static void my_cmd_bar_value_cb(lv_obj_t *obj, const my_cmd_value_t *value);
+static void my_cmd_chart_next_cb(lv_obj_t *obj, const my_cmd_value_t *value);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static my_cmd_slot_t slots[MY_CMD_QUEUE_SIZE];
+static uint32_t head;               /* Next position to post */
+static uint32_t tail;               /* Next position to read, only the main loop */
+static int wake_fd = -1;
+static bool wake_pending;
+
+/* Keys of the newer coalesced commands of a drain, valid if `seen_gen` matches */
+static lv_obj_t *seen_obj[MY_CMD_SEEN_SIZE];
+static my_cmd_cb_t seen_cb[MY_CMD_SEEN_SIZE];
+static uint32_t seen_gen[MY_CMD_SEEN_SIZE];
+static uint32_t gen;
+static bool skip[MY_CMD_QUEUE_SIZE];
+
+static my_cmd_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int my_cmd_init(void)
+{
+	uint32_t i;
+
+	for(i = 0; i < MY_CMD_QUEUE_SIZE; i++) {
+		slots[i].seq = i;
+	}
+
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(wake_fd < 0) {
+		perror("can not create the command event");
+		return -1;
+	}
+
+	return 0;
+}
+
+bool my_cmd_post(lv_obj_t *obj, my_cmd_cb_t cb, const my_cmd_value_t *value, bool coalesce)
+{
+	my_cmd_slot_t *slot;
+	uint32_t pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+	uint32_t seq;
+	uint64_t one = 1;
+
+	while(1) {
+		slot = &slots[pos & MY_CMD_MASK];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+		if(seq == pos) {
+			/* Free, claim it. On failure `pos` gets the current head */
+			if(__atomic_compare_exchange_n(&head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+		}
+		else if((int32_t)(seq - pos) < 0) {
+			/* Still has the command of the previous round */
+			__atomic_fetch_add(&stats.full_cnt, 1, __ATOMIC_RELAXED);
+			return false;
+		}
+		else {
+			/* Claimed by an other producer */
+			pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->obj = obj;
+	slot->cb = cb;
+	slot->coalesce = coalesce;
+	slot->value = *value;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	__atomic_fetch_add(&stats.post_cnt, 1, __ATOMIC_RELAXED);
+
+	/* Wake up the idle main loop once per drain */
+	if(__atomic_exchange_n(&wake_pending, true, __ATOMIC_ACQ_REL) == false) {
+		if(write(wake_fd, &one, sizeof(one)) < 0) perror("command event error");
+	}
+
+	return true;
+}
+
+bool my_cmd_label_set_text(lv_obj_t *label, const char *text)
+{
+	my_cmd_value_t value;
+
+	strncpy(value.text, text, MY_CMD_TEXT_LEN - 1);
+	value.text[MY_CMD_TEXT_LEN - 1] = '\0';
+
+	return my_cmd_post(label, my_cmd_label_text_cb, &value, true);
+}
+
+bool my_cmd_bar_set_value(lv_obj_t *bar, int32_t value)
+{
+	my_cmd_value_t v;
+
+	v.num = value;
+
+	return my_cmd_post(bar, my_cmd_bar_value_cb, &v, true);
+}
+
+bool my_cmd_chart_set_next(lv_obj_t *chart, lv_chart_series_t *ser, lv_coord_t value)
+{
+	my_cmd_value_t v;
+
+	v.ptr = ser;
+	v.num = value;
+
+	return my_cmd_post(chart, my_cmd_chart_next_cb, &v, false);
+}
+
+void my_cmd_handler(void)
+{
+	my_cmd_slot_t *slot;
+	uint64_t cnt;
+	uint32_t n;
+	uint32_t i;
+
+	/* Before the scan: a command posted after it wakes up the loop again.
+	 * Drain first, then clear: a post between the two skips its write, but the
+	 * exchange reads its flag, so the scan below sees its command.
+	 * Clearing first could drain the write of a post which set the flag again. */
+	if(__atomic_load_n(&wake_pending, __ATOMIC_ACQUIRE)) {
+		if(read(wake_fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN) perror("command event error");
+		(void)__atomic_exchange_n(&wake_pending, false, __ATOMIC_ACQ_REL);
+	}
+
+	/* The commands published until now, the later ones wait for the next frame */
+	for(n = 0; n < MY_CMD_QUEUE_SIZE; n++) {
+		slot = &slots[(tail + n) & MY_CMD_MASK];
+		if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + n + 1) break;
+	}
+
+	if(n == 0) return;
+
+	stats.depth = n;
+	if(n > stats.depth_max) stats.depth_max = n;
+
+	/* From the newest: drop the coalesced commands which have a newer one */
+	gen++;
+	for(i = n; i > 0; i--) {
+		slot = &slots[(tail + i - 1) & MY_CMD_MASK];
+		skip[i - 1] = slot->coalesce && my_cmd_seen(slot->obj, slot->cb);
+	}
+
+	for(i = 0; i < n; i++) {
+		slot = &slots[(tail + i) & MY_CMD_MASK];
+		if(skip[i]) {
+			stats.coalesce_cnt++;
+		}
+		else {
+			slot->cb(slot->obj, &slot->value);
+			stats.apply_cnt++;
+		}
+
+		/* Free for the next round */
+		__atomic_store_n(&slot->seq, tail + i + MY_CMD_QUEUE_SIZE, __ATOMIC_RELEASE);
+	}
+
+	tail += n;
+}
+
+int my_cmd_get_fd(void)
+{
+	return wake_fd;
+}
+
+void my_cmd_get_stats(my_cmd_stats_t *res)
+{
+	*res = stats;
+}
+
+void my_cmd_print_stats(void)
+{
+	printf("cmd: %u posted, %u applied, %u coalesced, %u dropped (full), depth %u, max %u/%u\n",
+			stats.post_cnt, stats.apply_cnt, stats.coalesce_cnt, stats.full_cnt,
+			stats.depth, stats.depth_max, MY_CMD_QUEUE_SIZE);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Check whether a newer coalesced command had the same key, and remember the key.
+ * @param obj the object of the command
+ * @param cb the callback of the command
+ * @return true if a newer command has the same key
+ */
+static bool my_cmd_seen(lv_obj_t *obj, my_cmd_cb_t cb)
+{
+	uintptr_t k = (uintptr_t)obj ^ ((uintptr_t)cb >> 4);
+	uint32_t i = ((uint32_t)(k ^ (k >> 16)) * 2654435761u) & (MY_CMD_SEEN_SIZE - 1);
+
+	/* Open addressing, at most half full */
+	while(seen_gen[i] == gen) {
+		if(seen_obj[i] == obj && seen_cb[i] == cb) return true;
+		i = (i + 1) & (MY_CMD_SEEN_SIZE - 1);
+	}
+
+	seen_gen[i] = gen;
+	seen_obj[i] = obj;
+	seen_cb[i] = cb;
+
+	return false;
+}
+
+static void my_cmd_label_text_cb(lv_obj_t *obj, const my_cmd_value_t *value)
+{
+	lv_label_set_text(obj, value->text);
+}
+
+static void my_cmd_bar_value_cb(lv_obj_t *obj, const my_cmd_value_t *value)
+{
+	lv_bar_set_value(obj, value->num, LV_ANIM_OFF);
+}
+
+static void my_cmd_chart_next_cb(lv_obj_t *obj, const my_cmd_value_t *value)
+{
+	lv_chart_set_next(obj, value->ptr, value->num);
+}
+
+#endif /*MY_USE_CMD_QUEUE*/
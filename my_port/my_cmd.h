@@ -0,0 +1,115 @@
+/**
+ * @file my_cmd.h
+ * Queue of UI commands posted by other threads
+ */
+
+#ifndef MY_CMD_H
+#define MY_CMD_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_CMD_QUEUE
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	void *ptr;
+	int32_t num;
+	char text[MY_CMD_TEXT_LEN];
+} my_cmd_value_t;
+
+/**
+ * Apply a command on the UI thread.
+ * @param obj the object of the command
+ * @param value the value posted with the command
+ */
+typedef void (*my_cmd_cb_t)(lv_obj_t *obj, const my_cmd_value_t *value);
+
+typedef struct {
+	uint32_t post_cnt;
+	uint32_t apply_cnt;
+	uint32_t coalesce_cnt;      /* Dropped, a later command set the same property */
+	uint32_t full_cnt;          /* Not posted, the queue was full */
+	uint32_t depth;             /* Commands in the queue at the last drain */
+	uint32_t depth_max;
+} my_cmd_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Create the event which wakes up the idle main loop.
+ * @return 0 on success, -1 on error
+ */
+int my_cmd_init(void);
+
+/**
+ * Post a command from any thread.
+ * The object must not be deleted while it has commands in the queue.
+ * @param obj the object to change
+ * @param cb the function which changes the property, called on the UI thread
+ * @param value copied into the queue
+ * @param coalesce true: drop it if a later command has the same `obj` and `cb`
+ * @return true if posted, false if the queue is full
+ */
+bool my_cmd_post(lv_obj_t *obj, my_cmd_cb_t cb, const my_cmd_value_t *value, bool coalesce);
+
+/**
+ * Set the text of a label from any thread. Coalesced.
+ * @param label the label
+ * @param text the new text, truncated to MY_CMD_TEXT_LEN - 1 characters
+ * @return true if posted, false if the queue is full
+ */
+bool my_cmd_label_set_text(lv_obj_t *label, const char *text);
+
+/**
+ * Set the value of a bar or slider from any thread. Coalesced.
+ * @param bar the bar or slider
+ * @param value the new value
+ * @return true if posted, false if the queue is full
+ */
+bool my_cmd_bar_set_value(lv_obj_t *bar, int32_t value);
+
+/**
+ * Add a point to a chart series from any thread. Not coalesced, every point is added.
+ * @param chart the chart
+ * @param ser the series of the chart
+ * @param value the new point
+ * @return true if posted, false if the queue is full
+ */
+bool my_cmd_chart_set_next(lv_obj_t *chart, lv_chart_series_t *ser, lv_coord_t value);
+
+/**
+ * Apply the posted commands. Called by the main loop once per frame.
+ */
+void my_cmd_handler(void);
+
+/**
+ * Get the file descriptor which is readable when commands were posted.
+ * @return the file descriptor (eventfd)
+ */
+int my_cmd_get_fd(void);
+
+/**
+ * Get the queue statistics.
+ * @param stats store the result here
+ */
+void my_cmd_get_stats(my_cmd_stats_t *stats);
+
+/**
+ * Print the statistics with printf.
+ */
+void my_cmd_print_stats(void);
+
+#endif /*MY_USE_CMD_QUEUE*/
+
+#endif /*MY_CMD_H*/
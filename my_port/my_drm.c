@@ -0,0 +1,721 @@
+/**
+ * @file my_drm.c
+ * DRM/KMS backend with dumb buffers and page flips.
+ *
+ * Two dumb buffers are flipped: LVGL's areas are copied to the back buffer
+ * and after the last area of a frame the back buffer is committed.
+ * Before the next frame the areas changed by the previous one are copied
+ * from the new front buffer, so the back buffer is always complete.
+ *
+ * Atomic drivers get the damaged areas in FB_DAMAGE_CLIPS.
+ * Only the kernel's uapi headers are used, no libdrm.
+ * It can be tried without a panel with the virtual `vkms` driver.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <drm/drm.h>
+#include <drm/drm_mode.h>
+
+#include "my_drm.h"
+#include "my_flush.h"
+#include "my_vsync.h"
+#include "my_trace.h"
+
+#if MY_USE_DRM
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_DRM_DAMAGE_MAX   16
+#define MY_DRM_PROP_MAX     64
+
+/* 'X' 'R' '2' '4' from drm_fourcc.h */
+#define MY_DRM_FORMAT_XRGB8888  ((uint32_t)'X' | ((uint32_t)'R' << 8) | ((uint32_t)'2' << 16) | ((uint32_t)'4' << 24))
+
+/* DRM_PLANE_TYPE_PRIMARY */
+#define MY_DRM_PLANE_PRIMARY    1
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t handle;
+	uint32_t fb_id;
+	uint32_t pitch;
+	uint64_t size;
+	uint8_t *map;
+} my_drm_buf_t;
+
+/* Property IDs of the atomic commit */
+typedef struct {
+	uint32_t conn_crtc_id;
+	uint32_t crtc_active;
+	uint32_t crtc_mode_id;
+	uint32_t plane_fb_id;
+	uint32_t plane_crtc_id;
+	uint32_t plane_src_x;
+	uint32_t plane_src_y;
+	uint32_t plane_src_w;
+	uint32_t plane_src_h;
+	uint32_t plane_crtc_x;
+	uint32_t plane_crtc_y;
+	uint32_t plane_crtc_w;
+	uint32_t plane_crtc_h;
+	uint32_t plane_damage;      /* 0 if FB_DAMAGE_CLIPS is not supported */
+} my_drm_props_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static int my_drm_find_output(void);
+static int my_drm_create_buf(my_drm_buf_t *buf);
+static void my_drm_destroy_buf(my_drm_buf_t *buf);
+static int my_drm_atomic_init(void);
+static uint32_t my_drm_find_prop(uint32_t obj_id, uint32_t obj_type, const char *name, uint64_t *value);
+static int my_drm_commit(bool modeset);
+static void my_drm_wait_flip(void);
+static void my_drm_add_damage(const lv_area_t *area);
+static uint64_t my_drm_now_us(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static int drm_fd = -1;
+static uint32_t conn_id;
+static uint32_t crtc_id;
+static uint32_t plane_id;
+static struct drm_mode_modeinfo mode;
+static my_drm_buf_t bufs[2];
+static uint32_t back;           /* Index of the back buffer */
+static bool flip_pending;
+static bool frame_started;
+static uint64_t commit_us;
+static lv_area_t damage[MY_DRM_DAMAGE_MAX];     /* Changed since the last shown frame */
+static uint32_t damage_cnt;
+static lv_area_t prev_damage[MY_DRM_DAMAGE_MAX];
+static uint32_t prev_damage_cnt;
+static my_drm_props_t props;
+static bool atomic;
+static my_drm_stats_t stats;
+static uint64_t latency_sum_us;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int my_drm_init(const char *path, lv_coord_t *hor_res, lv_coord_t *ver_res)
+{
+	/* The buffers are XRGB8888, the rendered pixels are copied as they are */
+	if(LV_COLOR_DEPTH != 32) {
+		fprintf(stderr, "drm: LV_COLOR_DEPTH must be 32\n");
+		return -1;
+	}
+
+	drm_fd = open(path, O_RDWR | O_CLOEXEC);
+	if(drm_fd < 0) {
+		perror("can not open drm device");
+		return -1;
+	}
+
+	memset(bufs, 0, sizeof(bufs));
+	if(my_drm_find_output() < 0 ||
+		my_drm_create_buf(&bufs[0]) < 0 || my_drm_create_buf(&bufs[1]) < 0) {
+		goto fail;
+	}
+
+	atomic = my_drm_atomic_init() == 0;
+
+	/* Show the first buffer with the mode, then render to the second */
+	back = 0;
+	if(atomic) {
+		if(my_drm_commit(true) < 0) {
+			perror("can not commit the mode");
+			goto fail;
+		}
+		/* The modeset was blocking, no event to wait for */
+		flip_pending = false;
+	}
+	else {
+		struct drm_mode_crtc crtc;
+
+		memset(&crtc, 0, sizeof(crtc));
+		crtc.crtc_id = crtc_id;
+		crtc.fb_id = bufs[0].fb_id;
+		crtc.set_connectors_ptr = (uintptr_t)&conn_id;
+		crtc.count_connectors = 1;
+		crtc.mode = mode;
+		crtc.mode_valid = 1;
+		if(ioctl(drm_fd, DRM_IOCTL_MODE_SETCRTC, &crtc) < 0) {
+			perror("can not set crtc");
+			goto fail;
+		}
+	}
+	back = 1;
+
+	stats.atomic = atomic;
+	stats.refresh_us = mode.vrefresh ? 1000000 / mode.vrefresh : 16667;
+
+	*hor_res = LV_MATH_MIN(mode.hdisplay, LV_HOR_RES_MAX);
+	*ver_res = LV_MATH_MIN(mode.vdisplay, LV_VER_RES_MAX);
+
+	printf("drm: %s %ux%u@%u, %s\n", path, mode.hdisplay, mode.vdisplay, mode.vrefresh,
+			atomic ? "atomic" : "legacy page flip");
+
+	return 0;
+
+fail:
+	my_drm_destroy_buf(&bufs[0]);
+	my_drm_destroy_buf(&bufs[1]);
+	close(drm_fd);
+	drm_fd = -1;
+	return -1;
+}
+
+void my_drm_flush(lv_disp_drv_t *disp, const lv_area_t *area, const lv_color_t *color_p)
+{
+	my_drm_buf_t *buf = &bufs[back];
+	my_drm_buf_t *front = &bufs[back ^ 1];
+	uint32_t i;
+	int32_t y;
+
+	if(frame_started == false) {
+		/* The back buffer is scanned out until the previous flip is done */
+		my_drm_wait_flip();
+
+		/* Bring the back buffer up to date with the previous frame */
+		for(i = 0; i < prev_damage_cnt; i++) {
+			const lv_area_t *a = &prev_damage[i];
+			uint32_t len = lv_area_get_width(a) * sizeof(lv_color_t);
+			for(y = a->y1; y <= a->y2; y++) {
+				uint32_t ofs = y * buf->pitch + a->x1 * sizeof(lv_color_t);
+				memcpy(buf->map + ofs, front->map + ofs, len);
+			}
+		}
+
+		frame_started = true;
+	}
+
+	my_flush_copy_lines(buf->map, buf->pitch, sizeof(lv_color_t), area, color_p, area->y1, area->y2);
+	my_drm_add_damage(area);
+
+	if(lv_disp_flush_is_last(disp)) {
+		if(my_drm_commit(false) < 0) {
+			/* The same buffer is drawn and committed again: it's already up to date,
+			 * and this frame's damage goes with the next commit's */
+			perror("can not flip");
+			prev_damage_cnt = 0;
+		}
+		else {
+			flip_pending = true;
+			back ^= 1;
+			memcpy(prev_damage, damage, sizeof(lv_area_t) * damage_cnt);
+			prev_damage_cnt = damage_cnt;
+			damage_cnt = 0;
+		}
+
+		frame_started = false;
+	}
+}
+
+void my_drm_get_stats(my_drm_stats_t *res)
+{
+	*res = stats;
+	res->latency_avg_us = stats.flip_cnt ? latency_sum_us / stats.flip_cnt : 0;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Find the first connected connector, its preferred mode and a CRTC for it.
+ * @return 0 on success, -1 if there is no usable output
+ */
+static int my_drm_find_output(void)
+{
+	struct drm_mode_card_res res;
+	uint32_t conn_ids[16];
+	uint32_t crtc_ids[16];
+	uint32_t i, j;
+
+	memset(&res, 0, sizeof(res));
+	if(ioctl(drm_fd, DRM_IOCTL_MODE_GETRESOURCES, &res) < 0) {
+		perror("can not get drm resources");
+		return -1;
+	}
+
+	if(res.count_connectors > 16) res.count_connectors = 16;
+	if(res.count_crtcs > 16) res.count_crtcs = 16;
+	res.connector_id_ptr = (uintptr_t)conn_ids;
+	res.crtc_id_ptr = (uintptr_t)crtc_ids;
+	res.count_fbs = 0;
+	res.count_encoders = 0;
+	if(ioctl(drm_fd, DRM_IOCTL_MODE_GETRESOURCES, &res) < 0) {
+		perror("can not get drm resources");
+		return -1;
+	}
+
+	for(i = 0; i < res.count_connectors; i++) {
+		struct drm_mode_get_connector conn;
+		struct drm_mode_modeinfo *modes;
+		uint32_t mode_cnt;
+		uint32_t enc_ids[8];
+		struct drm_mode_get_encoder enc;
+
+		memset(&conn, 0, sizeof(conn));
+		conn.connector_id = conn_ids[i];
+		if(ioctl(drm_fd, DRM_IOCTL_MODE_GETCONNECTOR, &conn) < 0) continue;
+		if(conn.connection != 1 || conn.count_modes == 0) continue;     /* 1: connected */
+
+		/* Monitors can have many modes, don't keep them on the stack */
+		mode_cnt = conn.count_modes;
+		modes = malloc(mode_cnt * sizeof(struct drm_mode_modeinfo));
+		if(modes == NULL) continue;
+
+		if(conn.count_encoders > 8) conn.count_encoders = 8;
+		conn.modes_ptr = (uintptr_t)modes;
+		conn.encoders_ptr = (uintptr_t)enc_ids;
+		conn.count_props = 0;
+		/* The modes are not copied if there are more of them since the first call */
+		if(ioctl(drm_fd, DRM_IOCTL_MODE_GETCONNECTOR, &conn) < 0 ||
+			conn.count_modes == 0 || conn.count_modes > mode_cnt) {
+			free(modes);
+			continue;
+		}
+
+		/* The preferred mode or the first one */
+		mode = modes[0];
+		for(j = 0; j < conn.count_modes; j++) {
+			if(modes[j].type & DRM_MODE_TYPE_PREFERRED) {
+				mode = modes[j];
+				break;
+			}
+		}
+		free(modes);
+
+		/* A CRTC which can drive one of the encoders */
+		for(j = 0; j < conn.count_encoders; j++) {
+			uint32_t k;
+
+			memset(&enc, 0, sizeof(enc));
+			enc.encoder_id = enc_ids[j];
+			if(ioctl(drm_fd, DRM_IOCTL_MODE_GETENCODER, &enc) < 0) continue;
+
+			for(k = 0; k < res.count_crtcs; k++) {
+				if(enc.possible_crtcs & (1 << k)) {
+					conn_id = conn_ids[i];
+					crtc_id = crtc_ids[k];
+					return 0;
+				}
+			}
+		}
+	}
+
+	fprintf(stderr, "drm: no connected output\n");
+	return -1;
+}
+
+/**
+ * Create a dumb buffer of the mode's size, add it as framebuffer and map it.
+ * @param buf store the buffer here, it's zeroed. Destroy it with `my_drm_destroy_buf()` on error too.
+ * @return 0 on success, -1 on error
+ */
+static int my_drm_create_buf(my_drm_buf_t *buf)
+{
+	struct drm_mode_create_dumb creq;
+	struct drm_mode_fb_cmd2 fb;
+	struct drm_mode_map_dumb mreq;
+	void *map;
+
+	memset(&creq, 0, sizeof(creq));
+	creq.width = mode.hdisplay;
+	creq.height = mode.vdisplay;
+	creq.bpp = 32;
+	if(ioctl(drm_fd, DRM_IOCTL_MODE_CREATE_DUMB, &creq) < 0) {
+		perror("can not create dumb buffer");
+		return -1;
+	}
+	buf->handle = creq.handle;
+	buf->pitch = creq.pitch;
+	buf->size = creq.size;
+
+	memset(&fb, 0, sizeof(fb));
+	fb.width = mode.hdisplay;
+	fb.height = mode.vdisplay;
+	fb.pixel_format = MY_DRM_FORMAT_XRGB8888;   /* lv_color_t with LV_COLOR_DEPTH 32 */
+	fb.handles[0] = creq.handle;
+	fb.pitches[0] = creq.pitch;
+	if(ioctl(drm_fd, DRM_IOCTL_MODE_ADDFB2, &fb) < 0) {
+		perror("can not add framebuffer");
+		return -1;
+	}
+	buf->fb_id = fb.fb_id;
+
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.handle = creq.handle;
+	if(ioctl(drm_fd, DRM_IOCTL_MODE_MAP_DUMB, &mreq) < 0) {
+		perror("can not map dumb buffer");
+		return -1;
+	}
+
+	map = mmap(NULL, creq.size, PROT_READ | PROT_WRITE, MAP_SHARED, drm_fd, mreq.offset);
+	if(map == MAP_FAILED) {
+		perror("can not mmap dumb buffer");
+		return -1;
+	}
+	buf->map = map;
+
+	return 0;
+}
+
+/**
+ * Unmap, remove and destroy the parts of a buffer which were created.
+ * @param buf the buffer, it's zeroed
+ */
+static void my_drm_destroy_buf(my_drm_buf_t *buf)
+{
+	struct drm_mode_destroy_dumb dreq;
+
+	if(buf->map) munmap(buf->map, buf->size);
+	if(buf->fb_id) ioctl(drm_fd, DRM_IOCTL_MODE_RMFB, &buf->fb_id);
+	if(buf->handle) {
+		memset(&dreq, 0, sizeof(dreq));
+		dreq.handle = buf->handle;
+		ioctl(drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+	}
+
+	memset(buf, 0, sizeof(my_drm_buf_t));
+}
+
+/**
+ * Enable atomic mode setting, find the primary plane of the CRTC
+ * and the IDs of the properties to commit.
+ * @return 0 if atomic commits can be used
+ */
+static int my_drm_atomic_init(void)
+{
+	struct drm_set_client_cap cap;
+	struct drm_mode_get_plane_res pres;
+	uint32_t plane_ids[32];
+	uint32_t crtc_idx = 0;
+	uint32_t i;
+
+	cap.capability = DRM_CLIENT_CAP_UNIVERSAL_PLANES;
+	cap.value = 1;
+	if(ioctl(drm_fd, DRM_IOCTL_SET_CLIENT_CAP, &cap) < 0) return -1;
+	cap.capability = DRM_CLIENT_CAP_ATOMIC;
+	cap.value = 1;
+	if(ioctl(drm_fd, DRM_IOCTL_SET_CLIENT_CAP, &cap) < 0) return -1;
+
+	/* `possible_crtcs` of the planes is a mask of CRTC indices */
+	{
+		struct drm_mode_card_res res;
+		uint32_t crtc_ids[16];
+
+		memset(&res, 0, sizeof(res));
+		res.crtc_id_ptr = (uintptr_t)crtc_ids;
+		res.count_crtcs = 16;
+		if(ioctl(drm_fd, DRM_IOCTL_MODE_GETRESOURCES, &res) < 0) return -1;
+		for(i = 0; i < res.count_crtcs && i < 16; i++) {
+			if(crtc_ids[i] == crtc_id) crtc_idx = i;
+		}
+	}
+
+	memset(&pres, 0, sizeof(pres));
+	pres.plane_id_ptr = (uintptr_t)plane_ids;
+	pres.count_planes = 32;
+	if(ioctl(drm_fd, DRM_IOCTL_MODE_GETPLANERESOURCES, &pres) < 0) return -1;
+	if(pres.count_planes > 32) pres.count_planes = 32;
+
+	plane_id = 0;
+	for(i = 0; i < pres.count_planes && plane_id == 0; i++) {
+		struct drm_mode_get_plane plane;
+		uint64_t type = 0;
+
+		memset(&plane, 0, sizeof(plane));
+		plane.plane_id = plane_ids[i];
+		if(ioctl(drm_fd, DRM_IOCTL_MODE_GETPLANE, &plane) < 0) continue;
+		if((plane.possible_crtcs & (1 << crtc_idx)) == 0) continue;
+
+		if(my_drm_find_prop(plane_ids[i], DRM_MODE_OBJECT_PLANE, "type", &type) &&
+			type == MY_DRM_PLANE_PRIMARY) {
+			plane_id = plane_ids[i];
+		}
+	}
+	if(plane_id == 0) return -1;
+
+	props.conn_crtc_id = my_drm_find_prop(conn_id, DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID", NULL);
+	props.crtc_active = my_drm_find_prop(crtc_id, DRM_MODE_OBJECT_CRTC, "ACTIVE", NULL);
+	props.crtc_mode_id = my_drm_find_prop(crtc_id, DRM_MODE_OBJECT_CRTC, "MODE_ID", NULL);
+	props.plane_fb_id = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "FB_ID", NULL);
+	props.plane_crtc_id = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_ID", NULL);
+	props.plane_src_x = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_X", NULL);
+	props.plane_src_y = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_Y", NULL);
+	props.plane_src_w = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_W", NULL);
+	props.plane_src_h = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_H", NULL);
+	props.plane_crtc_x = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_X", NULL);
+	props.plane_crtc_y = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_Y", NULL);
+	props.plane_crtc_w = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_W", NULL);
+	props.plane_crtc_h = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_H", NULL);
+	props.plane_damage = my_drm_find_prop(plane_id, DRM_MODE_OBJECT_PLANE, "FB_DAMAGE_CLIPS", NULL);
+
+	if(props.conn_crtc_id == 0 || props.crtc_active == 0 || props.crtc_mode_id == 0 ||
+		props.plane_fb_id == 0 || props.plane_crtc_id == 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Find a property of a DRM object by name.
+ * @param obj_id ID of the object
+ * @param obj_type DRM_MODE_OBJECT_...
+ * @param name name of the property
+ * @param value store the current value here (can be NULL)
+ * @return ID of the property or 0 if not found
+ */
+static uint32_t my_drm_find_prop(uint32_t obj_id, uint32_t obj_type, const char *name, uint64_t *value)
+{
+	struct drm_mode_obj_get_properties obj;
+	uint32_t prop_ids[MY_DRM_PROP_MAX];
+	uint64_t prop_values[MY_DRM_PROP_MAX];
+	uint32_t i;
+
+	memset(&obj, 0, sizeof(obj));
+	obj.obj_id = obj_id;
+	obj.obj_type = obj_type;
+	obj.props_ptr = (uintptr_t)prop_ids;
+	obj.prop_values_ptr = (uintptr_t)prop_values;
+	obj.count_props = MY_DRM_PROP_MAX;
+	if(ioctl(drm_fd, DRM_IOCTL_MODE_OBJ_GETPROPERTIES, &obj) < 0) return 0;
+	if(obj.count_props > MY_DRM_PROP_MAX) obj.count_props = MY_DRM_PROP_MAX;
+
+	for(i = 0; i < obj.count_props; i++) {
+		struct drm_mode_get_property prop;
+
+		memset(&prop, 0, sizeof(prop));
+		prop.prop_id = prop_ids[i];
+		if(ioctl(drm_fd, DRM_IOCTL_MODE_GETPROPERTY, &prop) < 0) continue;
+
+		if(strcmp(prop.name, name) == 0) {
+			if(value) *value = prop_values[i];
+			return prop_ids[i];
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Show the back buffer.
+ * Atomic: commit the plane with the damaged areas, non-blocking with a flip event.
+ * Legacy: page flip with an event.
+ * @param modeset true: set the mode too (blocking, first commit only)
+ * @return 0 on success, -1 on error
+ */
+static int my_drm_commit(bool modeset)
+{
+	my_drm_buf_t *buf = &bufs[back];
+	int res;
+
+	commit_us = my_drm_now_us();
+
+	if(atomic) {
+		struct drm_mode_atomic req;
+		uint32_t objs[3];
+		uint32_t count_props[3];
+		uint32_t prop_ids[20];
+		uint64_t values[20];
+		uint32_t obj_cnt = 0;
+		uint32_t prop_cnt = 0;
+		uint32_t mode_blob = 0;
+		uint32_t damage_blob = 0;
+		struct drm_mode_rect rects[MY_DRM_DAMAGE_MAX];
+		uint32_t i;
+
+#define MY_DRM_ADD_PROP(id, val) do { if(id) { prop_ids[prop_cnt] = (id); values[prop_cnt] = (val); prop_cnt++; count_props[obj_cnt - 1]++; } } while(0)
+
+		if(modeset) {
+			struct drm_mode_create_blob blob;
+
+			memset(&blob, 0, sizeof(blob));
+			blob.data = (uintptr_t)&mode;
+			blob.length = sizeof(mode);
+			if(ioctl(drm_fd, DRM_IOCTL_MODE_CREATEPROPBLOB, &blob) < 0) return -1;
+			mode_blob = blob.blob_id;
+
+			objs[obj_cnt] = conn_id;
+			count_props[obj_cnt++] = 0;
+			MY_DRM_ADD_PROP(props.conn_crtc_id, crtc_id);
+
+			objs[obj_cnt] = crtc_id;
+			count_props[obj_cnt++] = 0;
+			MY_DRM_ADD_PROP(props.crtc_active, 1);
+			MY_DRM_ADD_PROP(props.crtc_mode_id, mode_blob);
+		}
+
+		objs[obj_cnt] = plane_id;
+		count_props[obj_cnt++] = 0;
+		MY_DRM_ADD_PROP(props.plane_fb_id, buf->fb_id);
+		if(modeset) {
+			MY_DRM_ADD_PROP(props.plane_crtc_id, crtc_id);
+			MY_DRM_ADD_PROP(props.plane_src_x, 0);
+			MY_DRM_ADD_PROP(props.plane_src_y, 0);
+			MY_DRM_ADD_PROP(props.plane_src_w, (uint64_t)mode.hdisplay << 16);
+			MY_DRM_ADD_PROP(props.plane_src_h, (uint64_t)mode.vdisplay << 16);
+			MY_DRM_ADD_PROP(props.plane_crtc_x, 0);
+			MY_DRM_ADD_PROP(props.plane_crtc_y, 0);
+			MY_DRM_ADD_PROP(props.plane_crtc_w, mode.hdisplay);
+			MY_DRM_ADD_PROP(props.plane_crtc_h, mode.vdisplay);
+		}
+		else if(props.plane_damage && damage_cnt) {
+			struct drm_mode_create_blob blob;
+
+			/* drm_mode_rect has exclusive x2/y2 */
+			for(i = 0; i < damage_cnt; i++) {
+				rects[i].x1 = damage[i].x1;
+				rects[i].y1 = damage[i].y1;
+				rects[i].x2 = damage[i].x2 + 1;
+				rects[i].y2 = damage[i].y2 + 1;
+			}
+
+			memset(&blob, 0, sizeof(blob));
+			blob.data = (uintptr_t)rects;
+			blob.length = sizeof(struct drm_mode_rect) * damage_cnt;
+			if(ioctl(drm_fd, DRM_IOCTL_MODE_CREATEPROPBLOB, &blob) == 0) {
+				damage_blob = blob.blob_id;
+				MY_DRM_ADD_PROP(props.plane_damage, damage_blob);
+			}
+		}
+
+#undef MY_DRM_ADD_PROP
+
+		memset(&req, 0, sizeof(req));
+		req.flags = modeset ? DRM_MODE_ATOMIC_ALLOW_MODESET : (DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT);
+		req.count_objs = obj_cnt;
+		req.objs_ptr = (uintptr_t)objs;
+		req.count_props_ptr = (uintptr_t)count_props;
+		req.props_ptr = (uintptr_t)prop_ids;
+		req.prop_values_ptr = (uintptr_t)values;
+		res = ioctl(drm_fd, DRM_IOCTL_MODE_ATOMIC, &req);
+
+		/* The commit holds its own references of the blobs */
+		if(mode_blob) {
+			struct drm_mode_destroy_blob d = { .blob_id = mode_blob };
+			ioctl(drm_fd, DRM_IOCTL_MODE_DESTROYPROPBLOB, &d);
+		}
+		if(damage_blob) {
+			struct drm_mode_destroy_blob d = { .blob_id = damage_blob };
+			ioctl(drm_fd, DRM_IOCTL_MODE_DESTROYPROPBLOB, &d);
+		}
+	}
+	else {
+		struct drm_mode_crtc_page_flip flip;
+
+		memset(&flip, 0, sizeof(flip));
+		flip.crtc_id = crtc_id;
+		flip.fb_id = buf->fb_id;
+		flip.flags = DRM_MODE_PAGE_FLIP_EVENT;
+		res = ioctl(drm_fd, DRM_IOCTL_MODE_PAGE_FLIP, &flip);
+	}
+
+	return res < 0 ? -1 : 0;
+}
+
+/**
+ * Wait for the flip event of the last commit and update the statistics.
+ */
+static void my_drm_wait_flip(void)
+{
+	struct pollfd pfd;
+	uint8_t ev_buf[1024];
+	ssize_t len;
+	ssize_t i;
+
+	pfd.fd = drm_fd;
+	pfd.events = POLLIN;
+
+	while(flip_pending) {
+		int res = poll(&pfd, 1, 1000);
+		if(res < 0 && errno == EINTR) continue;
+		if(res <= 0) {
+			fprintf(stderr, "drm: no flip event\n");
+			flip_pending = false;
+			break;
+		}
+
+		len = read(drm_fd, ev_buf, sizeof(ev_buf));
+		for(i = 0; i + (ssize_t)sizeof(struct drm_event) <= len;) {
+			struct drm_event *ev = (struct drm_event *)&ev_buf[i];
+
+			if(ev->type == DRM_EVENT_FLIP_COMPLETE) {
+				struct drm_event_vblank *vb = (struct drm_event_vblank *)ev;
+				uint64_t flip_us = (uint64_t)vb->tv_sec * 1000000 + vb->tv_usec;
+				uint32_t latency = flip_us > commit_us ? flip_us - commit_us : 0;
+
+				stats.flip_cnt++;
+				latency_sum_us += latency;
+				if(latency > stats.latency_max_us) stats.latency_max_us = latency;
+				/* Committed in time it's shown on the next vblank */
+				if(latency > stats.refresh_us) stats.drop_cnt++;
+
+				flip_pending = false;
+#if MY_USE_VSYNC
+				my_vsync_vblank(flip_us);
+#endif
+#if MY_USE_TRACE
+				my_trace_add(MY_TRACE_FLIP, commit_us, NULL);
+#endif
+			}
+			i += ev->length;
+		}
+	}
+}
+
+/**
+ * Add an area to the damage of the frame.
+ * If there are too many areas they are joined to their bounding box.
+ * @param area the flushed area
+ */
+static void my_drm_add_damage(const lv_area_t *area)
+{
+	uint32_t i;
+
+	if(damage_cnt < MY_DRM_DAMAGE_MAX) {
+		lv_area_copy(&damage[damage_cnt++], area);
+		return;
+	}
+
+	for(i = 1; i < damage_cnt; i++) {
+		_lv_area_join(&damage[0], &damage[0], &damage[i]);
+	}
+	_lv_area_join(&damage[0], &damage[0], area);
+	damage_cnt = 1;
+}
+
+static uint64_t my_drm_now_us(void)
+{
+	struct timespec ts;
+
+	/* Flip events are stamped with CLOCK_MONOTONIC */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /*MY_USE_DRM*/
@@ -0,0 +1,64 @@
+/**
+ * @file my_drm.h
+ * DRM/KMS backend with dumb buffers and page flips
+ */
+
+#ifndef MY_DRM_H
+#define MY_DRM_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_DRM
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t flip_cnt;
+	uint32_t drop_cnt;          /* Flips which missed the vblank after their commit */
+	uint32_t latency_avg_us;    /* Commit to flip event */
+	uint32_t latency_max_us;
+	uint32_t refresh_us;        /* Refresh period of the mode */
+	bool atomic;                /* Atomic commits or legacy page flips */
+} my_drm_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Open a DRM device, set the preferred mode of the first connected connector
+ * and create two dumb buffers to flip between.
+ * Atomic commits are used if the driver supports them.
+ * @param path path of the device, e.g. "/dev/dri/card0"
+ * @param hor_res store the horizontal resolution here
+ * @param ver_res store the vertical resolution here
+ * @return 0 on success, -1 on error
+ */
+int my_drm_init(const char *path, lv_coord_t *hor_res, lv_coord_t *ver_res);
+
+/**
+ * Copy a rendered area to the back buffer.
+ * After the last area of a frame the back buffer is flipped with the damaged areas.
+ * It doesn't call `lv_disp_flush_ready()`.
+ * @param disp the display driver being flushed
+ * @param area the area to flush
+ * @param color_p the rendered pixels of `area`
+ */
+void my_drm_flush(lv_disp_drv_t *disp, const lv_area_t *area, const lv_color_t *color_p);
+
+/**
+ * Get the flip statistics.
+ * @param stats store the result here
+ */
+void my_drm_get_stats(my_drm_stats_t *stats);
+
+#endif /*MY_USE_DRM*/
+
+#endif /*MY_DRM_H*/
@@ -0,0 +1,480 @@
+/**
+ * @file my_flush.c
+ * Copy rendered areas into the framebuffer
+ *
+ * LVGL v7 renders on the main thread only, the workers parallelize the copy
+ * of the rendered areas to the framebuffer. It pays off where writing the
+ * framebuffer is slow (uncached or write-combined memory), MY_FLUSH_BENCH
+ * measures it on the target.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "my_flush.h"
+#include "my_sched.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+#if MY_USE_TILE_HASH
+#define HASH_P1     11400714785074694791ULL
+#define HASH_P2     14029467366897019727ULL
+#define HASH_P3     1609587929392839161ULL
+
+/* Pixels hashed per round of the 4 lanes (4 x 8 bytes) */
+#define HASH_STEP_PX    (4 * sizeof(uint64_t) / sizeof(lv_color_t))
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+#if MY_USE_FLUSH_WORKERS
+typedef struct {
+	pthread_t thread;
+	uint32_t id;
+} my_flush_worker_t;
+#endif
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+#if MY_USE_FLUSH_WORKERS
+static void *my_flush_worker_thread(void *arg);
+#endif
+#if MY_USE_FLUSH_WORKERS && MY_FLUSH_BENCH
+static uint32_t my_flush_bench_copy(lv_disp_drv_t *disp, const lv_area_t *area, const lv_color_t *src, bool parallel);
+#endif
+#if MY_USE_TILE_HASH
+static uint64_t my_flush_hash_tile(const lv_color_t *src, uint32_t stride, const lv_area_t *tile);
+#if MY_TILE_HASH_STATS_PERIOD
+static void my_flush_stats_task(lv_task_t *task);
+#endif
+#endif
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+#if MY_USE_FLUSH_WORKERS
+static my_flush_worker_t workers[MY_FLUSH_WORKER_CNT];
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+
+/* The job being flushed. Written only while no band is pending. */
+static unsigned char *job_fb_base;
+static uint32_t job_line_width;
+static uint32_t job_pixel_width;
+static lv_disp_drv_t *job_disp;
+static lv_area_t job_area;
+static const lv_color_t *job_src;
+static uint32_t job_band_cnt;
+static uint32_t job_seq;
+static uint32_t job_pending;
+#if MY_USE_SCHED
+static uint64_t job_post_us;
+#endif
+#endif
+
+#if MY_USE_TILE_HASH
+static uint64_t *tile_hashes;       /* Hash of the last copy to each tile */
+static uint32_t tiles_x;
+static my_flush_stats_t stats;
+#endif
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_flush_copy_lines(unsigned char *dst, uint32_t line_width, uint32_t pixel_width,
+			const lv_area_t *area, const lv_color_t *src, int32_t y1, int32_t y2)
+{
+	int32_t w = lv_area_get_width(area);
+	int32_t y;
+
+	src += (y1 - area->y1) * w;
+	dst += y1 * line_width + area->x1 * pixel_width;
+
+	/* The rendered lines are contiguous, so copy them line by line */
+	for(y = y1; y <= y2; y++) {
+		memcpy(dst, src, w * pixel_width);
+		dst += line_width;
+		src += w;
+	}
+}
+
+#if MY_USE_TILE_HASH
+int my_flush_tile_hash_init(lv_coord_t hor_res, lv_coord_t ver_res)
+{
+	uint32_t tiles_y = (ver_res + MY_TILE_HASH_H - 1) / MY_TILE_HASH_H;
+
+	tiles_x = (hor_res + MY_TILE_HASH_W - 1) / MY_TILE_HASH_W;
+
+	/* 0 is never a hash, so every tile is copied the first time */
+	tile_hashes = calloc(tiles_x * tiles_y, sizeof(uint64_t));
+	if(tile_hashes == NULL) {
+		perror("can not allocate tile hashes");
+		return -1;
+	}
+
+#if MY_TILE_HASH_STATS_PERIOD
+	lv_task_create(my_flush_stats_task, MY_TILE_HASH_STATS_PERIOD, LV_TASK_PRIO_LOWEST, NULL);
+#endif
+
+	return 0;
+}
+
+void my_flush_copy_changed(unsigned char *dst, uint32_t line_width, uint32_t pixel_width,
+			const lv_area_t *area, const lv_color_t *src, int32_t y1, int32_t y2)
+{
+	int32_t w = lv_area_get_width(area);
+	lv_area_t tile;
+	uint32_t tile_cnt = 0;
+	uint32_t skip_cnt = 0;
+	uint32_t copied = 0;
+	uint32_t saved = 0;
+	int32_t y;
+
+	for(tile.y1 = y1; tile.y1 <= y2; tile.y1 = tile.y2 + 1) {
+		/* Till the end of the tile row */
+		tile.y2 = LV_MATH_MIN((tile.y1 / MY_TILE_HASH_H + 1) * MY_TILE_HASH_H - 1, y2);
+
+		for(tile.x1 = area->x1; tile.x1 <= area->x2; tile.x1 = tile.x2 + 1) {
+			uint64_t *slot;
+			uint64_t hash;
+			uint32_t len;
+
+			tile.x2 = LV_MATH_MIN((tile.x1 / MY_TILE_HASH_W + 1) * MY_TILE_HASH_W - 1, area->x2);
+			slot = &tile_hashes[(tile.y1 / MY_TILE_HASH_H) * tiles_x + tile.x1 / MY_TILE_HASH_W];
+			len = lv_area_get_width(&tile) * pixel_width;
+			tile_cnt++;
+
+			/* The part of the tile and its pixels are hashed together: the last copy
+			 * to the tile is still in the framebuffer, equal hashes mean equal pixels there */
+			hash = my_flush_hash_tile(&src[(tile.y1 - area->y1) * w + (tile.x1 - area->x1)], w, &tile);
+			if(hash == *slot) {
+				skip_cnt++;
+				saved += len * lv_area_get_height(&tile);
+				continue;
+			}
+			*slot = hash;
+
+			for(y = tile.y1; y <= tile.y2; y++) {
+				memcpy(dst + y * line_width + tile.x1 * pixel_width,
+						&src[(y - area->y1) * w + (tile.x1 - area->x1)], len);
+			}
+			copied += len * lv_area_get_height(&tile);
+		}
+	}
+
+	/* The workers update them in parallel */
+	__atomic_fetch_add(&stats.tile_cnt, tile_cnt, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.skip_cnt, skip_cnt, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.copied_bytes, copied, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.saved_bytes, saved, __ATOMIC_RELAXED);
+}
+
+void my_flush_tile_hash_forget(const lv_area_t *area)
+{
+	uint32_t tx;
+	uint32_t ty;
+
+	for(ty = area->y1 / MY_TILE_HASH_H; ty <= area->y2 / MY_TILE_HASH_H; ty++) {
+		for(tx = area->x1 / MY_TILE_HASH_W; tx <= area->x2 / MY_TILE_HASH_W; tx++) {
+			tile_hashes[ty * tiles_x + tx] = 0;
+		}
+	}
+}
+
+void my_flush_get_stats(my_flush_stats_t *res)
+{
+	*res = stats;
+}
+
+void my_flush_print_stats(void)
+{
+	uint64_t total = stats.copied_bytes + stats.saved_bytes;
+
+	printf("flush: %llu of %llu tiles unchanged, %llu of %llu kB not written (%u%%)\n",
+			(unsigned long long)stats.skip_cnt, (unsigned long long)stats.tile_cnt,
+			(unsigned long long)stats.saved_bytes / 1024, (unsigned long long)total / 1024,
+			total ? (uint32_t)(stats.saved_bytes * 100 / total) : 0);
+}
+#endif /*MY_USE_TILE_HASH*/
+
+#if MY_USE_FLUSH_WORKERS
+int my_flush_workers_init(unsigned char *fb_base, uint32_t line_width, uint32_t pixel_width)
+{
+	uint32_t i;
+
+	job_fb_base = fb_base;
+	job_line_width = line_width;
+	job_pixel_width = pixel_width;
+
+	for(i = 0; i < MY_FLUSH_WORKER_CNT; i++) {
+		workers[i].id = i;
+		if(pthread_create(&workers[i].thread, NULL, my_flush_worker_thread, &workers[i]) != 0) {
+			perror("can not create flush worker");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void my_flush_workers_submit(lv_disp_drv_t *disp, const lv_area_t *area, const lv_color_t *color_p)
+{
+	uint32_t band_cnt = lv_area_get_height(area) / MY_FLUSH_BAND_MIN_LINES;
+
+	if(band_cnt < 1) band_cnt = 1;
+	if(band_cnt > MY_FLUSH_WORKER_CNT) band_cnt = MY_FLUSH_WORKER_CNT;
+
+	pthread_mutex_lock(&job_lock);
+
+	/* LVGL doesn't flush again before the previous flush is ready, but be safe */
+	while(job_pending) pthread_cond_wait(&job_done, &job_lock);
+
+	job_disp = disp;
+	lv_area_copy(&job_area, area);
+	job_src = color_p;
+	job_band_cnt = band_cnt;
+	job_pending = band_cnt;
+	job_seq++;
+#if MY_USE_SCHED
+	job_post_us = my_sched_now_us();
+#endif
+
+	pthread_cond_broadcast(&job_start);
+	pthread_mutex_unlock(&job_lock);
+}
+
+void my_flush_workers_wait(lv_disp_drv_t *disp)
+{
+	(void)disp;
+
+	pthread_mutex_lock(&job_lock);
+	while(job_pending) pthread_cond_wait(&job_done, &job_lock);
+	pthread_mutex_unlock(&job_lock);
+}
+
+#if MY_FLUSH_BENCH
+void my_flush_bench(lv_disp_drv_t *disp)
+{
+	lv_area_t area;
+	lv_color_t *src;
+	uint32_t size;
+	uint32_t t_single;
+	uint32_t t_workers;
+	int32_t y;
+
+	lv_area_set(&area, 0, 0, disp->hor_res - 1, disp->ver_res - 1);
+	size = lv_area_get_size(&area) * sizeof(lv_color_t);
+	src = malloc(size);
+	if(src == NULL) {
+		printf("flush bench: can not allocate %u kB\n", size / 1024);
+		return;
+	}
+
+	/* Copy the current content back, the screen doesn't change */
+	my_flush_workers_wait(disp);
+	for(y = area.y1; y <= area.y2; y++) {
+		memcpy(&src[y * disp->hor_res], job_fb_base + y * job_line_width, disp->hor_res * job_pixel_width);
+	}
+
+	/* Warm up the caches */
+	my_flush_bench_copy(disp, &area, src, false);
+
+	t_single = my_flush_bench_copy(disp, &area, src, false);
+	t_workers = my_flush_bench_copy(disp, &area, src, true);
+
+	printf("flush bench: %dx%d x %d, 1 thread: %u us, %d workers: %u us (%u%%)\n",
+			disp->hor_res, disp->ver_res, MY_FLUSH_BENCH_LOOPS, t_single, MY_FLUSH_WORKER_CNT, t_workers,
+			t_single ? t_workers * 100 / t_single : 0);
+
+	free(src);
+}
+#endif /*MY_FLUSH_BENCH*/
+#endif /*MY_USE_FLUSH_WORKERS*/
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+#if MY_USE_FLUSH_WORKERS
+/**
+ * Wait for a new area and copy this worker's band of it.
+ * Band `i` of `n` covers the lines [h * i / n, h * (i + 1) / n) of the area.
+ * @param arg pointer to the worker's `my_flush_worker_t`
+ * @return never returns
+ */
+static void *my_flush_worker_thread(void *arg)
+{
+	my_flush_worker_t *worker = arg;
+	uint32_t seen_seq = 0;
+	lv_area_t area;
+	const lv_color_t *src;
+	uint32_t band_cnt;
+	int32_t h, y1, y2;
+
+#if MY_USE_SCHED
+	my_sched_apply(MY_SCHED_ROLE_FLUSH, "lv-flush");
+#endif
+
+	while(1) {
+		pthread_mutex_lock(&job_lock);
+		while(seen_seq == job_seq) pthread_cond_wait(&job_start, &job_lock);
+		seen_seq = job_seq;
+#if MY_USE_SCHED
+		my_sched_woke(job_post_us);
+#endif
+		lv_area_copy(&area, &job_area);
+		src = job_src;
+		band_cnt = job_band_cnt;
+		pthread_mutex_unlock(&job_lock);
+
+		if(worker->id >= band_cnt) continue;	/* Not needed for this area */
+
+		h = lv_area_get_height(&area);
+		y1 = area.y1 + h * worker->id / band_cnt;
+		y2 = area.y1 + h * (worker->id + 1) / band_cnt - 1;
+#if MY_USE_TILE_HASH
+		/* Whole tile rows, so only one worker writes a tile's hash */
+		if(worker->id != 0) y1 = (y1 + MY_TILE_HASH_H - 1) / MY_TILE_HASH_H * MY_TILE_HASH_H;
+		if(worker->id != band_cnt - 1) {
+			y2 = LV_MATH_MIN((y2 + 1 + MY_TILE_HASH_H - 1) / MY_TILE_HASH_H * MY_TILE_HASH_H - 1, area.y2);
+		}
+		if(y1 <= y2) my_flush_copy_changed(job_fb_base, job_line_width, job_pixel_width, &area, src, y1, y2);
+#else
+		my_flush_copy_lines(job_fb_base, job_line_width, job_pixel_width, &area, src, y1, y2);
+#endif
+
+		pthread_mutex_lock(&job_lock);
+		job_pending--;
+		if(job_pending == 0) {
+			/* Every band is on the screen, the draw buffer can be reused */
+			lv_disp_flush_ready(job_disp);
+			pthread_cond_broadcast(&job_done);
+		}
+		pthread_mutex_unlock(&job_lock);
+	}
+
+	return NULL;
+}
+
+#if MY_FLUSH_BENCH
+/**
+ * Copy an area to the framebuffer MY_FLUSH_BENCH_LOOPS times, the way the flush does.
+ * @param disp the display driver
+ * @param area the area to copy
+ * @param src the pixels of `area`
+ * @param parallel true: with the workers, false: on this thread
+ * @return the elapsed time in microseconds
+ */
+static uint32_t my_flush_bench_copy(lv_disp_drv_t *disp, const lv_area_t *area, const lv_color_t *src, bool parallel)
+{
+	struct timespec t1, t2;
+	uint32_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	for(i = 0; i < MY_FLUSH_BENCH_LOOPS; i++) {
+#if MY_USE_TILE_HASH
+		/* Copy every tile, not only the changed ones */
+		my_flush_tile_hash_forget(area);
+#endif
+		if(parallel) {
+			my_flush_workers_submit(disp, area, src);
+			my_flush_workers_wait(disp);
+		}
+		else {
+#if MY_USE_TILE_HASH
+			my_flush_copy_changed(job_fb_base, job_line_width, job_pixel_width, area, src, area->y1, area->y2);
+#else
+			my_flush_copy_lines(job_fb_base, job_line_width, job_pixel_width, area, src, area->y1, area->y2);
+#endif
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	return (t2.tv_sec - t1.tv_sec) * 1000000 + (t2.tv_nsec - t1.tv_nsec) / 1000;
+}
+#endif /*MY_FLUSH_BENCH*/
+#endif /*MY_USE_FLUSH_WORKERS*/
+
+#if MY_USE_TILE_HASH
+static inline uint64_t my_flush_hash_round(uint64_t acc, uint64_t in)
+{
+	acc += in * HASH_P2;
+	acc = (acc << 31) | (acc >> 33);
+	return acc * HASH_P1;
+}
+
+/**
+ * Hash a part of a tile with its coordinates.
+ * Four independent lanes of XXH64-style rounds consume 32 bytes per step,
+ * so the multiplications of the lanes overlap.
+ * @param src the first pixel of the part
+ * @param stride pixels in a line of `src`
+ * @param tile the coordinates of the part
+ * @return the hash, never 0
+ */
+static uint64_t my_flush_hash_tile(const lv_color_t *src, uint32_t stride, const lv_area_t *tile)
+{
+	uint32_t w = lv_area_get_width(tile);
+	uint32_t lines = lv_area_get_height(tile);
+	uint64_t seed = (uint64_t)(uint16_t)tile->x1 | (uint64_t)(uint16_t)tile->y1 << 16 |
+					(uint64_t)w << 32 | (uint64_t)lines << 48;
+	uint64_t acc[4];
+	uint64_t in[4];
+	uint64_t h;
+	uint32_t x;
+	uint32_t y;
+
+	acc[0] = seed + HASH_P1 + HASH_P2;
+	acc[1] = seed + HASH_P2;
+	acc[2] = seed;
+	acc[3] = seed - HASH_P1;
+
+	for(y = 0; y < lines; y++) {
+		const lv_color_t *p = &src[y * stride];
+
+		/* 32 bytes per step: 8 pixels with LV_COLOR_DEPTH 32, 16 with 16 */
+		for(x = 0; x + HASH_STEP_PX <= w; x += HASH_STEP_PX) {
+			memcpy(in, &p[x], sizeof(in));
+			acc[0] = my_flush_hash_round(acc[0], in[0]);
+			acc[1] = my_flush_hash_round(acc[1], in[1]);
+			acc[2] = my_flush_hash_round(acc[2], in[2]);
+			acc[3] = my_flush_hash_round(acc[3], in[3]);
+		}
+		for(; x < w; x++) {
+			acc[x & 3] = my_flush_hash_round(acc[x & 3], p[x].full);
+		}
+	}
+
+	h = ((acc[0] << 1) | (acc[0] >> 63)) + ((acc[1] << 7) | (acc[1] >> 57)) +
+		((acc[2] << 12) | (acc[2] >> 52)) + ((acc[3] << 18) | (acc[3] >> 46));
+
+	/* Avalanche */
+	h ^= h >> 33;
+	h *= HASH_P2;
+	h ^= h >> 29;
+	h *= HASH_P3;
+	h ^= h >> 32;
+
+	return h | 1;
+}
+
+#if MY_TILE_HASH_STATS_PERIOD
+static void my_flush_stats_task(lv_task_t *task)
+{
+	my_flush_print_stats();
+}
+#endif
+#endif /*MY_USE_TILE_HASH*/
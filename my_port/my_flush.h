@@ -0,0 +1,125 @@
+/**
+ * @file my_flush.h
+ * Copy rendered areas into the framebuffer
+ */
+
+#ifndef MY_FLUSH_H
+#define MY_FLUSH_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+#if MY_USE_TILE_HASH
+typedef struct {
+	uint64_t tile_cnt;          /* Hashed tiles */
+	uint64_t skip_cnt;          /* Tiles which were already in the framebuffer */
+	uint64_t copied_bytes;
+	uint64_t saved_bytes;       /* Bytes of the skipped tiles */
+} my_flush_stats_t;
+#endif
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Copy the lines [y1, y2] of a rendered area to the framebuffer.
+ * @param dst start address of the framebuffer
+ * @param line_width length of one framebuffer line in bytes
+ * @param pixel_width bytes per pixel in the framebuffer, must be `sizeof(lv_color_t)`
+ * @param area the area `src` was rendered to (absolute coordinates)
+ * @param src the rendered pixels of `area`
+ * @param y1 first line to copy
+ * @param y2 last line to copy
+ */
+void my_flush_copy_lines(unsigned char *dst, uint32_t line_width, uint32_t pixel_width,
+			const lv_area_t *area, const lv_color_t *src, int32_t y1, int32_t y2);
+
+#if MY_USE_TILE_HASH
+/**
+ * Allocate the hashes of the framebuffer's tiles.
+ * @param hor_res horizontal resolution of the framebuffer
+ * @param ver_res vertical resolution of the framebuffer
+ * @return 0 on success, -1 on error
+ */
+int my_flush_tile_hash_init(lv_coord_t hor_res, lv_coord_t ver_res);
+
+/**
+ * Like `my_flush_copy_lines()` but copy only the tiles whose hash differs
+ * from the last copy to the same tile.
+ * Concurrent calls must not write the same tile row.
+ * @param dst start address of the framebuffer
+ * @param line_width length of one framebuffer line in bytes
+ * @param pixel_width bytes per pixel in the framebuffer, must be `sizeof(lv_color_t)`
+ * @param area the area `src` was rendered to (absolute coordinates)
+ * @param src the rendered pixels of `area`
+ * @param y1 first line to copy
+ * @param y2 last line to copy
+ */
+void my_flush_copy_changed(unsigned char *dst, uint32_t line_width, uint32_t pixel_width,
+			const lv_area_t *area, const lv_color_t *src, int32_t y1, int32_t y2);
+
+/**
+ * Copy the tiles of an area in the next flush even if their hash hasn't changed.
+ * Call it if the framebuffer was written without `my_flush_copy_changed()`.
+ * @param area the changed area of the framebuffer
+ */
+void my_flush_tile_hash_forget(const lv_area_t *area);
+
+/**
+ * Get the statistics of the skipped tiles.
+ * @param stats store the result here
+ */
+void my_flush_get_stats(my_flush_stats_t *stats);
+
+/**
+ * Print the statistics with printf.
+ */
+void my_flush_print_stats(void);
+#endif /*MY_USE_TILE_HASH*/
+
+#if MY_USE_FLUSH_WORKERS
+/**
+ * Start the flush worker threads.
+ * @param fb_base start address of the mapped framebuffer
+ * @param line_width length of one framebuffer line in bytes
+ * @param pixel_width bytes per pixel in the framebuffer, must be `sizeof(lv_color_t)`
+ * @return 0 on success, -1 if the threads can not be created
+ */
+int my_flush_workers_init(unsigned char *fb_base, uint32_t line_width, uint32_t pixel_width);
+
+/**
+ * Split an area into bands and hand them to the workers.
+ * Returns immediately, `lv_disp_flush_ready()` is called by the last worker.
+ * @param disp the display driver being flushed
+ * @param area the area to flush
+ * @param color_p the rendered pixels of `area`
+ */
+void my_flush_workers_submit(lv_disp_drv_t *disp, const lv_area_t *area, const lv_color_t *color_p);
+
+/**
+ * releated to disp_drv.wait_cb
+ * Sleep until the workers finished the current area.
+ * @param disp the display driver being flushed
+ */
+void my_flush_workers_wait(lv_disp_drv_t *disp);
+
+#if MY_FLUSH_BENCH
+/**
+ * Copy the whole screen with one thread and with the workers and print the times.
+ * The content of the framebuffer is copied back to it, the screen doesn't change.
+ * @param disp the display driver, it must not be flushing from another thread
+ */
+void my_flush_bench(lv_disp_drv_t *disp);
+#endif
+#endif /*MY_USE_FLUSH_WORKERS*/
+
+#endif /*MY_FLUSH_H*/
@@ -0,0 +1,69 @@
+/**
+ * @file my_font.c
+ * Load fonts from the file system on first use
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <string.h>
+
+#include "my_font.h"
+
+#if MY_USE_FONT_LOADER
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_FONT_MAX         16
+#define MY_FONT_NAME_MAX    32
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	char name[MY_FONT_NAME_MAX];
+	lv_font_t *font;
+} my_font_entry_t;
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static my_font_entry_t loaded[MY_FONT_MAX];
+static uint32_t loaded_cnt;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+lv_font_t *my_font_get(const char *name, lv_font_t *fallback)
+{
+	char path[MY_FONT_NAME_MAX + sizeof(MY_FONT_PATH) + 8];
+	lv_font_t *font;
+	uint32_t i;
+
+	for(i = 0; i < loaded_cnt; i++) {
+		if(strcmp(loaded[i].name, name) == 0) return loaded[i].font;
+	}
+
+	if(loaded_cnt >= MY_FONT_MAX || strlen(name) >= MY_FONT_NAME_MAX) {
+		LV_LOG_WARN("my_font_get: can't load more fonts");
+		return fallback;
+	}
+
+	snprintf(path, sizeof(path), "%s%s.bin", MY_FONT_PATH, name);
+	font = lv_font_load(path);
+	if(font == NULL) {
+		LV_LOG_WARN("my_font_get: can't load the font");
+		return fallback;
+	}
+
+	strcpy(loaded[loaded_cnt].name, name);
+	loaded[loaded_cnt].font = font;
+	loaded_cnt++;
+
+	return font;
+}
+
+#endif /*MY_USE_FONT_LOADER*/
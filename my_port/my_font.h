@@ -0,0 +1,33 @@
+/**
+ * @file my_font.h
+ * Load fonts from the file system on first use
+ */
+
+#ifndef MY_FONT_H
+#define MY_FONT_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_FONT_LOADER
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Get a font by name. It's loaded from MY_FONT_PATH "<name>.bin" on the first call,
+ * later calls return the same font.
+ * The file is created with lv_font_conv (`--format bin`).
+ * @param name name of the font, e.g. "simsun_16_cjk"
+ * @param fallback font to use if the file can't be loaded
+ * @return pointer to the font or `fallback` if it can't be loaded
+ */
+lv_font_t *my_font_get(const char *name, lv_font_t *fallback);
+
+#endif /*MY_USE_FONT_LOADER*/
+
+#endif /*MY_FONT_H*/
@@ -0,0 +1,459 @@
+/**
+ * @file my_fs.c
+ * Read-only LVGL file system driver which maps the files with mmap.
+ * Reads are a memcpy from the mapping, only the touched pages are read from the disk.
+ *
+ * LVGL's binary images (`lv_img_header_t` + pixels) in true color formats are drawn
+ * straight from the mapping by an image decoder, without reading them line by line.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "my_fs.h"
+
+#if MY_USE_FS
+
+/*********************
+ *      DEFINES
+ *********************/
+/* Longest path on the host file system (MY_FS_ROOT + the path on the drive) */
+#define MY_FS_PATH_MAX      256
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	const uint8_t *base;    /* NULL for empty files */
+	uint32_t size;
+	uint32_t pos;
+} my_fs_file_t;
+
+#if MY_FS_BENCH
+typedef struct {
+	int fd;
+} my_fs_read_file_t;
+#endif
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static lv_fs_res_t my_fs_open(lv_fs_drv_t *drv, void *file_p, const char *path, lv_fs_mode_t mode);
+static lv_fs_res_t my_fs_close(lv_fs_drv_t *drv, void *file_p);
+static lv_fs_res_t my_fs_read(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br);
+static lv_fs_res_t my_fs_seek(lv_fs_drv_t *drv, void *file_p, uint32_t pos);
+static lv_fs_res_t my_fs_tell(lv_fs_drv_t *drv, void *file_p, uint32_t *pos_p);
+static lv_fs_res_t my_fs_size(lv_fs_drv_t *drv, void *file_p, uint32_t *size_p);
+static bool my_fs_real_path(char *buf, const char *path);
+#if MY_FS_IMG_DECODER
+static lv_res_t my_fs_img_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header);
+static lv_res_t my_fs_img_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc);
+static void my_fs_img_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc);
+#endif
+#if MY_FS_BENCH
+static lv_fs_res_t my_fs_read_open(lv_fs_drv_t *drv, void *file_p, const char *path, lv_fs_mode_t mode);
+static lv_fs_res_t my_fs_read_close(lv_fs_drv_t *drv, void *file_p);
+static lv_fs_res_t my_fs_read_read(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br);
+static lv_fs_res_t my_fs_read_seek(lv_fs_drv_t *drv, void *file_p, uint32_t pos);
+static uint32_t my_fs_bench_read(const char *path, uint32_t *size);
+#endif
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_fs_drv_t fs_drv;
+#if MY_FS_BENCH
+static lv_fs_drv_t fs_read_drv;
+#endif
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_fs_init(void)
+{
+	lv_fs_drv_init(&fs_drv);
+
+	fs_drv.letter = MY_FS_LETTER;
+	fs_drv.file_size = sizeof(my_fs_file_t);
+	fs_drv.open_cb = my_fs_open;
+	fs_drv.close_cb = my_fs_close;
+	fs_drv.read_cb = my_fs_read;
+	fs_drv.seek_cb = my_fs_seek;
+	fs_drv.tell_cb = my_fs_tell;
+	fs_drv.size_cb = my_fs_size;
+
+	lv_fs_drv_register(&fs_drv);
+
+#if MY_FS_IMG_DECODER
+	lv_img_decoder_t *dec = lv_img_decoder_create();
+	lv_img_decoder_set_info_cb(dec, my_fs_img_info);
+	lv_img_decoder_set_open_cb(dec, my_fs_img_open);
+	lv_img_decoder_set_close_cb(dec, my_fs_img_close);
+#endif
+
+#if MY_FS_BENCH
+	/* The same files through read() to compare with */
+	lv_fs_drv_init(&fs_read_drv);
+	fs_read_drv.letter = MY_FS_BENCH_LETTER;
+	fs_read_drv.file_size = sizeof(my_fs_read_file_t);
+	fs_read_drv.open_cb = my_fs_read_open;
+	fs_read_drv.close_cb = my_fs_read_close;
+	fs_read_drv.read_cb = my_fs_read_read;
+	fs_read_drv.seek_cb = my_fs_read_seek;
+	lv_fs_drv_register(&fs_read_drv);
+#endif
+}
+
+const void *my_fs_get_data(lv_fs_file_t *file, uint32_t *size)
+{
+	my_fs_file_t *f;
+
+	if(file->drv != &fs_drv) return NULL;
+
+	f = file->file_d;
+	*size = f->size;
+
+	return f->base;
+}
+
+#if MY_FS_BENCH
+void my_fs_bench(const char *path)
+{
+	char lv_path[MY_FS_PATH_MAX];
+	uint32_t size = 0;
+	uint32_t t_mmap;
+	uint32_t t_read;
+
+	/* Warm up the page cache to compare the drivers, not the disk */
+	snprintf(lv_path, sizeof(lv_path), "%c:%s", MY_FS_BENCH_LETTER, path);
+	my_fs_bench_read(lv_path, &size);
+
+	t_read = my_fs_bench_read(lv_path, &size);
+	snprintf(lv_path, sizeof(lv_path), "%c:%s", MY_FS_LETTER, path);
+	t_mmap = my_fs_bench_read(lv_path, &size);
+
+	if(size == 0) {
+		printf("fs bench: can not read %s\n", path);
+		return;
+	}
+
+	/* bytes / us = MB/s */
+	printf("fs bench: %s %u kB x %d, read(): %u us (%u MB/s), mmap: %u us (%u MB/s)\n",
+			path, size / 1024, MY_FS_BENCH_LOOPS,
+			t_read, t_read ? (uint32_t)((uint64_t)size * MY_FS_BENCH_LOOPS / t_read) : 0,
+			t_mmap, t_mmap ? (uint32_t)((uint64_t)size * MY_FS_BENCH_LOOPS / t_mmap) : 0);
+}
+#endif
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Map a file. The descriptor is closed right away, the mapping keeps the file.
+ * @param drv pointer to the driver
+ * @param file_p a `my_fs_file_t` to initialize
+ * @param path path of the file relative to MY_FS_ROOT
+ * @param mode only LV_FS_MODE_RD is supported
+ * @return LV_FS_RES_OK or an error
+ */
+static lv_fs_res_t my_fs_open(lv_fs_drv_t *drv, void *file_p, const char *path, lv_fs_mode_t mode)
+{
+	(void)drv;
+
+	my_fs_file_t *f = file_p;
+	char real_path[MY_FS_PATH_MAX];
+	struct stat st;
+	void *base = NULL;
+	int fd;
+
+	if(mode & LV_FS_MODE_WR) return LV_FS_RES_DENIED;
+	if(my_fs_real_path(real_path, path) == false) return LV_FS_RES_INV_PARAM;
+
+	fd = open(real_path, O_RDONLY);
+	if(fd < 0) return LV_FS_RES_NOT_EX;
+
+	if(fstat(fd, &st) < 0 || st.st_size > UINT32_MAX) {
+		close(fd);
+		return LV_FS_RES_FS_ERR;
+	}
+
+	if(st.st_size > 0) {
+		base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(base == MAP_FAILED) {
+			close(fd);
+			return LV_FS_RES_FS_ERR;
+		}
+
+		/* Small files (fonts, icons) are read entirely, read them ahead at once.
+		 * Large images are read from the beginning to the end. */
+		madvise(base, st.st_size, st.st_size <= MY_FS_WILLNEED_MAX ? MADV_WILLNEED : MADV_SEQUENTIAL);
+	}
+	close(fd);
+
+	f->base = base;
+	f->size = st.st_size;
+	f->pos = 0;
+
+	return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t my_fs_close(lv_fs_drv_t *drv, void *file_p)
+{
+	(void)drv;
+
+	my_fs_file_t *f = file_p;
+
+	if(f->base) munmap((void *)f->base, f->size);
+	f->base = NULL;
+
+	return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t my_fs_read(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br)
+{
+	(void)drv;
+
+	my_fs_file_t *f = file_p;
+	uint32_t left = f->size - f->pos;
+
+	if(btr > left) btr = left;
+	if(btr) memcpy(buf, f->base + f->pos, btr);
+	f->pos += btr;
+	*br = btr;
+
+	return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t my_fs_seek(lv_fs_drv_t *drv, void *file_p, uint32_t pos)
+{
+	(void)drv;
+
+	my_fs_file_t *f = file_p;
+
+	f->pos = pos < f->size ? pos : f->size;
+
+	return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t my_fs_tell(lv_fs_drv_t *drv, void *file_p, uint32_t *pos_p)
+{
+	(void)drv;
+
+	*pos_p = ((my_fs_file_t *)file_p)->pos;
+
+	return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t my_fs_size(lv_fs_drv_t *drv, void *file_p, uint32_t *size_p)
+{
+	(void)drv;
+
+	*size_p = ((my_fs_file_t *)file_p)->size;
+
+	return LV_FS_RES_OK;
+}
+
+/**
+ * Join MY_FS_ROOT and a path of the drive. Paths which leave the root are rejected.
+ * @param buf store the result here, MY_FS_PATH_MAX bytes
+ * @param path path relative to MY_FS_ROOT
+ * @return true on success, false if the path contains ".." or it's too long
+ */
+static bool my_fs_real_path(char *buf, const char *path)
+{
+	const char *p = path;
+	size_t len;
+
+	while(*p) {
+		len = strcspn(p, "/");
+		if(len == 2 && p[0] == '.' && p[1] == '.') return false;
+		p += len;
+		if(*p == '/') p++;
+	}
+
+	return snprintf(buf, MY_FS_PATH_MAX, "%s/%s", MY_FS_ROOT, path) < MY_FS_PATH_MAX;
+}
+
+#if MY_FS_IMG_DECODER
+/**
+ * Accept the true color binary images of the mmap drive.
+ * @param decoder pointer to the decoder
+ * @param src the image source
+ * @param header store the header of the image here
+ * @return LV_RES_OK: the image can be drawn from the mapping
+ */
+static lv_res_t my_fs_img_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+	(void)decoder;
+
+	const char *fn = src;
+	lv_fs_file_t file;
+	uint32_t br = 0;
+
+	if(lv_img_src_get_type(src) != LV_IMG_SRC_FILE || fn[0] != MY_FS_LETTER) return LV_RES_INV;
+
+	if(lv_fs_open(&file, fn, LV_FS_MODE_RD) != LV_FS_RES_OK) return LV_RES_INV;
+	lv_fs_read(&file, header, sizeof(lv_img_header_t), &br);
+	lv_fs_close(&file);
+
+	if(br != sizeof(lv_img_header_t)) return LV_RES_INV;
+
+	switch(header->cf) {
+		case LV_IMG_CF_TRUE_COLOR:
+		case LV_IMG_CF_TRUE_COLOR_ALPHA:
+		case LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED:
+			return LV_RES_OK;
+		default:
+			return LV_RES_INV;
+	}
+}
+
+/**
+ * Keep the file open and point `img_data` into its mapping.
+ * @param decoder pointer to the decoder
+ * @param dsc the descriptor to open
+ * @return LV_RES_OK: opened; LV_RES_INV: let the other decoders open it
+ */
+static lv_res_t my_fs_img_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+	(void)decoder;
+
+	lv_fs_file_t *file;
+	const uint8_t *data;
+	uint32_t size = 0;
+	uint32_t px_size;
+
+	file = lv_mem_alloc(sizeof(lv_fs_file_t));
+	if(file == NULL) return LV_RES_INV;
+
+	if(lv_fs_open(file, dsc->src, LV_FS_MODE_RD) != LV_FS_RES_OK) {
+		lv_mem_free(file);
+		return LV_RES_INV;
+	}
+
+	px_size = dsc->header.cf == LV_IMG_CF_TRUE_COLOR_ALPHA ? LV_IMG_PX_SIZE_ALPHA_BYTE : sizeof(lv_color_t);
+	data = my_fs_get_data(file, &size);
+	if(data == NULL ||
+		size < sizeof(lv_img_header_t) + (uint32_t)dsc->header.w * dsc->header.h * px_size) {
+		lv_fs_close(file);
+		lv_mem_free(file);
+		return LV_RES_INV;
+	}
+
+	dsc->img_data = data + sizeof(lv_img_header_t);
+	dsc->user_data = file;
+
+	return LV_RES_OK;
+}
+
+static void my_fs_img_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+	(void)decoder;
+
+	lv_fs_file_t *file = dsc->user_data;
+
+	if(file == NULL) return;
+
+	lv_fs_close(file);
+	lv_mem_free(file);
+	dsc->user_data = NULL;
+}
+#endif /*MY_FS_IMG_DECODER*/
+
+#if MY_FS_BENCH
+static lv_fs_res_t my_fs_read_open(lv_fs_drv_t *drv, void *file_p, const char *path, lv_fs_mode_t mode)
+{
+	(void)drv;
+
+	char real_path[MY_FS_PATH_MAX];
+	int fd;
+
+	if(mode & LV_FS_MODE_WR) return LV_FS_RES_DENIED;
+	if(my_fs_real_path(real_path, path) == false) return LV_FS_RES_INV_PARAM;
+
+	fd = open(real_path, O_RDONLY);
+	if(fd < 0) return LV_FS_RES_NOT_EX;
+
+	((my_fs_read_file_t *)file_p)->fd = fd;
+
+	return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t my_fs_read_close(lv_fs_drv_t *drv, void *file_p)
+{
+	(void)drv;
+
+	close(((my_fs_read_file_t *)file_p)->fd);
+
+	return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t my_fs_read_read(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br)
+{
+	(void)drv;
+
+	ssize_t len = read(((my_fs_read_file_t *)file_p)->fd, buf, btr);
+
+	if(len < 0) {
+		*br = 0;
+		return LV_FS_RES_FS_ERR;
+	}
+	*br = len;
+
+	return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t my_fs_read_seek(lv_fs_drv_t *drv, void *file_p, uint32_t pos)
+{
+	(void)drv;
+
+	if(lseek(((my_fs_read_file_t *)file_p)->fd, pos, SEEK_SET) < 0) return LV_FS_RES_FS_ERR;
+
+	return LV_FS_RES_OK;
+}
+
+/**
+ * Read a file MY_FS_BENCH_LOOPS times in 4 kB chunks through LVGL.
+ * @param path path with drive letter
+ * @param size store the size of the file here
+ * @return the elapsed time in microseconds
+ */
+static uint32_t my_fs_bench_read(const char *path, uint32_t *size)
+{
+	static uint8_t buf[4096];
+	struct timespec t1, t2;
+	lv_fs_file_t file;
+	uint32_t br;
+	uint32_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	for(i = 0; i < MY_FS_BENCH_LOOPS; i++) {
+		if(lv_fs_open(&file, path, LV_FS_MODE_RD) != LV_FS_RES_OK) return 0;
+		*size = 0;
+		do {
+			br = 0;
+			lv_fs_read(&file, buf, sizeof(buf), &br);
+			*size += br;
+		} while(br == sizeof(buf));
+		lv_fs_close(&file);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	return (t2.tv_sec - t1.tv_sec) * 1000000 + (t2.tv_nsec - t1.tv_nsec) / 1000;
+}
+#endif /*MY_FS_BENCH*/
+
+#endif /*MY_USE_FS*/
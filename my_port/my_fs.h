@@ -0,0 +1,49 @@
+/**
+ * @file my_fs.h
+ * Read-only LVGL file system driver which maps the files with mmap
+ */
+
+#ifndef MY_FS_H
+#define MY_FS_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_FS
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Register the driver with the `MY_FS_LETTER` drive letter.
+ * E.g. "M:fonts/a.bin" is read from MY_FS_ROOT "/fonts/a.bin".
+ */
+void my_fs_init(void);
+
+/**
+ * Get the mapped content of a file opened on the `MY_FS_LETTER` drive.
+ * The pointer is valid until the file is closed.
+ * @param file pointer to an opened file
+ * @param size store the size of the file here
+ * @return pointer to the content, NULL if the file is empty or on an other drive
+ */
+const void *my_fs_get_data(lv_fs_file_t *file, uint32_t *size);
+
+#if MY_FS_BENCH
+/**
+ * Read a file through the mmap drive and through a read() based drive
+ * and print the throughput of both.
+ * @param path path of the file relative to MY_FS_ROOT
+ */
+void my_fs_bench(const char *path);
+#endif
+
+#endif /*MY_USE_FS*/
+
+#endif /*MY_FS_H*/
@@ -0,0 +1,273 @@
+/**
+ * @file my_glyph_cache.c
+ * Cache the glyph bitmaps of fonts as 8 bit alpha maps.
+ *
+ * Compressed fonts decompress every glyph on every draw and 1..4 bpp glyphs
+ * are unpacked pixel by pixel. The cached glyphs are already decompressed
+ * and stored with 8 bpp, so they are drawn without both.
+ *
+ * The entries are in a fixed-size open addressing table.
+ * A glyph can be in `MY_GLYPH_CACHE_PROBE` slots after its hash, a lookup
+ * checks all of them, so the evicted (empty) slots don't hide the others.
+ * If all of them are used, the least recently used one is replaced.
+ * The bitmaps are in the LVGL heap: the least recently used glyphs of the
+ * whole table are evicted to stay in `MY_GLYPH_CACHE_SIZE` bytes, so the
+ * cache never fills the heap the objects and styles are allocated from.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <string.h>
+
+#include "my_glyph_cache.h"
+
+#if MY_USE_GLYPH_CACHE
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_GLYPH_CACHE_PROBE    8
+#define MY_GLYPH_CACHE_FONT_MAX 16
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	const lv_font_t *font;      /* NULL: empty slot */
+	uint32_t letter;
+	uint32_t last_use;
+	uint8_t *bitmap;
+	uint32_t size;
+} my_glyph_cache_entry_t;
+
+typedef struct {
+	const lv_font_t *font;
+	bool (*get_glyph_dsc)(const lv_font_t *, lv_font_glyph_dsc_t *, uint32_t, uint32_t);
+	const uint8_t *(*get_glyph_bitmap)(const lv_font_t *, uint32_t);
+} my_glyph_cache_font_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static bool my_glyph_cache_get_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc, uint32_t letter, uint32_t letter_next);
+static const uint8_t *my_glyph_cache_get_bitmap(const lv_font_t *font, uint32_t letter);
+static const my_glyph_cache_font_t *my_glyph_cache_find_font(const lv_font_t *font);
+static bool my_glyph_cache_evict_lru(void);
+static void my_glyph_cache_evict(my_glyph_cache_entry_t *e);
+static void my_glyph_cache_to_a8(uint8_t *dst, const uint8_t *src, uint32_t px_cnt, uint8_t bpp);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static my_glyph_cache_entry_t table[MY_GLYPH_CACHE_SLOTS];
+static my_glyph_cache_font_t fonts[MY_GLYPH_CACHE_FONT_MAX];
+static uint32_t font_cnt;
+static uint32_t use_cnt;
+static uint8_t *scratch;        /* For the glyphs which can't be cached */
+static uint32_t scratch_size;
+static my_glyph_cache_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_glyph_cache_add_font(lv_font_t *font)
+{
+	my_glyph_cache_font_t *f;
+
+	if(font == NULL || my_glyph_cache_find_font(font)) return;
+	if(font_cnt >= MY_GLYPH_CACHE_FONT_MAX) {
+		LV_LOG_WARN("my_glyph_cache_add_font: too many fonts");
+		return;
+	}
+
+	f = &fonts[font_cnt++];
+	f->font = font;
+	f->get_glyph_dsc = font->get_glyph_dsc;
+	f->get_glyph_bitmap = font->get_glyph_bitmap;
+
+	font->get_glyph_dsc = my_glyph_cache_get_dsc;
+	font->get_glyph_bitmap = my_glyph_cache_get_bitmap;
+}
+
+void my_glyph_cache_get_stats(my_glyph_cache_stats_t *res)
+{
+	*res = stats;
+}
+
+void my_glyph_cache_print_stats(void)
+{
+	uint32_t lookups = stats.hit_cnt + stats.miss_cnt;
+
+	printf("glyph cache: %u hit, %u miss (%u%%), %u evicted, %u/%u glyphs, %u kB\n",
+			stats.hit_cnt, stats.miss_cnt, lookups ? stats.hit_cnt * 100 / lookups : 0,
+			stats.evict_cnt, stats.entry_cnt, MY_GLYPH_CACHE_SLOTS, stats.used / 1024);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get the glyph descriptor from the font and report 8 bpp.
+ */
+static bool my_glyph_cache_get_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc, uint32_t letter, uint32_t letter_next)
+{
+	const my_glyph_cache_font_t *f = my_glyph_cache_find_font(font);
+
+	if(f->get_glyph_dsc(font, dsc, letter, letter_next) == false) return false;
+
+	/* 3 bpp is padded differently by compressed and plain fonts, leave it */
+	if(dsc->bpp == 1 || dsc->bpp == 2 || dsc->bpp == 4) dsc->bpp = 8;
+
+	return true;
+}
+
+/**
+ * Get the 8 bpp bitmap of a glyph from the table or convert and store it.
+ */
+static const uint8_t *my_glyph_cache_get_bitmap(const lv_font_t *font, uint32_t letter)
+{
+	const my_glyph_cache_font_t *f = my_glyph_cache_find_font(font);
+	lv_font_glyph_dsc_t dsc;
+	const uint8_t *src;
+	my_glyph_cache_entry_t *e;
+	my_glyph_cache_entry_t *victim = NULL;
+	uint32_t slot;
+	uint32_t size;
+	uint32_t i;
+	uint8_t *bitmap;
+
+	slot = ((uint32_t)(uintptr_t)font ^ (letter * 2654435761u)) & (MY_GLYPH_CACHE_SLOTS - 1);
+
+	for(i = 0; i < MY_GLYPH_CACHE_PROBE; i++) {
+		e = &table[(slot + i) & (MY_GLYPH_CACHE_SLOTS - 1)];
+		if(e->font == font && e->letter == letter) {
+			stats.hit_cnt++;
+			e->last_use = ++use_cnt;
+			return e->bitmap;
+		}
+		/* The first empty slot, else the least recently used one */
+		if(victim && victim->font == NULL) continue;
+		if(victim == NULL || e->font == NULL || e->last_use < victim->last_use) victim = e;
+	}
+
+	stats.miss_cnt++;
+
+	if(f->get_glyph_dsc(font, &dsc, letter, 0) == false) return NULL;
+	src = f->get_glyph_bitmap(font, letter);
+	if(src == NULL) return NULL;
+	if(dsc.bpp != 1 && dsc.bpp != 2 && dsc.bpp != 4) return src;
+
+	size = dsc.box_w * dsc.box_h;
+	if(size == 0) return src;
+
+	/* Stay in the budget. The victim can be evicted too, it's empty then. */
+	bitmap = NULL;
+	if(size <= MY_GLYPH_CACHE_SIZE) {
+		while(stats.used + size > MY_GLYPH_CACHE_SIZE && my_glyph_cache_evict_lru()) {}
+
+		bitmap = lv_mem_alloc(size);
+		if(bitmap == NULL && victim->font) {
+			/* Make room by evicting first, the empty slot doesn't hide the ones after it */
+			my_glyph_cache_evict(victim);
+			bitmap = lv_mem_alloc(size);
+		}
+	}
+	if(bitmap == NULL) {
+		/* Convert to the scratch buffer which is valid until the next call */
+		if(size > scratch_size) {
+			uint8_t *p = lv_mem_realloc(scratch, size);
+			if(p == NULL) return NULL;
+			scratch = p;
+			scratch_size = size;
+		}
+		my_glyph_cache_to_a8(scratch, src, size, dsc.bpp);
+		return scratch;
+	}
+
+	if(victim->font) my_glyph_cache_evict(victim);
+
+	my_glyph_cache_to_a8(bitmap, src, size, dsc.bpp);
+
+	victim->font = font;
+	victim->letter = letter;
+	victim->last_use = ++use_cnt;
+	victim->bitmap = bitmap;
+	victim->size = size;
+	stats.entry_cnt++;
+	stats.used += size;
+
+	return bitmap;
+}
+
+static const my_glyph_cache_font_t *my_glyph_cache_find_font(const lv_font_t *font)
+{
+	uint32_t i;
+
+	for(i = 0; i < font_cnt; i++) {
+		if(fonts[i].font == font) return &fonts[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * Evict the least recently used glyph of the table.
+ * @return false if the table is empty
+ */
+static bool my_glyph_cache_evict_lru(void)
+{
+	my_glyph_cache_entry_t *lru = NULL;
+	uint32_t i;
+
+	for(i = 0; i < MY_GLYPH_CACHE_SLOTS; i++) {
+		if(table[i].font == NULL) continue;
+		if(lru == NULL || table[i].last_use < lru->last_use) lru = &table[i];
+	}
+
+	if(lru == NULL) return false;
+
+	my_glyph_cache_evict(lru);
+
+	return true;
+}
+
+/**
+ * Free the bitmap of an entry and empty its slot.
+ * @param e a used entry
+ */
+static void my_glyph_cache_evict(my_glyph_cache_entry_t *e)
+{
+	stats.evict_cnt++;
+	stats.entry_cnt--;
+	stats.used -= e->size;
+	lv_mem_free(e->bitmap);
+	e->font = NULL;
+	e->bitmap = NULL;
+}
+
+/**
+ * Unpack a 1, 2 or 4 bpp bitmap (MSB first, no line padding) to 8 bpp.
+ * @param dst store the 8 bpp bitmap here
+ * @param src the packed bitmap
+ * @param px_cnt number of pixels
+ * @param bpp bit per pixel of `src`
+ */
+static void my_glyph_cache_to_a8(uint8_t *dst, const uint8_t *src, uint32_t px_cnt, uint8_t bpp)
+{
+	uint8_t mask = (1 << bpp) - 1;
+	uint8_t scale = 255 / mask;
+	uint32_t bit = 0;
+	uint32_t i;
+
+	for(i = 0; i < px_cnt; i++) {
+		uint8_t v = src[bit >> 3] >> (8 - bpp - (bit & 7));
+		dst[i] = (v & mask) * scale;
+		bit += bpp;
+	}
+}
+
+#endif /*MY_USE_GLYPH_CACHE*/
@@ -0,0 +1,55 @@
+/**
+ * @file my_glyph_cache.h
+ * Cache the glyph bitmaps of fonts as 8 bit alpha maps
+ */
+
+#ifndef MY_GLYPH_CACHE_H
+#define MY_GLYPH_CACHE_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_GLYPH_CACHE
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t hit_cnt;
+	uint32_t miss_cnt;
+	uint32_t evict_cnt;
+	uint32_t entry_cnt;
+	uint32_t used;      /* Bytes of the cached bitmaps */
+} my_glyph_cache_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Cache the glyphs of a font.
+ * The glyph callbacks of the font are replaced, the font will report 8 bpp glyphs.
+ * Fonts with 3 bpp and fonts added more than once are ignored.
+ * @param font pointer to a font
+ */
+void my_glyph_cache_add_font(lv_font_t *font);
+
+/**
+ * Get the hit/miss counters and the memory usage.
+ * @param stats store the result here
+ */
+void my_glyph_cache_get_stats(my_glyph_cache_stats_t *stats);
+
+/**
+ * Print the statistics with printf.
+ */
+void my_glyph_cache_print_stats(void);
+
+#endif /*MY_USE_GLYPH_CACHE*/
+
+#endif /*MY_GLYPH_CACHE_H*/
@@ -0,0 +1,264 @@
+/**
+ * @file my_idle.c
+ * Stop refreshing and polling the input while the screen is idle
+ *
+ * After MY_IDLE_TIME ms without input and without flushed areas the
+ * refresh task and the input polling tasks are suspended. The main loop
+ * then blocks in `poll()` on the input device with the time till the next
+ * LVGL task as timeout, so the CPU can enter deep idle states.
+ * Areas invalidated by tasks meanwhile (e.g. a clock) are still refreshed.
+ * The first input event resumes every task before the next frame.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+
+#include <linux/fb.h>
+
+#include "my_idle.h"
+#include "my_vsync.h"
+#include "my_scroll.h"
+#include "my_cmd.h"
+#include "my_budget.h"
+
+#if MY_USE_IDLE
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_IDLE_TASK_MAX    8
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	lv_task_t *task;
+	lv_task_prio_t prio;        /* Priority before suspending */
+} my_idle_task_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void my_idle_enter(void);
+static void my_idle_leave(void);
+static void my_idle_blank(bool blank);
+static uint64_t my_idle_now_ms(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_disp_t *idle_disp;
+static int idle_input_fd = -1;
+static int idle_fb_fd = -1;
+static my_idle_task_t tasks[MY_IDLE_TASK_MAX];
+static uint32_t task_cnt;
+static uint32_t last_flush;
+static uint64_t idle_start_ms;
+static my_idle_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_idle_init(lv_disp_t *disp, int input_fd, int fb_fd)
+{
+	lv_indev_t *indev;
+
+	idle_disp = disp;
+	idle_input_fd = input_fd;
+	idle_fb_fd = fb_fd;
+	last_flush = lv_tick_get();
+
+	my_idle_add_task(_lv_disp_get_refr_task(disp));
+
+	for(indev = lv_indev_get_next(NULL); indev; indev = lv_indev_get_next(indev)) {
+		my_idle_add_task(indev->driver.read_task);
+	}
+}
+
+void my_idle_add_task(lv_task_t *task)
+{
+	if(task == NULL) return;
+
+	if(task_cnt >= MY_IDLE_TASK_MAX) {
+		LV_LOG_WARN("my_idle_add_task: too many tasks");
+		return;
+	}
+
+	tasks[task_cnt++].task = task;
+}
+
+void my_idle_flushed(void)
+{
+	last_flush = lv_tick_get();
+}
+
+void my_idle_handler(void)
+{
+	struct pollfd pfd[2];
+	nfds_t nfds = 1;
+	uint32_t next;
+	uint64_t t0;
+	int timeout;
+	int res;
+
+	if(lv_disp_get_inactive_time(idle_disp) < MY_IDLE_TIME ||
+		lv_tick_elaps(last_flush) < MY_IDLE_TIME) {
+		return;
+	}
+
+	my_idle_enter();
+
+	pfd[0].fd = idle_input_fd;
+	pfd[0].events = POLLIN;
+#if MY_USE_CMD_QUEUE
+	/* The commands of other threads are applied without leaving idle */
+	pfd[1].fd = my_cmd_get_fd();
+	pfd[1].events = POLLIN;
+	if(pfd[1].fd >= 0) nfds = 2;
+#endif
+
+	while(1) {
+#if MY_USE_CMD_QUEUE
+		my_cmd_handler();
+#endif
+		/* Only the tasks of the app run, the others are suspended */
+#if MY_USE_TASK_BUDGET
+		next = my_budget_task_handler();
+#else
+		next = lv_task_handler();
+#endif
+#if MY_USE_SCROLL_BLIT
+		my_scroll_apply();
+#endif
+		if(idle_disp->inv_p != 0) {
+#if MY_USE_TASK_BUDGET
+			my_budget_refr_now(idle_disp);
+#else
+			lv_refr_now(idle_disp);
+#endif
+			next = 0;
+		}
+
+#if MY_IDLE_BLANK_TIME
+		if(idle_fb_fd >= 0 && stats.blanked == false) {
+			uint32_t inactive = lv_disp_get_inactive_time(idle_disp);
+			if(inactive >= MY_IDLE_BLANK_TIME) my_idle_blank(true);
+			else if(next > MY_IDLE_BLANK_TIME - inactive) next = MY_IDLE_BLANK_TIME - inactive;
+		}
+#endif
+
+		/* LV_NO_TASK_READY: wait for the input only */
+		timeout = next == LV_NO_TASK_READY ? -1 : (int)next;
+
+		t0 = my_idle_now_ms();
+		res = poll(pfd, nfds, timeout);
+#if MY_USE_VSYNC
+		/* The tick follows the clock */
+		(void)t0;
+		my_vsync_tick();
+#else
+		lv_tick_inc(my_idle_now_ms() - t0);
+#endif
+
+		if(res > 0 && pfd[0].revents) break;
+		if(res < 0 && errno != EINTR) {
+			perror("idle poll error");
+			break;
+		}
+
+		stats.wakeup_cnt++;
+	}
+
+	my_idle_leave();
+}
+
+void my_idle_get_stats(my_idle_stats_t *res)
+{
+	*res = stats;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Suspend the refresh and the input polling.
+ */
+static void my_idle_enter(void)
+{
+	uint32_t i;
+
+	for(i = 0; i < task_cnt; i++) {
+		tasks[i].prio = tasks[i].task->prio;
+		lv_task_set_prio(tasks[i].task, LV_TASK_PRIO_OFF);
+	}
+
+#if MY_USE_VSYNC
+	/* Don't wake up for every vblank */
+	my_vsync_pause(true);
+#endif
+
+	idle_start_ms = my_idle_now_ms();
+	stats.idle = true;
+	stats.idle_cnt++;
+}
+
+/**
+ * Resume the suspended tasks and run them in the next `lv_task_handler()`.
+ */
+static void my_idle_leave(void)
+{
+	uint32_t i;
+
+	if(stats.blanked) my_idle_blank(false);
+
+#if MY_USE_VSYNC
+	my_vsync_pause(false);
+#endif
+
+	for(i = 0; i < task_cnt; i++) {
+		lv_task_set_prio(tasks[i].task, tasks[i].prio);
+		if(tasks[i].prio != LV_TASK_PRIO_OFF) lv_task_ready(tasks[i].task);
+	}
+
+	/* The input is active, don't go idle again before it's read */
+	lv_disp_trig_activity(idle_disp);
+
+	stats.idle_ms += my_idle_now_ms() - idle_start_ms;
+	stats.idle = false;
+}
+
+/**
+ * Blank or unblank the framebuffer.
+ * @param blank true: power down the display, false: turn it on
+ */
+static void my_idle_blank(bool blank)
+{
+	if(ioctl(idle_fb_fd, FBIOBLANK, blank ? FB_BLANK_POWERDOWN : FB_BLANK_UNBLANK) < 0) {
+		perror("can not blank the framebuffer");
+		/* Don't retry */
+		idle_fb_fd = -1;
+		return;
+	}
+
+	stats.blanked = blank;
+}
+
+static uint64_t my_idle_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+#endif /*MY_USE_IDLE*/
@@ -0,0 +1,71 @@
+/**
+ * @file my_idle.h
+ * Stop refreshing and polling the input while the screen is idle
+ */
+
+#ifndef MY_IDLE_H
+#define MY_IDLE_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_IDLE
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t idle_cnt;          /* Number of idle periods */
+	uint32_t idle_ms;           /* Total time spent idle */
+	uint32_t wakeup_cnt;        /* Wakeups for LVGL tasks while idle */
+	bool idle;
+	bool blanked;
+} my_idle_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Initialize the idle governor.
+ * The refresh task of the display and the read tasks of the input devices
+ * are suspended while idle.
+ * @param disp the display to watch
+ * @param input_fd wake up when it's readable (e.g. the touchpad's event device)
+ * @param fb_fd framebuffer to blank after MY_IDLE_BLANK_TIME, -1: don't blank
+ */
+void my_idle_init(lv_disp_t *disp, int input_fd, int fb_fd);
+
+/**
+ * Suspend a task too while idle, e.g. one which polls an input device.
+ * @param task the task
+ */
+void my_idle_add_task(lv_task_t *task);
+
+/**
+ * Call it when an area is flushed.
+ */
+void my_idle_flushed(void);
+
+/**
+ * Call it in the main loop before the LVGL tasks.
+ * Returns at once if the screen or the input was active in the last MY_IDLE_TIME ms.
+ * Otherwise it blocks until the input device is readable and runs only the
+ * LVGL tasks which are due meanwhile.
+ */
+void my_idle_handler(void);
+
+/**
+ * Get the idle statistics.
+ * @param stats store the result here
+ */
+void my_idle_get_stats(my_idle_stats_t *stats);
+
+#endif /*MY_USE_IDLE*/
+
+#endif /*MY_IDLE_H*/
@@ -0,0 +1,818 @@
+/**
+ * @file my_img_cache.c
+ * Keep decoded images in the LVGL heap between screens.
+ *
+ * A decoder in front of the other decoders. On a miss it opens the image
+ * with the other decoders, copies all of its pixels and closes it.
+ * The copy is stored in the framebuffer's pixel format (`LV_IMG_CF_TRUE_COLOR`
+ * if every pixel is opaque), so drawing it is a plain copy.
+ * Least recently used images are evicted to stay in `MY_IMG_CACHE_SIZE`.
+ *
+ * With `MY_IMG_CACHE_WORKER_CNT` worker threads a miss doesn't decode while
+ * drawing: the image is queued, a placeholder is drawn and the decoded copy
+ * is added to the cache by a task on the UI thread, which redraws the images
+ * showing it. The other decoders run on the workers, several at once and
+ * while the UI thread draws: they have to be reentrant and allocate with a
+ * thread-safe allocator (`my_mem_alloc` or malloc, checked in the header).
+ * The decoder list is only read, it must not change after the init.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "my_img_cache.h"
+#include "my_sched.h"
+
+#if MY_USE_IMG_CACHE
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct _my_img_cache_entry {
+	struct _my_img_cache_entry *prev;   /* Towards the most recently used */
+	struct _my_img_cache_entry *next;   /* Towards the least recently used */
+	lv_img_src_t src_type;
+	const void *src;            /* The variable or own copy of the file name */
+	uint32_t hash;
+	uint16_t src_w;             /* Size reported by the original decoder */
+	uint16_t src_h;
+	lv_img_header_t header;     /* Header of the cached pixels */
+	uint8_t *data;
+	uint32_t data_size;
+	uint32_t ref_cnt;           /* Number of open descriptors */
+	bool stale;                 /* Free it when it's closed */
+} my_img_cache_entry_t;
+
+#if MY_IMG_CACHE_WORKER_CNT
+typedef enum {
+	MY_IMG_CACHE_JOB_QUEUED,
+	MY_IMG_CACHE_JOB_DECODING,
+	MY_IMG_CACHE_JOB_DONE,
+	MY_IMG_CACHE_JOB_FAILED,    /* Kept, so it's opened by the other decoders from now on */
+} my_img_cache_job_state_t;
+
+typedef struct _my_img_cache_job {
+	struct _my_img_cache_job *next;
+	lv_img_src_t src_type;
+	const void *src;            /* The variable or own copy of the file name */
+	const void *open_src;       /* `src` of the descriptor the placeholder was opened with */
+	uint32_t hash;
+	uint16_t src_w;
+	uint16_t src_h;
+	lv_color_t color;
+	my_img_cache_entry_t *entry;    /* The decoded image, not linked yet */
+	my_img_cache_job_state_t state;
+	bool stale;                 /* Invalidated, drop the result */
+	bool redrawn;
+} my_img_cache_job_t;
+#endif
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static lv_res_t my_img_cache_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header);
+static lv_res_t my_img_cache_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc);
+static void my_img_cache_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc);
+static my_img_cache_entry_t *my_img_cache_find(const void *src, lv_img_src_t src_type, uint32_t w, uint32_t h);
+static my_img_cache_entry_t *my_img_cache_decode(const void *src, lv_img_src_t src_type, lv_color_t color, bool worker);
+static void my_img_cache_add(my_img_cache_entry_t *e);
+static bool my_img_cache_reserve(uint32_t size);
+static void my_img_cache_unlink(my_img_cache_entry_t *e);
+static void my_img_cache_link(my_img_cache_entry_t *e);
+static void my_img_cache_free(my_img_cache_entry_t *e);
+static void my_img_cache_free_data(my_img_cache_entry_t *e);
+static uint32_t my_img_cache_hash(const void *src, lv_img_src_t src_type);
+static uint8_t my_img_cache_px_size(lv_img_src_t src_type, lv_img_cf_t cf);
+#if MY_IMG_CACHE_WORKER_CNT
+static lv_res_t my_img_cache_read_line(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc,
+		lv_coord_t x, lv_coord_t y, lv_coord_t len, uint8_t *buf);
+static bool my_img_cache_queue(lv_img_decoder_dsc_t *dsc);
+static my_img_cache_job_t *my_img_cache_find_job(const void *src, lv_img_src_t src_type, uint32_t w, uint32_t h);
+static void *my_img_cache_worker_thread(void *arg);
+static void my_img_cache_done_task(lv_task_t *task);
+static void my_img_cache_redraw(my_img_cache_job_t *job);
+static bool my_img_cache_redraw_children(lv_obj_t *parent, my_img_cache_job_t *job);
+static void my_img_cache_free_job(my_img_cache_job_t *job);
+#endif
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static my_img_cache_entry_t *lru_head;
+static my_img_cache_entry_t *lru_tail;
+static my_img_cache_stats_t stats;
+static __thread bool busy;  /* Opening with the other decoders, don't handle our own calls */
+
+#if MY_IMG_CACHE_WORKER_CNT
+static pthread_t workers[MY_IMG_CACHE_WORKER_CNT];
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static my_img_cache_job_t *jobs;    /* Oldest first */
+static lv_task_t *done_task;
+#endif
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_img_cache_init(void)
+{
+	lv_img_decoder_t *dec = lv_img_decoder_create();
+
+	/* No read_line_cb: the whole image is always available in `img_data` */
+	lv_img_decoder_set_info_cb(dec, my_img_cache_info);
+	lv_img_decoder_set_open_cb(dec, my_img_cache_open);
+	lv_img_decoder_set_close_cb(dec, my_img_cache_close);
+
+#if MY_IMG_CACHE_WORKER_CNT
+	uint32_t i;
+
+	/* Only the placeholders are read by lines */
+	lv_img_decoder_set_read_line_cb(dec, my_img_cache_read_line);
+
+	/* Runs only while there are jobs */
+	done_task = lv_task_create(my_img_cache_done_task, MY_IMG_CACHE_DONE_PERIOD, LV_TASK_PRIO_OFF, NULL);
+
+	for(i = 0; i < MY_IMG_CACHE_WORKER_CNT; i++) {
+		if(pthread_create(&workers[i], NULL, my_img_cache_worker_thread, NULL) != 0) {
+			perror("can not create image decoder thread");
+			break;
+		}
+	}
+#endif
+}
+
+void my_img_cache_invalidate(const void *src)
+{
+	my_img_cache_entry_t *e = lru_head;
+	my_img_cache_entry_t *next;
+	lv_img_src_t src_type = src ? lv_img_src_get_type(src) : LV_IMG_SRC_UNKNOWN;
+	uint32_t hash = src ? my_img_cache_hash(src, src_type) : 0;
+
+	/* Make LVGL close its opened copies */
+	lv_img_cache_invalidate_src(src);
+
+	while(e) {
+		next = e->next;
+		if(src == NULL || (e->hash == hash && e->src_type == src_type &&
+			(src_type == LV_IMG_SRC_VARIABLE ? e->src == src : strcmp(e->src, src) == 0))) {
+			if(e->ref_cnt) {
+				e->stale = true;
+			}
+			else {
+				my_img_cache_unlink(e);
+				my_img_cache_free(e);
+			}
+		}
+		e = next;
+	}
+
+#if MY_IMG_CACHE_WORKER_CNT
+	my_img_cache_job_t *job;
+
+	/* The results of the jobs of `src` are dropped by the done task */
+	pthread_mutex_lock(&job_lock);
+	for(job = jobs; job; job = job->next) {
+		if(src == NULL || (job->hash == hash && job->src_type == src_type &&
+			(src_type == LV_IMG_SRC_VARIABLE ? job->src == src : strcmp(job->src, src) == 0))) {
+			job->stale = true;
+		}
+	}
+	pthread_mutex_unlock(&job_lock);
+	if(jobs) lv_task_set_prio(done_task, LV_TASK_PRIO_LOW);
+#endif
+}
+
+void my_img_cache_get_stats(my_img_cache_stats_t *res)
+{
+	*res = stats;
+}
+
+void my_img_cache_print_stats(void)
+{
+	uint32_t lookups = stats.hit_cnt + stats.miss_cnt;
+
+	printf("img cache: %u hit, %u miss (%u%%), %u evicted, %u images, %u/%u kB\n",
+			stats.hit_cnt, stats.miss_cnt, lookups ? stats.hit_cnt * 100 / lookups : 0,
+			stats.evict_cnt, stats.entry_cnt, stats.used / 1024, MY_IMG_CACHE_SIZE / 1024);
+#if MY_IMG_CACHE_WORKER_CNT
+	printf("img cache: %u decoded on workers (max %u ms), %u placeholders drawn\n",
+			stats.async_cnt, stats.async_ms_max, stats.placeholder_cnt);
+#endif
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Accept the images whose pixels can be copied.
+ * Built-in true color variables are skipped, they are already in the native format.
+ * @param decoder pointer to the decoder
+ * @param src the image source
+ * @param header store the header of the image here
+ * @return LV_RES_OK: the image is handled by the cache
+ */
+static lv_res_t my_img_cache_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+	(void)decoder;
+
+	lv_img_src_t src_type;
+	lv_img_header_t orig;
+	lv_res_t res;
+	my_img_cache_entry_t *e;
+
+	if(busy) return LV_RES_INV;
+
+	src_type = lv_img_src_get_type(src);
+	if(src_type != LV_IMG_SRC_VARIABLE && src_type != LV_IMG_SRC_FILE) return LV_RES_INV;
+
+	busy = true;
+	res = lv_img_decoder_get_info(src, &orig);
+	busy = false;
+	if(res != LV_RES_OK) return LV_RES_INV;
+
+	if(my_img_cache_px_size(src_type, orig.cf) == 0) return LV_RES_INV;
+
+#if MY_USE_FS && MY_FS_IMG_DECODER
+	/* True color images of the mmap drive are drawn from the mapping, copying them saves nothing */
+	if(src_type == LV_IMG_SRC_FILE && ((const char *)src)[0] == MY_FS_LETTER &&
+		(orig.cf == LV_IMG_CF_TRUE_COLOR || orig.cf == LV_IMG_CF_TRUE_COLOR_ALPHA ||
+		 orig.cf == LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED)) {
+		return LV_RES_INV;
+	}
+#endif
+
+	e = my_img_cache_find(src, src_type, orig.w, orig.h);
+	if(e) {
+		*header = e->header;
+	}
+	else {
+		*header = orig;
+		header->cf = my_img_cache_px_size(src_type, orig.cf) == sizeof(lv_color_t) ?
+				LV_IMG_CF_TRUE_COLOR : LV_IMG_CF_TRUE_COLOR_ALPHA;
+	}
+
+	return LV_RES_OK;
+}
+
+/**
+ * Hand out the cached pixels, decode the image on a miss.
+ * @param decoder pointer to the decoder
+ * @param dsc the descriptor to open
+ * @return LV_RES_OK: opened from the cache; LV_RES_INV: let the other decoders open it
+ */
+static lv_res_t my_img_cache_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+	(void)decoder;
+
+	my_img_cache_entry_t *e;
+
+	e = my_img_cache_find(dsc->src, dsc->src_type, dsc->header.w, dsc->header.h);
+	if(e) {
+		stats.hit_cnt++;
+		my_img_cache_unlink(e);
+	}
+	else {
+#if MY_IMG_CACHE_WORKER_CNT
+		/* Draw a placeholder until a worker decodes it */
+		if(my_img_cache_queue(dsc)) {
+			dsc->header.cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+			dsc->img_data = NULL;
+			dsc->user_data = NULL;
+			stats.placeholder_cnt++;
+			return LV_RES_OK;
+		}
+#endif
+		stats.miss_cnt++;
+		e = my_img_cache_decode(dsc->src, dsc->src_type, dsc->color, false);
+		if(e == NULL) return LV_RES_INV;
+		my_img_cache_add(e);
+	}
+
+	my_img_cache_link(e);
+	e->ref_cnt++;
+
+	dsc->header = e->header;
+	dsc->img_data = e->data;
+	dsc->user_data = e;
+
+	return LV_RES_OK;
+}
+
+static void my_img_cache_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+	(void)decoder;
+
+	my_img_cache_entry_t *e = dsc->user_data;
+
+	if(e == NULL) return;
+
+	e->ref_cnt--;
+	if(e->ref_cnt == 0 && e->stale) {
+		my_img_cache_unlink(e);
+		my_img_cache_free(e);
+	}
+
+	dsc->user_data = NULL;
+}
+
+static my_img_cache_entry_t *my_img_cache_find(const void *src, lv_img_src_t src_type, uint32_t w, uint32_t h)
+{
+	uint32_t hash = my_img_cache_hash(src, src_type);
+	my_img_cache_entry_t *e;
+
+	for(e = lru_head; e; e = e->next) {
+		if(e->hash != hash || e->src_type != src_type || e->stale) continue;
+		if(e->src_w != w || e->src_h != h) continue;
+		if(src_type == LV_IMG_SRC_VARIABLE ? e->src == src : strcmp(e->src, src) == 0) return e;
+	}
+
+	return NULL;
+}
+
+/**
+ * Open an image with the other decoders and copy its pixels.
+ * @param src the image source
+ * @param src_type type of `src`
+ * @param color the image color (used by some decoders)
+ * @param worker true: called on a worker, the room in the cache is made when it's added
+ * @return the new entry (not linked yet) or NULL if it can't be cached
+ */
+static my_img_cache_entry_t *my_img_cache_decode(const void *src, lv_img_src_t src_type, lv_color_t color, bool worker)
+{
+	lv_img_decoder_dsc_t orig;
+	my_img_cache_entry_t *e;
+	lv_res_t res;
+	uint8_t px_size;
+	uint32_t line_size;
+	uint32_t size;
+	uint32_t i;
+	lv_coord_t y;
+
+	busy = true;
+	res = lv_img_decoder_open(&orig, src, color);
+	busy = false;
+	if(res != LV_RES_OK) return NULL;
+
+	px_size = my_img_cache_px_size(src_type, orig.header.cf);
+	line_size = orig.header.w * px_size;
+	size = line_size * orig.header.h;
+
+	if(px_size == 0 || (orig.img_data == NULL && orig.decoder->read_line_cb == NULL) ||
+		(worker ? size + sizeof(my_img_cache_entry_t) > MY_IMG_CACHE_SIZE :
+		 my_img_cache_reserve(size + sizeof(my_img_cache_entry_t)) == false)) {
+		lv_img_decoder_close(&orig);
+		return NULL;
+	}
+
+	e = lv_mem_alloc(sizeof(my_img_cache_entry_t));
+	if(e) {
+		memset(e, 0, sizeof(my_img_cache_entry_t));
+		e->data = lv_mem_alloc(size);
+	}
+	if(e == NULL || e->data == NULL) {
+		if(e) lv_mem_free(e);
+		lv_img_decoder_close(&orig);
+		return NULL;
+	}
+
+	if(orig.img_data) {
+		memcpy(e->data, orig.img_data, size);
+	}
+	else {
+		for(y = 0; y < (lv_coord_t)orig.header.h; y++) {
+			lv_img_decoder_read_line(&orig, 0, y, orig.header.w, e->data + y * line_size);
+		}
+	}
+
+	e->header = orig.header;
+	e->src_w = orig.header.w;
+	e->src_h = orig.header.h;
+	lv_img_decoder_close(&orig);
+
+	/* Drop the alpha channel of opaque images, so they are drawn with a plain copy */
+	e->header.cf = LV_IMG_CF_TRUE_COLOR;
+	if(orig.header.cf == LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED || orig.header.cf == LV_IMG_CF_RAW_CHROMA_KEYED) {
+		e->header.cf = LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED;
+	}
+	else if(lv_img_cf_has_alpha(orig.header.cf)) {
+		uint32_t px_cnt = orig.header.w * orig.header.h;
+
+		/* The alpha byte follows the color bytes */
+		for(i = 0; i < px_cnt; i++) {
+			if(e->data[i * px_size + px_size - 1] != 0xff) break;
+		}
+
+		if(i < px_cnt) {
+			e->header.cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+		}
+		else if(px_size != sizeof(lv_color_t)) {
+			/* Pack the colors in place, the destination never overtakes the source */
+			for(i = 0; i < px_cnt; i++) {
+				memmove(e->data + i * sizeof(lv_color_t), e->data + i * px_size, sizeof(lv_color_t));
+			}
+		}
+	}
+
+	e->src_type = src_type;
+	e->hash = my_img_cache_hash(src, src_type);
+	e->data_size = size;
+	if(src_type == LV_IMG_SRC_FILE) {
+		char *fn = lv_mem_alloc(strlen(src) + 1);
+		if(fn == NULL) {
+			lv_mem_free(e->data);
+			lv_mem_free(e);
+			return NULL;
+		}
+		strcpy(fn, src);
+		e->src = fn;
+	}
+	else {
+		e->src = src;
+	}
+
+	return e;
+}
+
+/**
+ * Count a decoded entry in the size of the cache.
+ * @param e the entry, its room is already reserved
+ */
+static void my_img_cache_add(my_img_cache_entry_t *e)
+{
+	stats.entry_cnt++;
+	stats.used += e->data_size + sizeof(my_img_cache_entry_t);
+}
+
+/**
+ * Evict the least recently used closed images until `size` bytes fit.
+ * @param size bytes to make room for
+ * @return true: `size` fits; false: too big or the cache is full of opened images
+ */
+static bool my_img_cache_reserve(uint32_t size)
+{
+	my_img_cache_entry_t *e = lru_tail;
+	my_img_cache_entry_t *prev;
+
+	if(size > MY_IMG_CACHE_SIZE) return false;
+
+	while(e && stats.used + size > MY_IMG_CACHE_SIZE) {
+		prev = e->prev;
+		if(e->ref_cnt == 0) {
+			my_img_cache_unlink(e);
+			my_img_cache_free(e);
+			stats.evict_cnt++;
+		}
+		e = prev;
+	}
+
+	return stats.used + size <= MY_IMG_CACHE_SIZE;
+}
+
+static void my_img_cache_unlink(my_img_cache_entry_t *e)
+{
+	if(e->prev) e->prev->next = e->next;
+	else lru_head = e->next;
+	if(e->next) e->next->prev = e->prev;
+	else lru_tail = e->prev;
+
+	e->prev = NULL;
+	e->next = NULL;
+}
+
+static void my_img_cache_link(my_img_cache_entry_t *e)
+{
+	e->prev = NULL;
+	e->next = lru_head;
+	if(lru_head) lru_head->prev = e;
+	else lru_tail = e;
+	lru_head = e;
+}
+
+/**
+ * Free an unlinked entry.
+ * @param e the entry to free
+ */
+static void my_img_cache_free(my_img_cache_entry_t *e)
+{
+	stats.entry_cnt--;
+	stats.used -= e->data_size + sizeof(my_img_cache_entry_t);
+
+	my_img_cache_free_data(e);
+}
+
+/**
+ * Free an entry which is not counted in the cache.
+ * @param e the entry to free
+ */
+static void my_img_cache_free_data(my_img_cache_entry_t *e)
+{
+	if(e->src_type == LV_IMG_SRC_FILE) lv_mem_free(e->src);
+	lv_mem_free(e->data);
+	lv_mem_free(e);
+}
+
+/**
+ * FNV-1a hash of the file name or the address of the variable.
+ */
+static uint32_t my_img_cache_hash(const void *src, lv_img_src_t src_type)
+{
+	uint32_t hash = 2166136261u;
+	const uint8_t *p;
+
+	if(src_type == LV_IMG_SRC_VARIABLE) {
+		uintptr_t v = (uintptr_t)src;
+		return (uint32_t)(v ^ (v >> 16)) * 2654435761u;
+	}
+
+	for(p = src; *p; p++) {
+		hash ^= *p;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/**
+ * Get the pixel size of a decoded image if it can be cached.
+ * @param src_type type of the image source
+ * @param cf color format reported by the original decoder
+ * @return size of a pixel in bytes or 0 if the image is not cached
+ */
+static uint8_t my_img_cache_px_size(lv_img_src_t src_type, lv_img_cf_t cf)
+{
+	switch(cf) {
+		case LV_IMG_CF_TRUE_COLOR:
+		case LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED:
+			/* True color variables are drawn directly, nothing to save */
+			return src_type == LV_IMG_SRC_FILE ? sizeof(lv_color_t) : 0;
+		case LV_IMG_CF_TRUE_COLOR_ALPHA:
+			return src_type == LV_IMG_SRC_FILE ? LV_IMG_PX_SIZE_ALPHA_BYTE : 0;
+		case LV_IMG_CF_RAW:
+		case LV_IMG_CF_RAW_CHROMA_KEYED:
+			return sizeof(lv_color_t);
+		case LV_IMG_CF_RAW_ALPHA:
+			return LV_IMG_PX_SIZE_ALPHA_BYTE;
+		default:	/* Indexed and alpha only images depend on the palette and the color */
+			return 0;
+	}
+}
+
+#if MY_IMG_CACHE_WORKER_CNT
+/**
+ * Fill a line of a placeholder.
+ * @param decoder pointer to the decoder
+ * @param dsc the placeholder's descriptor
+ * @param x start x coordinate
+ * @param y start y coordinate
+ * @param len number of pixels
+ * @param buf store the pixels here
+ * @return LV_RES_OK
+ */
+static lv_res_t my_img_cache_read_line(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc,
+		lv_coord_t x, lv_coord_t y, lv_coord_t len, uint8_t *buf)
+{
+	(void)decoder;
+	(void)dsc;
+	(void)x;
+	(void)y;
+
+	lv_color_t color = lv_color_hex(MY_IMG_CACHE_PLACEHOLDER_COLOR);
+	lv_coord_t i;
+
+	for(i = 0; i < len; i++) {
+		memcpy(&buf[i * LV_IMG_PX_SIZE_ALPHA_BYTE], &color, sizeof(lv_color_t));
+		buf[i * LV_IMG_PX_SIZE_ALPHA_BYTE + LV_IMG_PX_SIZE_ALPHA_BYTE - 1] = MY_IMG_CACHE_PLACEHOLDER_OPA;
+	}
+
+	return LV_RES_OK;
+}
+
+/**
+ * Queue an image for the workers unless it's already queued.
+ * @param dsc the descriptor being opened
+ * @return true: a placeholder can be drawn; false: decoding failed on a worker, open it now
+ */
+static bool my_img_cache_queue(lv_img_decoder_dsc_t *dsc)
+{
+	my_img_cache_job_t *job;
+	my_img_cache_job_t **tail;
+	bool res = true;
+
+	pthread_mutex_lock(&job_lock);
+	job = my_img_cache_find_job(dsc->src, dsc->src_type, dsc->header.w, dsc->header.h);
+	if(job) {
+		job->open_src = dsc->src;
+		if(job->state == MY_IMG_CACHE_JOB_FAILED) res = false;
+		pthread_mutex_unlock(&job_lock);
+		return res;
+	}
+	pthread_mutex_unlock(&job_lock);
+
+	job = lv_mem_alloc(sizeof(my_img_cache_job_t));
+	if(job == NULL) return false;
+	memset(job, 0, sizeof(my_img_cache_job_t));
+
+	if(dsc->src_type == LV_IMG_SRC_FILE) {
+		char *fn = lv_mem_alloc(strlen(dsc->src) + 1);
+		if(fn == NULL) {
+			lv_mem_free(job);
+			return false;
+		}
+		strcpy(fn, dsc->src);
+		job->src = fn;
+	}
+	else {
+		job->src = dsc->src;
+	}
+
+	job->src_type = dsc->src_type;
+	job->open_src = dsc->src;
+	job->hash = my_img_cache_hash(dsc->src, dsc->src_type);
+	job->src_w = dsc->header.w;
+	job->src_h = dsc->header.h;
+	job->color = dsc->color;
+	job->state = MY_IMG_CACHE_JOB_QUEUED;
+
+	pthread_mutex_lock(&job_lock);
+	for(tail = &jobs; *tail; tail = &(*tail)->next);
+	*tail = job;
+	pthread_cond_signal(&job_cond);
+	pthread_mutex_unlock(&job_lock);
+
+	stats.miss_cnt++;
+	lv_task_set_prio(done_task, LV_TASK_PRIO_LOW);
+
+	return true;
+}
+
+/**
+ * Find the job of an image. Call it with `job_lock` locked.
+ */
+static my_img_cache_job_t *my_img_cache_find_job(const void *src, lv_img_src_t src_type, uint32_t w, uint32_t h)
+{
+	uint32_t hash = my_img_cache_hash(src, src_type);
+	my_img_cache_job_t *job;
+
+	for(job = jobs; job; job = job->next) {
+		if(job->hash != hash || job->src_type != src_type || job->stale) continue;
+		if(job->src_w != w || job->src_h != h) continue;
+		if(src_type == LV_IMG_SRC_VARIABLE ? job->src == src : strcmp(job->src, src) == 0) return job;
+	}
+
+	return NULL;
+}
+
+static void *my_img_cache_worker_thread(void *arg)
+{
+	(void)arg;
+
+	my_img_cache_job_t *job;
+	my_img_cache_entry_t *e;
+	uint32_t t0;
+	uint32_t ms;
+
+#if MY_USE_SCHED
+	my_sched_apply(MY_SCHED_ROLE_BACKGROUND, "lv-decode");
+#endif
+
+	while(1) {
+		pthread_mutex_lock(&job_lock);
+		while(1) {
+			for(job = jobs; job; job = job->next) {
+				if(job->state == MY_IMG_CACHE_JOB_QUEUED && job->stale == false) break;
+			}
+			if(job) break;
+			pthread_cond_wait(&job_cond, &job_lock);
+		}
+		job->state = MY_IMG_CACHE_JOB_DECODING;
+		pthread_mutex_unlock(&job_lock);
+
+		t0 = lv_tick_get();
+		e = my_img_cache_decode(job->src, job->src_type, job->color, true);
+		ms = lv_tick_elaps(t0);
+
+		pthread_mutex_lock(&job_lock);
+		job->entry = e;
+		job->state = e ? MY_IMG_CACHE_JOB_DONE : MY_IMG_CACHE_JOB_FAILED;
+		if(e && ms > stats.async_ms_max) stats.async_ms_max = ms;
+		pthread_mutex_unlock(&job_lock);
+	}
+
+	return NULL;
+}
+
+/**
+ * Add the decoded images to the cache and redraw them.
+ * @param task the done task, switched off when there are no jobs
+ */
+static void my_img_cache_done_task(lv_task_t *task)
+{
+	my_img_cache_job_t **p = &jobs;
+	my_img_cache_job_t *job;
+	my_img_cache_job_t *done = NULL;
+	bool pending = false;
+
+	/* Take out the finished jobs */
+	pthread_mutex_lock(&job_lock);
+	while((job = *p)) {
+		if(job->state == MY_IMG_CACHE_JOB_DECODING ||
+			(job->state == MY_IMG_CACHE_JOB_QUEUED && job->stale == false)) {
+			pending = true;
+			p = &job->next;
+		}
+		else if(job->state == MY_IMG_CACHE_JOB_FAILED && job->stale == false) {
+			if(job->redrawn == false) {
+				/* Its placeholder is replaced by the image opened with the other decoders */
+				my_img_cache_redraw(job);
+				job->redrawn = true;
+			}
+			p = &job->next;
+		}
+		else {
+			*p = job->next;
+			job->next = done;
+			done = job;
+		}
+	}
+	pthread_mutex_unlock(&job_lock);
+
+	while(done) {
+		job = done;
+		done = job->next;
+
+		if(job->entry && job->stale == false && my_img_cache_reserve(job->entry->data_size + sizeof(my_img_cache_entry_t))) {
+			my_img_cache_add(job->entry);
+			my_img_cache_link(job->entry);
+			stats.async_cnt++;
+			my_img_cache_redraw(job);
+		}
+		else if(job->entry) {
+			my_img_cache_free_data(job->entry);
+		}
+
+		my_img_cache_free_job(job);
+	}
+
+	if(pending == false) lv_task_set_prio(task, LV_TASK_PRIO_OFF);
+}
+
+/**
+ * Make LVGL open the image of a job again and redraw the images showing it.
+ * @param job the finished job
+ */
+static void my_img_cache_redraw(my_img_cache_job_t *job)
+{
+	/* LVGL's image cache keeps the placeholder open, it compares the sources by address */
+	lv_img_cache_invalidate_src(job->open_src);
+
+	if(my_img_cache_redraw_children(lv_scr_act(), job) == false &&
+		my_img_cache_redraw_children(lv_layer_top(), job) == false) {
+		/* Not an image object (e.g. a style's pattern), redraw everything */
+		lv_obj_invalidate(lv_scr_act());
+	}
+}
+
+/**
+ * Invalidate the image objects showing the image of a job.
+ * @param parent search among the children of this object
+ * @param job the finished job
+ * @return true if an image was found
+ */
+static bool my_img_cache_redraw_children(lv_obj_t *parent, my_img_cache_job_t *job)
+{
+	lv_obj_t *child;
+	lv_obj_type_t types;
+	const void *src;
+	bool found = false;
+
+	for(child = lv_obj_get_child(parent, NULL); child; child = lv_obj_get_child(parent, child)) {
+		lv_obj_get_type(child, &types);
+		if(strcmp(types.type[0], "lv_img") == 0) {
+			src = lv_img_get_src(child);
+			if(src && lv_img_src_get_type(src) == job->src_type &&
+				(job->src_type == LV_IMG_SRC_VARIABLE ? src == job->src : strcmp(src, job->src) == 0)) {
+				lv_obj_invalidate(child);
+				found = true;
+			}
+		}
+
+		if(my_img_cache_redraw_children(child, job)) found = true;
+	}
+
+	return found;
+}
+
+static void my_img_cache_free_job(my_img_cache_job_t *job)
+{
+	if(job->src_type == LV_IMG_SRC_FILE) lv_mem_free(job->src);
+	lv_mem_free(job);
+}
+#endif /*MY_IMG_CACHE_WORKER_CNT*/
+
+#endif /*MY_USE_IMG_CACHE*/
@@ -0,0 +1,75 @@
+/**
+ * @file my_img_cache.h
+ * Keep decoded images in the LVGL heap between screens
+ */
+
+#ifndef MY_IMG_CACHE_H
+#define MY_IMG_CACHE_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_IMG_CACHE
+
+/*********************
+ *      DEFINES
+ *********************/
+/* The workers allocate the decoded pixels, the built-in `lv_mem_alloc` has no lock */
+#if MY_IMG_CACHE_WORKER_CNT > 0 && !LV_MEM_CUSTOM
+#error "MY_IMG_CACHE_WORKER_CNT needs MY_USE_MEM or malloc (LV_MEM_CUSTOM 1 in lv_conf.h)"
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t hit_cnt;
+	uint32_t miss_cnt;
+	uint32_t evict_cnt;
+	uint32_t entry_cnt;
+	uint32_t used;      /* Bytes of the cached images with their bookkeeping */
+	uint32_t async_cnt; /* Images decoded on the workers */
+	uint32_t async_ms_max;      /* Longest decoding on a worker */
+	uint32_t placeholder_cnt;   /* Placeholders opened while decoding */
+} my_img_cache_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Register the caching image decoder.
+ * Call it after the other image decoders (PNG, JPG, ...) are registered,
+ * decoders registered later are tried first and bypass the cache.
+ * With MY_IMG_CACHE_WORKER_CNT the other decoders (and the file system drivers
+ * they read with) run on the workers too, so they must be reentrant: no shared
+ * state without a lock. Don't register or remove decoders after this call.
+ */
+void my_img_cache_init(void);
+
+/**
+ * Drop a source from the cache, e.g. if the image file changed.
+ * Images being drawn are dropped when they are closed.
+ * @param src an image source or NULL to drop every image
+ */
+void my_img_cache_invalidate(const void *src);
+
+/**
+ * Get the hit/miss counters and the memory usage.
+ * @param stats store the result here
+ */
+void my_img_cache_get_stats(my_img_cache_stats_t *stats);
+
+/**
+ * Print the statistics with printf.
+ */
+void my_img_cache_print_stats(void);
+
+#endif /*MY_USE_IMG_CACHE*/
+
+#endif /*MY_IMG_CACHE_H*/
@@ -0,0 +1,304 @@
+/**
+ * @file my_input.c
+ * Touch samples with kernel timestamps, resampled for LVGL
+ *
+ * The evdev events are timestamped by the kernel when they happen, on
+ * CLOCK_MONOTONIC (EVIOCSCLOCKID). Every event frame (SYN_REPORT) is a sample.
+ *
+ * LVGL reads the position every read period and computes the drag throw and
+ * the gestures from the movement since the previous read, as if the reads
+ * were evenly spaced. They aren't: the task handler is late by a few ms now
+ * and then, and the samples are processed later than they happened. So the
+ * position is reported at evenly spaced times instead: the average read
+ * interval after the previous one, slewed towards MY_INPUT_DELAY_US behind
+ * the clock. The average follows the real rate of the reads (an LVGL task
+ * runs a period after its previous run, so the lateness adds up), so the
+ * timeline stays in phase with the clock without jumps. It's interpolated
+ * between the two samples around that time, or extrapolated with the
+ * velocity of the recent samples (least squares) if it's after the newest.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+
+#include "my_input.h"
+
+#if MY_USE_INPUT_TIMESTAMPS
+
+/*********************
+ *      DEFINES
+ *********************/
+/* The average read interval and the reported time move 1/SLEW of the way to their target per read */
+#define SLEW                8
+
+/* Older headers have only `time` (y2038 safe on 32 bit since Linux 4.16) */
+#ifndef input_event_sec
+#define input_event_sec     time.tv_sec
+#define input_event_usec    time.tv_usec
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint64_t t;                 /* Kernel timestamp [us] */
+	lv_coord_t x;
+	lv_coord_t y;
+} my_input_point_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static bool my_input_at(uint64_t t, lv_point_t *p);
+static bool my_input_fit(int64_t *num_x, int64_t *num_y, int64_t *den);
+static const my_input_point_t *my_input_get(uint32_t age);
+static uint64_t my_input_now_us(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static clockid_t input_clock = CLOCK_MONOTONIC;
+
+static my_input_point_t samples[MY_INPUT_HISTORY];
+static uint32_t sample_head;        /* Index of the next sample */
+static uint32_t sample_cnt;         /* Samples of the current touch */
+static bool pressed;                /* State of the newest event frame */
+
+static bool reported;               /* Pressed was reported to LVGL */
+static uint64_t report_t;           /* Time of the reported position */
+static lv_point_t report_p;
+static uint64_t read_t;             /* Clock of the previous read */
+static int64_t read_interval;       /* Average time between the reads [us] */
+
+static my_input_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int my_input_init(int fd)
+{
+	int clk = CLOCK_MONOTONIC;
+
+	if(ioctl(fd, EVIOCSCLOCKID, &clk) < 0) {
+		/* The timestamps stay on the wall clock, compare them with that */
+		perror("can not set the input clock");
+		input_clock = CLOCK_REALTIME;
+		return -1;
+	}
+
+	input_clock = CLOCK_MONOTONIC;
+
+	return 0;
+}
+
+void my_input_sample(const struct input_event *ev, lv_coord_t x, lv_coord_t y, bool down)
+{
+	my_input_point_t *s;
+
+	pressed = down;
+	if(down == false) {
+		sample_cnt = 0;
+		return;
+	}
+
+	s = &samples[sample_head];
+	s->t = (uint64_t)ev->input_event_sec * 1000000 + ev->input_event_usec;
+	s->x = x;
+	s->y = y;
+
+	sample_head = (sample_head + 1) % MY_INPUT_HISTORY;
+	if(sample_cnt < MY_INPUT_HISTORY) sample_cnt++;
+	stats.sample_cnt++;
+}
+
+void my_input_read(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+	int64_t period = (int64_t)(drv->read_task ? drv->read_task->period : LV_INDEV_DEF_READ_PERIOD) * 1000;
+	uint64_t now = my_input_now_us();
+	uint64_t t = now - MY_INPUT_DELAY_US;
+	int64_t err;
+
+	stats.read_cnt++;
+
+	/* Average the intervals of the reads, a stall of the main loop isn't one */
+	if(read_interval == 0) read_interval = period;
+	if(read_t && now > read_t && now - read_t < (uint64_t)period * 4) {
+		read_interval += ((int64_t)(now - read_t) - read_interval) / SLEW;
+	}
+	read_t = now;
+
+	if(pressed == false || sample_cnt == 0) {
+		/* Release where the last reported movement ended, not at the newest sample:
+		 * the jump to it would be the last movement, i.e. the throw */
+		reported = false;
+		data->state = LV_INDEV_STATE_REL;
+		data->point = report_p;
+		return;
+	}
+
+	if(reported == false) {
+		/* Start at the first sample of the touch */
+		report_t = LV_MATH_MAX(t, my_input_get(sample_cnt - 1)->t);
+		reported = true;
+	}
+	else {
+		/* Evenly spaced, but slewed towards the clock so it doesn't drift away */
+		report_t += read_interval;
+		err = (int64_t)(t - report_t);
+		if(err > read_interval * 2 || err < -read_interval * 2) {
+			/* A stall of the main loop or a time jump */
+			report_t = t;
+			stats.resync_cnt++;
+		}
+		else {
+			report_t += err / SLEW;
+		}
+	}
+
+	if(my_input_at(report_t, &report_p)) stats.predict_cnt++;
+
+	data->state = LV_INDEV_STATE_PR;
+	data->point = report_p;
+}
+
+void my_input_get_velocity(lv_point_t *v)
+{
+	int64_t num_x;
+	int64_t num_y;
+	int64_t den;
+
+	v->x = 0;
+	v->y = 0;
+	if(pressed == false || my_input_fit(&num_x, &num_y, &den) == false) return;
+
+	v->x = num_x * 1000000 / den;
+	v->y = num_y * 1000000 / den;
+}
+
+void my_input_get_stats(my_input_stats_t *res)
+{
+	*res = stats;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get the position of the touch at a time.
+ * @param t the time [us]
+ * @param p store the position here
+ * @return true if it's extrapolated
+ */
+static bool my_input_at(uint64_t t, lv_point_t *p)
+{
+	const my_input_point_t *newer = my_input_get(0);
+	const my_input_point_t *older;
+	int64_t num_x;
+	int64_t num_y;
+	int64_t den;
+	int64_t dt;
+	uint32_t i;
+
+	if(t >= newer->t) {
+		p->x = newer->x;
+		p->y = newer->y;
+
+		dt = LV_MATH_MIN(t - newer->t, MY_INPUT_PREDICT_MAX_US);
+		if(dt == 0 || my_input_fit(&num_x, &num_y, &den) == false) return false;
+
+		p->x += num_x * dt / den;
+		p->y += num_y * dt / den;
+		return true;
+	}
+
+	for(i = 1; i < sample_cnt; i++) {
+		older = my_input_get(i);
+		if(older->t <= t) {
+			dt = newer->t - older->t;
+			p->x = older->x + (int64_t)(newer->x - older->x) * (int64_t)(t - older->t) / dt;
+			p->y = older->y + (int64_t)(newer->y - older->y) * (int64_t)(t - older->t) / dt;
+			return false;
+		}
+		newer = older;
+	}
+
+	/* Before the oldest sample */
+	p->x = newer->x;
+	p->y = newer->y;
+
+	return false;
+}
+
+/**
+ * Fit a line to the samples of the last MY_INPUT_VELOCITY_WINDOW_US.
+ * The velocity is `num / den` [px/us].
+ * @param num_x store the numerator of the x velocity here
+ * @param num_y store the numerator of the y velocity here
+ * @param den store the denominator here, > 0
+ * @return false if there are less than 2 samples
+ */
+static bool my_input_fit(int64_t *num_x, int64_t *num_y, int64_t *den)
+{
+	const my_input_point_t *newest = my_input_get(0);
+	const my_input_point_t *s;
+	int64_t n = 0;
+	int64_t st = 0, sx = 0, sy = 0;
+	int64_t stt = 0, stx = 0, sty = 0;
+	int64_t t, x, y;
+	uint32_t i;
+
+	/* Relative to the newest sample, so the sums stay small */
+	for(i = 0; i < sample_cnt; i++) {
+		s = my_input_get(i);
+		if(newest->t - s->t > MY_INPUT_VELOCITY_WINDOW_US) break;
+
+		t = (int64_t)s->t - (int64_t)newest->t;
+		x = s->x - newest->x;
+		y = s->y - newest->y;
+		n++;
+		st += t;
+		sx += x;
+		sy += y;
+		stt += t * t;
+		stx += t * x;
+		sty += t * y;
+	}
+
+	if(n < 2) return false;
+
+	*den = n * stt - st * st;
+	if(*den <= 0) return false;    /* Same timestamps */
+
+	*num_x = n * stx - st * sx;
+	*num_y = n * sty - st * sy;
+
+	return true;
+}
+
+/**
+ * Get a sample of the current touch.
+ * @param age 0: the newest, `sample_cnt - 1`: the oldest
+ * @return the sample
+ */
+static const my_input_point_t *my_input_get(uint32_t age)
+{
+	return &samples[(sample_head + MY_INPUT_HISTORY - 1 - age) % MY_INPUT_HISTORY];
+}
+
+static uint64_t my_input_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(input_clock, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /*MY_USE_INPUT_TIMESTAMPS*/
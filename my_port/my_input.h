@@ -0,0 +1,76 @@
+/**
+ * @file my_input.h
+ * Touch samples with kernel timestamps, resampled for LVGL
+ */
+
+#ifndef MY_INPUT_H
+#define MY_INPUT_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <linux/input.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_INPUT_TIMESTAMPS
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t sample_cnt;        /* Touch positions (SYN_REPORT) */
+	uint32_t read_cnt;
+	uint32_t predict_cnt;       /* Reads after the newest sample, extrapolated */
+	uint32_t resync_cnt;        /* Reads too far from the even timeline */
+} my_input_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Let the input device timestamp the events with CLOCK_MONOTONIC.
+ * @param fd the evdev device
+ * @return 0 on success, -1 if the kernel doesn't support it (CLOCK_REALTIME is used)
+ */
+int my_input_init(int fd);
+
+/**
+ * Add the state of the touch at the end of an event frame.
+ * @param ev the SYN_REPORT event, its timestamp is used
+ * @param x the current x coordinate
+ * @param y the current y coordinate
+ * @param down the current touch state
+ */
+void my_input_sample(const struct input_event *ev, lv_coord_t x, lv_coord_t y, bool down);
+
+/**
+ * Get the touch for LVGL: the position at evenly spaced times (the average read interval apart),
+ * interpolated between the samples or extrapolated with their velocity.
+ * LVGL computes the drag throw and the gestures from the movement per read,
+ * so the jitter of the reads doesn't change it.
+ * @param drv the input device driver, its read period is used
+ * @param data store the state and the position here
+ */
+void my_input_read(lv_indev_drv_t *drv, lv_indev_data_t *data);
+
+/**
+ * Get the velocity of the touch from the samples of the last MY_INPUT_VELOCITY_WINDOW_US.
+ * @param v store the velocity here [px/s], 0 if not pressed
+ */
+void my_input_get_velocity(lv_point_t *v);
+
+/**
+ * Get the input statistics.
+ * @param stats store the result here
+ */
+void my_input_get_stats(my_input_stats_t *stats);
+
+#endif /*MY_USE_INPUT_TIMESTAMPS*/
+
+#endif /*MY_INPUT_H*/
@@ -0,0 +1,344 @@
+/**
+ * @file my_layer.c
+ * Cache of a static layer, composed instead of drawing it again
+ *
+ * The design and signal functions of the layer's objects are wrapped.
+ * LVGL draws an object, then its children, then calls the object's design
+ * function again (LV_DESIGN_DRAW_POST). At that point the draw buffer holds
+ * the layer with everything under it, so it's copied into the full screen
+ * cache; every line of the cache remembers its valid span. When an area
+ * of the layer is drawn again and the cache has all of it, the root copies
+ * it into the draw buffer and its children don't draw anything.
+ * The widgets over the layer are drawn as usual, blended on the cached pixels.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "my_layer.h"
+
+#if MY_USE_LAYER_CACHE
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	lv_obj_t *obj;
+	lv_design_cb_t design_cb;       /* The original functions of `obj` */
+	lv_signal_cb_t signal_cb;
+} my_layer_obj_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static lv_design_res_t my_layer_design(lv_obj_t *obj, const lv_area_t *clip_area, lv_design_mode_t mode);
+static lv_res_t my_layer_signal(lv_obj_t *obj, lv_signal_t sign, void *param);
+static void my_layer_add(lv_obj_t *obj);
+static void my_layer_add_children(lv_obj_t *parent);
+static void my_layer_remove_all(void);
+static void my_layer_forget(void);
+static my_layer_obj_t *my_layer_find(const lv_obj_t *obj);
+static bool my_layer_has(const lv_area_t *area);
+static void my_layer_compose(const lv_area_t *area);
+static void my_layer_record(const lv_area_t *area);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_color_t *cache;
+static lv_coord_t *span_x1;         /* The valid pixels of every line of the cache */
+static lv_coord_t *span_x2;
+static lv_coord_t scr_w;
+static lv_coord_t scr_h;
+
+static my_layer_obj_t objs[MY_LAYER_CACHE_MAX_OBJS];
+static lv_obj_t *root;
+static lv_area_t root_coords;       /* Where the cache was drawn */
+static bool composed;               /* The root's area was copied, the children don't draw */
+static bool rescan;                 /* Children were added to the layer */
+static my_layer_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int my_layer_init(lv_coord_t hor_res, lv_coord_t ver_res)
+{
+	cache = calloc(hor_res * ver_res, sizeof(lv_color_t));
+	span_x1 = calloc(ver_res, sizeof(lv_coord_t));
+	span_x2 = calloc(ver_res, sizeof(lv_coord_t));
+	if(cache == NULL || span_x1 == NULL || span_x2 == NULL) {
+		perror("can not allocate the layer cache");
+		free(cache);
+		free(span_x1);
+		free(span_x2);
+		cache = NULL;
+		return -1;
+	}
+
+	scr_w = hor_res;
+	scr_h = ver_res;
+
+	return 0;
+}
+
+void my_layer_set_static(lv_obj_t *obj)
+{
+	if(cache == NULL) return;
+
+	my_layer_remove_all();
+	if(obj == NULL) return;
+
+	root = obj;
+	my_layer_add(obj);
+	my_layer_add_children(obj);
+	my_layer_invalidate();
+}
+
+void my_layer_invalidate(void)
+{
+	if(root == NULL) return;
+
+	my_layer_forget();
+
+	/* Draw all of it once to fill the cache */
+	lv_obj_invalidate(root);
+}
+
+void my_layer_get_stats(my_layer_stats_t *res)
+{
+	*res = stats;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static lv_design_res_t my_layer_design(lv_obj_t *obj, const lv_area_t *clip_area, lv_design_mode_t mode)
+{
+	my_layer_obj_t *o = my_layer_find(obj);
+	lv_design_res_t res;
+
+	if(o == NULL) return LV_DESIGN_RES_OK;
+	if(mode == LV_DESIGN_COVER_CHK) return o->design_cb(obj, clip_area, mode);
+
+	if(obj != root) {
+		if(composed) return LV_DESIGN_RES_OK;
+		return o->design_cb(obj, clip_area, mode);
+	}
+
+	if(mode == LV_DESIGN_DRAW_MAIN) {
+		lv_area_t coords;
+
+		/* A parent was moved: no signal comes, but LVGL has invalidated the old and new area */
+		lv_obj_get_coords(root, &coords);
+		if(memcmp(&coords, &root_coords, sizeof(lv_area_t)) != 0) my_layer_forget();
+
+		if(rescan) {
+			/* Their own create functions have set their design functions by now */
+			my_layer_add_children(root);
+			rescan = false;
+		}
+
+		/* The masks (e.g. rounded corners of a parent) would be skipped by the copy */
+		composed = lv_draw_mask_get_cnt() == 0 && my_layer_has(clip_area);
+		if(composed) {
+			my_layer_compose(clip_area);
+			return LV_DESIGN_RES_OK;
+		}
+
+		return o->design_cb(obj, clip_area, mode);
+	}
+
+	/* LV_DESIGN_DRAW_POST */
+	if(composed) {
+		composed = false;
+		return LV_DESIGN_RES_OK;
+	}
+
+	res = o->design_cb(obj, clip_area, mode);
+	if(lv_draw_mask_get_cnt() == 0) {
+		my_layer_record(clip_area);
+		stats.miss_cnt++;
+	}
+
+	return res;
+}
+
+static lv_res_t my_layer_signal(lv_obj_t *obj, lv_signal_t sign, void *param)
+{
+	my_layer_obj_t *o = my_layer_find(obj);
+	lv_res_t res;
+
+	if(o == NULL) return LV_RES_INV;
+
+	res = o->signal_cb(obj, sign, param);
+
+	if(sign == LV_SIGNAL_STYLE_CHG || sign == LV_SIGNAL_COORD_CHG || sign == LV_SIGNAL_CHILD_CHG) {
+		if(sign == LV_SIGNAL_CHILD_CHG) rescan = true;
+		my_layer_invalidate();
+	}
+	else if(sign == LV_SIGNAL_CLEANUP) {
+		if(obj == root) {
+			my_layer_remove_all();
+		}
+		else {
+			o->obj = NULL;
+			my_layer_invalidate();
+		}
+	}
+
+	return res;
+}
+
+static void my_layer_add(lv_obj_t *obj)
+{
+	uint32_t i;
+
+	if(my_layer_find(obj)) return;
+
+	for(i = 0; i < MY_LAYER_CACHE_MAX_OBJS; i++) {
+		if(objs[i].obj == NULL) {
+			objs[i].obj = obj;
+			objs[i].design_cb = lv_obj_get_design_cb(obj);
+			objs[i].signal_cb = lv_obj_get_signal_cb(obj);
+			lv_obj_set_design_cb(obj, my_layer_design);
+			lv_obj_set_signal_cb(obj, my_layer_signal);
+			return;
+		}
+	}
+
+	/* It's drawn as usual, over the cached pixels */
+	LV_LOG_WARN("my_layer_add: too many objects, increase MY_LAYER_CACHE_MAX_OBJS");
+}
+
+static void my_layer_add_children(lv_obj_t *parent)
+{
+	lv_obj_t *child;
+
+	for(child = lv_obj_get_child(parent, NULL); child; child = lv_obj_get_child(parent, child)) {
+		my_layer_add(child);
+		my_layer_add_children(child);
+	}
+}
+
+static void my_layer_remove_all(void)
+{
+	uint32_t i;
+
+	for(i = 0; i < MY_LAYER_CACHE_MAX_OBJS; i++) {
+		if(objs[i].obj == NULL) continue;
+
+		lv_obj_set_design_cb(objs[i].obj, objs[i].design_cb);
+		lv_obj_set_signal_cb(objs[i].obj, objs[i].signal_cb);
+		objs[i].obj = NULL;
+	}
+
+	root = NULL;
+	composed = false;
+	rescan = false;
+}
+
+/**
+ * Empty the cache, it's filled again as the layer is drawn.
+ */
+static void my_layer_forget(void)
+{
+	lv_coord_t y;
+
+	for(y = 0; y < scr_h; y++) {
+		span_x1[y] = 0;
+		span_x2[y] = -1;
+	}
+
+	lv_obj_get_coords(root, &root_coords);
+	stats.invalidate_cnt++;
+}
+
+static my_layer_obj_t *my_layer_find(const lv_obj_t *obj)
+{
+	uint32_t i;
+
+	for(i = 0; i < MY_LAYER_CACHE_MAX_OBJS; i++) {
+		if(objs[i].obj == obj) return &objs[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * Check whether the cache has every pixel of an area.
+ * @param area the area to check
+ * @return true if it can be composed
+ */
+static bool my_layer_has(const lv_area_t *area)
+{
+	lv_coord_t y;
+
+	if(area->x1 < 0 || area->y1 < 0 || area->x2 >= scr_w || area->y2 >= scr_h) return false;
+
+	for(y = area->y1; y <= area->y2; y++) {
+		if(span_x1[y] > area->x1 || span_x2[y] < area->x2) return false;
+	}
+
+	return true;
+}
+
+/**
+ * Copy an area from the cache to the draw buffer.
+ * @param area the area to copy, the cache has all of it
+ */
+static void my_layer_compose(const lv_area_t *area)
+{
+	lv_disp_buf_t *vdb = lv_disp_get_buf(_lv_refr_get_disp_refreshing());
+	lv_color_t *buf = vdb->buf_act;
+	int32_t vdb_w = lv_area_get_width(&vdb->area);
+	uint32_t len = lv_area_get_width(area) * sizeof(lv_color_t);
+	lv_coord_t y;
+
+	for(y = area->y1; y <= area->y2; y++) {
+		memcpy(&buf[(y - vdb->area.y1) * vdb_w + (area->x1 - vdb->area.x1)],
+				&cache[y * scr_w + area->x1], len);
+	}
+
+	stats.compose_cnt++;
+	stats.px_cnt += lv_area_get_size(area);
+}
+
+/**
+ * Copy a drawn area of the layer from the draw buffer to the cache.
+ * @param area the area to copy
+ */
+static void my_layer_record(const lv_area_t *area)
+{
+	lv_disp_buf_t *vdb = lv_disp_get_buf(_lv_refr_get_disp_refreshing());
+	const lv_color_t *buf = vdb->buf_act;
+	int32_t vdb_w = lv_area_get_width(&vdb->area);
+	lv_area_t a;
+	uint32_t len;
+	lv_coord_t y;
+
+	/* Only the part in the draw buffer has been drawn */
+	if(_lv_area_intersect(&a, area, &vdb->area) == false) return;
+
+	len = lv_area_get_width(&a) * sizeof(lv_color_t);
+	for(y = a.y1; y <= a.y2; y++) {
+		memcpy(&cache[y * scr_w + a.x1], &buf[(y - vdb->area.y1) * vdb_w + (a.x1 - vdb->area.x1)], len);
+
+		/* Join the new span if it touches the valid one, replace it otherwise */
+		if(span_x1[y] <= span_x2[y] && a.x1 <= span_x2[y] + 1 && a.x2 >= span_x1[y] - 1) {
+			span_x1[y] = LV_MATH_MIN(span_x1[y], a.x1);
+			span_x2[y] = LV_MATH_MAX(span_x2[y], a.x2);
+		}
+		else {
+			span_x1[y] = a.x1;
+			span_x2[y] = a.x2;
+		}
+	}
+}
+
+#endif /*MY_USE_LAYER_CACHE*/
@@ -0,0 +1,65 @@
+/**
+ * @file my_layer.h
+ * Cache of a static layer, composed instead of drawing it again
+ */
+
+#ifndef MY_LAYER_H
+#define MY_LAYER_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_LAYER_CACHE
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t compose_cnt;       /* Areas copied from the cache */
+	uint32_t miss_cnt;          /* Areas drawn because the cache didn't have them */
+	uint32_t invalidate_cnt;    /* Changes of the layer */
+	uint64_t px_cnt;            /* Pixels copied from the cache */
+} my_layer_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Allocate the cache.
+ * @param hor_res horizontal resolution of the screen
+ * @param ver_res vertical resolution of the screen
+ * @return 0 on success, -1 on error
+ */
+int my_layer_init(lv_coord_t hor_res, lv_coord_t ver_res);
+
+/**
+ * Mark an object and its children as the static layer. The layer is drawn once
+ * into the cache (with everything under it) and then copied from the cache.
+ * The children added later to the layer's objects join the layer when it's drawn next.
+ * @param obj the root of the layer, e.g. a background image, NULL to stop caching
+ */
+void my_layer_set_static(lv_obj_t *obj);
+
+/**
+ * Draw the layer again. The style, position and children changes of the
+ * layer's objects and the moves of its parents are followed automatically,
+ * call it after other changes (e.g. the text of a label or the source of an
+ * image) or when the objects under the layer change.
+ */
+void my_layer_invalidate(void);
+
+/**
+ * Get the cache statistics.
+ * @param stats store the result here
+ */
+void my_layer_get_stats(my_layer_stats_t *stats);
+
+#endif /*MY_USE_LAYER_CACHE*/
+
+#endif /*MY_LAYER_H*/
@@ -0,0 +1,119 @@
+/**
+ * @file my_locked.c
+ * Memory backed by huge pages and locked into RAM.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "my_locked.h"
+#include "my_port_conf.h"
+
+#if MY_USE_LOCKED_MEM
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_LOCKED_HUGE_PAGE_SIZE    (2 * 1024 * 1024)
+
+#define MY_LOCKED_ROUND_UP(s, a)    (((s) + (a) - 1) & ~(size_t)((a) - 1))
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void *my_locked_map_thp(size_t size);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static my_locked_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void *my_locked_map(size_t size)
+{
+	size_t *kind = &stats.hugetlb_size;
+	void *p = MAP_FAILED;
+
+#if MY_LOCKED_MEM_HUGETLB && defined(MAP_HUGETLB)
+	/* Needs pages reserved in /proc/sys/vm/nr_hugepages */
+	size_t huge_size = MY_LOCKED_ROUND_UP(size, MY_LOCKED_HUGE_PAGE_SIZE);
+	p = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+	if(p != MAP_FAILED) size = huge_size;
+#endif
+
+	if(p == MAP_FAILED) {
+		/* Transparent huge pages are only a hint, don't lock the padding to 2 MB */
+		size = MY_LOCKED_ROUND_UP(size, (size_t)sysconf(_SC_PAGESIZE));
+		kind = &stats.thp_size;
+		p = my_locked_map_thp(size);
+	}
+
+	if(p == NULL) return NULL;
+
+	/* Also faults in every page which is not present yet */
+	if(mlock(p, size) < 0) {
+		perror("can not mlock, the memory can be paged out");
+		kind = &stats.unlocked_size;
+	}
+
+	*kind += size;
+	stats.map_cnt++;
+
+	return p;
+}
+
+void my_locked_get_stats(my_locked_stats_t *res)
+{
+	*res = stats;
+}
+
+void my_locked_print_stats(void)
+{
+	printf("locked mem: %u maps, hugetlb: %zu kB, thp: %zu kB, not locked: %zu kB\n",
+			stats.map_cnt, stats.hugetlb_size / 1024, stats.thp_size / 1024, stats.unlocked_size / 1024);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Map normal pages aligned to the huge page size and ask for transparent huge pages.
+ * @param size size of the memory, multiple of the page size
+ * @return pointer to the memory or NULL
+ */
+static void *my_locked_map_thp(size_t size)
+{
+	size_t map_size = size + MY_LOCKED_HUGE_PAGE_SIZE;
+	uint8_t *p;
+	uint8_t *start;
+
+	p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(p == MAP_FAILED) {
+		perror("can not map locked memory");
+		return NULL;
+	}
+
+	/* Cut the unaligned head and tail */
+	start = (uint8_t *)MY_LOCKED_ROUND_UP((uintptr_t)p, MY_LOCKED_HUGE_PAGE_SIZE);
+	if(start > p) munmap(p, start - p);
+	munmap(start + size, p + map_size - (start + size));
+
+#ifdef MADV_HUGEPAGE
+	madvise(start, size, MADV_HUGEPAGE);
+#endif
+
+	return start;
+}
+
+#endif /*MY_USE_LOCKED_MEM*/
@@ -0,0 +1,49 @@
+/**
+ * @file my_locked.h
+ * Memory backed by huge pages and locked into RAM.
+ */
+
+#ifndef MY_LOCKED_H
+#define MY_LOCKED_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stddef.h>
+#include <stdint.h>
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t map_cnt;
+	size_t hugetlb_size;        /* Bytes on hugetlb pages */
+	size_t thp_size;            /* Bytes on normal pages, transparent huge pages where possible */
+	size_t unlocked_size;       /* Bytes which couldn't be locked */
+} my_locked_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Map memory which doesn't page fault after this call.
+ * hugetlb pages are tried first, then transparent huge pages, then normal pages.
+ * The memory is locked with `mlock` and prefaulted.
+ * @param size size of the memory in bytes
+ * @return pointer to the memory or NULL. It is never unmapped.
+ */
+void *my_locked_map(size_t size);
+
+/**
+ * Get the sizes of the mapped memory.
+ * @param stats store the result here
+ */
+void my_locked_get_stats(my_locked_stats_t *stats);
+
+/**
+ * Print the statistics with printf.
+ */
+void my_locked_print_stats(void);
+
+#endif /*MY_LOCKED_H*/
@@ -0,0 +1,432 @@
+/**
+ * @file my_mem.c
+ * Pooled allocator of the port. Plugged into LVGL with MY_USE_MEM in lv_conf.h.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "my_mem.h"
+#include "my_locked.h"
+#include "my_port_conf.h"
+
+#if MY_USE_MEM
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_MEM_TAG_SLAB     0x534c4142  /* "SLAB" */
+#define MY_MEM_TAG_ARENA    0x4152454e  /* "AREN" */
+#define MY_MEM_TAG_SYS      0x53595354  /* "SYST" */
+
+#define MY_MEM_SLAB_MIN     32
+#define MY_MEM_SLAB_MAX     (MY_MEM_SLAB_MIN << (MY_MEM_SLAB_CLASS_CNT - 1))
+
+/* Don't split arena blocks to smaller pieces than this */
+#define MY_MEM_ARENA_MIN    64
+
+#define MY_MEM_ALIGN(s)     (((s) + 7) & ~(size_t)7)
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+/* Every block has a 32 bit tag right before the returned pointer */
+typedef struct _my_mem_slab_blk {
+	uint16_t cls;           /* Size class */
+	uint16_t req;           /* Requested size */
+	uint32_t tag;
+	struct _my_mem_slab_blk *next_free;     /* Only valid while free */
+} my_mem_slab_blk_t;
+
+typedef struct _my_mem_arena_blk {
+	uint32_t size;          /* Size of the block with the header */
+	uint32_t prev_size;     /* Size of the previous block, 0 for the first */
+	uint32_t used;
+	uint32_t tag;
+	struct _my_mem_arena_blk *next_free;    /* Only valid while free */
+	struct _my_mem_arena_blk *prev_free;
+} my_mem_arena_blk_t;
+
+/* 16 bytes on 32 and 64 bit too, so the payload keeps malloc's alignment (doubles, uint64_t) */
+typedef struct {
+	size_t size;            /* Requested size */
+	uint8_t pad[16 - sizeof(size_t) - sizeof(uint32_t)];
+	uint32_t tag;
+} my_mem_sys_blk_t;
+
+#define MY_MEM_SLAB_HDR     offsetof(my_mem_slab_blk_t, next_free)
+#define MY_MEM_ARENA_HDR    offsetof(my_mem_arena_blk_t, next_free)
+#define MY_MEM_SYS_HDR      sizeof(my_mem_sys_blk_t)
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void *my_mem_slab_alloc(size_t size);
+static void my_mem_slab_free(my_mem_slab_blk_t *blk);
+static void *my_mem_arena_alloc(size_t size);
+static void my_mem_arena_free(my_mem_arena_blk_t *blk);
+static void my_mem_arena_unlink(my_mem_arena_blk_t *blk);
+static void my_mem_arena_link(my_mem_arena_blk_t *blk);
+static my_mem_arena_blk_t *my_mem_arena_next(my_mem_arena_blk_t *blk);
+static void *my_mem_sys_alloc(size_t size);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+static my_mem_slab_blk_t *slab_free[MY_MEM_SLAB_CLASS_CNT];
+static uint8_t *arena_start;
+static uint8_t *arena_end;
+static my_mem_arena_blk_t *arena_free;
+static size_t slab_req;     /* Requested bytes of the used slab blocks */
+static my_mem_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_mem_init(void)
+{
+	my_mem_arena_blk_t *blk;
+	void *p;
+
+	if(arena_start) return;
+
+#if MY_USE_LOCKED_MEM
+	p = my_locked_map(MY_MEM_ARENA_SIZE);
+	if(p == NULL) return;
+#else
+	p = mmap(NULL, MY_MEM_ARENA_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(p == MAP_FAILED) return;
+#endif
+
+	arena_start = p;
+	arena_end = arena_start + MY_MEM_ARENA_SIZE;
+	blk = (my_mem_arena_blk_t *)arena_start;
+	blk->size = MY_MEM_ARENA_SIZE;
+	blk->prev_size = 0;
+	blk->used = 0;
+	blk->tag = 0;
+	my_mem_arena_link(blk);
+	stats.arena_total = MY_MEM_ARENA_SIZE;
+}
+
+void *my_mem_alloc(size_t size)
+{
+	void *p;
+
+	if(size == 0) return NULL;
+
+	pthread_mutex_lock(&mem_lock);
+
+	if(size + MY_MEM_SLAB_HDR <= MY_MEM_SLAB_MAX) {
+		p = my_mem_slab_alloc(size);
+	}
+	else {
+		p = my_mem_arena_alloc(size);
+		if(p == NULL) p = my_mem_sys_alloc(size);
+	}
+
+	if(p) stats.alloc_cnt++;
+	else stats.fail_cnt++;
+
+	pthread_mutex_unlock(&mem_lock);
+
+	return p;
+}
+
+void my_mem_free(void *p)
+{
+	uint32_t tag;
+
+	if(p == NULL) return;
+
+	tag = ((uint32_t *)p)[-1];
+
+	pthread_mutex_lock(&mem_lock);
+
+	stats.free_cnt++;
+
+	switch(tag) {
+		case MY_MEM_TAG_SLAB:
+			my_mem_slab_free((my_mem_slab_blk_t *)((uint8_t *)p - MY_MEM_SLAB_HDR));
+			break;
+		case MY_MEM_TAG_ARENA:
+			my_mem_arena_free((my_mem_arena_blk_t *)((uint8_t *)p - MY_MEM_ARENA_HDR));
+			break;
+		case MY_MEM_TAG_SYS: {
+			my_mem_sys_blk_t *blk = (my_mem_sys_blk_t *)((uint8_t *)p - MY_MEM_SYS_HDR);
+			stats.used -= blk->size;
+			blk->tag = 0;
+			free(blk);
+			break;
+		}
+		default:	/* Not ours or freed twice */
+			fprintf(stderr, "my_mem_free: invalid pointer %p\n", p);
+			stats.free_cnt--;
+			break;
+	}
+
+	pthread_mutex_unlock(&mem_lock);
+}
+
+size_t my_mem_get_size(const void *p)
+{
+	if(p == NULL) return 0;
+
+	switch(((const uint32_t *)p)[-1]) {
+		case MY_MEM_TAG_SLAB: {
+			const my_mem_slab_blk_t *blk = (const my_mem_slab_blk_t *)((const uint8_t *)p - MY_MEM_SLAB_HDR);
+			return ((size_t)MY_MEM_SLAB_MIN << blk->cls) - MY_MEM_SLAB_HDR;
+		}
+		case MY_MEM_TAG_ARENA: {
+			const my_mem_arena_blk_t *blk = (const my_mem_arena_blk_t *)((const uint8_t *)p - MY_MEM_ARENA_HDR);
+			return blk->size - MY_MEM_ARENA_HDR;
+		}
+		case MY_MEM_TAG_SYS:
+			return ((const my_mem_sys_blk_t *)((const uint8_t *)p - MY_MEM_SYS_HDR))->size;
+		default:
+			return 0;
+	}
+}
+
+void my_mem_get_stats(my_mem_stats_t *res)
+{
+	my_mem_arena_blk_t *blk;
+	size_t arena_free_total = 0;
+	size_t biggest = 0;
+
+	pthread_mutex_lock(&mem_lock);
+
+	*res = stats;
+
+	for(blk = arena_free; blk; blk = blk->next_free) {
+		arena_free_total += blk->size;
+		if(blk->size > biggest) biggest = blk->size;
+	}
+	res->arena_free_biggest = biggest;
+	res->arena_frag_pct = arena_free_total ? 100 - (biggest * 100 / arena_free_total) : 0;
+
+	if(stats.slab_used) {
+		res->slab_waste_pct = 100 - (slab_req * 100 / stats.slab_used);
+	}
+
+	pthread_mutex_unlock(&mem_lock);
+}
+
+void my_mem_print_stats(void)
+{
+	my_mem_stats_t s;
+	uint32_t i;
+
+	my_mem_get_stats(&s);
+
+	printf("mem: used %zu B, %u alloc, %u free, %u fail, %u sys\n",
+			s.used, s.alloc_cnt, s.free_cnt, s.fail_cnt, s.sys_cnt);
+	printf("mem: slab %zu/%zu B, waste %u%%, blocks:",
+			s.slab_used, s.slab_total, s.slab_waste_pct);
+	for(i = 0; i < MY_MEM_SLAB_CLASS_CNT; i++) {
+		printf(" %u", s.slab_blocks[i]);
+	}
+	printf("\nmem: arena %zu/%zu B, biggest free %zu B, frag %u%%\n",
+			s.arena_used, s.arena_total, s.arena_free_biggest, s.arena_frag_pct);
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Take a block from the smallest fitting size class.
+ * A new page is carved into blocks when the class is empty.
+ * @param size requested size
+ * @return pointer to the payload or NULL
+ */
+static void *my_mem_slab_alloc(size_t size)
+{
+	uint32_t cls = 0;
+	size_t blk_size = MY_MEM_SLAB_MIN;
+	my_mem_slab_blk_t *blk;
+
+	while(blk_size < size + MY_MEM_SLAB_HDR) {
+		blk_size <<= 1;
+		cls++;
+	}
+
+	if(slab_free[cls] == NULL) {
+		uint8_t *page = malloc(MY_MEM_SLAB_PAGE_SIZE);
+		size_t ofs;
+
+		if(page == NULL) return NULL;
+
+		for(ofs = 0; ofs + blk_size <= MY_MEM_SLAB_PAGE_SIZE; ofs += blk_size) {
+			blk = (my_mem_slab_blk_t *)(page + ofs);
+			blk->cls = cls;
+			blk->tag = 0;
+			blk->next_free = slab_free[cls];
+			slab_free[cls] = blk;
+		}
+		stats.slab_total += MY_MEM_SLAB_PAGE_SIZE;
+	}
+
+	blk = slab_free[cls];
+	slab_free[cls] = blk->next_free;
+	blk->req = size;
+	blk->tag = MY_MEM_TAG_SLAB;
+
+	stats.used += size;
+	slab_req += size;
+	stats.slab_used += blk_size;
+	stats.slab_blocks[cls]++;
+
+	return (uint8_t *)blk + MY_MEM_SLAB_HDR;
+}
+
+/**
+ * Give back a block to its size class. Slab pages are never released.
+ * @param blk the block to free
+ */
+static void my_mem_slab_free(my_mem_slab_blk_t *blk)
+{
+	stats.used -= blk->req;
+	slab_req -= blk->req;
+	stats.slab_used -= (size_t)MY_MEM_SLAB_MIN << blk->cls;
+	stats.slab_blocks[blk->cls]--;
+
+	blk->tag = 0;
+	blk->next_free = slab_free[blk->cls];
+	slab_free[blk->cls] = blk;
+}
+
+/**
+ * First-fit allocation from the arena. The arena is mapped on the first use
+ * if `my_mem_init()` wasn't called.
+ * @param size requested size
+ * @return pointer to the payload or NULL if no free block is big enough
+ */
+static void *my_mem_arena_alloc(size_t size)
+{
+	size_t need = MY_MEM_ALIGN(size + MY_MEM_ARENA_HDR);
+	my_mem_arena_blk_t *blk;
+
+	if(arena_start == NULL) {
+		my_mem_init();
+		if(arena_start == NULL) return NULL;
+	}
+
+	for(blk = arena_free; blk; blk = blk->next_free) {
+		if(blk->size >= need) break;
+	}
+	if(blk == NULL) return NULL;
+
+	my_mem_arena_unlink(blk);
+
+	/* Split the end of the block if the remainder is usable */
+	if(blk->size - need >= MY_MEM_ARENA_MIN) {
+		my_mem_arena_blk_t *rest = (my_mem_arena_blk_t *)((uint8_t *)blk + need);
+		my_mem_arena_blk_t *next;
+
+		rest->size = blk->size - need;
+		rest->prev_size = need;
+		rest->used = 0;
+		rest->tag = 0;
+		blk->size = need;
+
+		next = my_mem_arena_next(rest);
+		if(next) next->prev_size = rest->size;
+		my_mem_arena_link(rest);
+	}
+
+	blk->used = 1;
+	blk->tag = MY_MEM_TAG_ARENA;
+
+	stats.used += blk->size - MY_MEM_ARENA_HDR;
+	stats.arena_used += blk->size;
+
+	return (uint8_t *)blk + MY_MEM_ARENA_HDR;
+}
+
+/**
+ * Free an arena block and merge it with its free neighbours.
+ * @param blk the block to free
+ */
+static void my_mem_arena_free(my_mem_arena_blk_t *blk)
+{
+	my_mem_arena_blk_t *next;
+
+	stats.used -= blk->size - MY_MEM_ARENA_HDR;
+	stats.arena_used -= blk->size;
+
+	blk->used = 0;
+	blk->tag = 0;
+
+	next = my_mem_arena_next(blk);
+	if(next && next->used == 0) {
+		my_mem_arena_unlink(next);
+		blk->size += next->size;
+	}
+
+	if(blk->prev_size) {
+		my_mem_arena_blk_t *prev = (my_mem_arena_blk_t *)((uint8_t *)blk - blk->prev_size);
+		if(prev->used == 0) {
+			my_mem_arena_unlink(prev);
+			prev->size += blk->size;
+			blk = prev;
+		}
+	}
+
+	next = my_mem_arena_next(blk);
+	if(next) next->prev_size = blk->size;
+
+	my_mem_arena_link(blk);
+}
+
+static void my_mem_arena_unlink(my_mem_arena_blk_t *blk)
+{
+	if(blk->prev_free) blk->prev_free->next_free = blk->next_free;
+	else arena_free = blk->next_free;
+	if(blk->next_free) blk->next_free->prev_free = blk->prev_free;
+}
+
+static void my_mem_arena_link(my_mem_arena_blk_t *blk)
+{
+	blk->prev_free = NULL;
+	blk->next_free = arena_free;
+	if(arena_free) arena_free->prev_free = blk;
+	arena_free = blk;
+}
+
+static my_mem_arena_blk_t *my_mem_arena_next(my_mem_arena_blk_t *blk)
+{
+	uint8_t *next = (uint8_t *)blk + blk->size;
+
+	return next < arena_end ? (my_mem_arena_blk_t *)next : NULL;
+}
+
+/**
+ * Fall back to malloc when the arena is full.
+ * @param size requested size
+ * @return pointer to the payload or NULL
+ */
+static void *my_mem_sys_alloc(size_t size)
+{
+	my_mem_sys_blk_t *blk = malloc(MY_MEM_SYS_HDR + size);
+
+	if(blk == NULL) return NULL;
+
+	blk->size = size;
+	blk->tag = MY_MEM_TAG_SYS;
+	stats.used += size;
+	stats.sys_cnt++;
+
+	return (uint8_t *)blk + MY_MEM_SYS_HDR;
+}
+
+#endif /*MY_USE_MEM*/
@@ -0,0 +1,90 @@
+/**
+ * @file my_mem.h
+ * Pooled allocator of the port. Plugged into LVGL with MY_USE_MEM in lv_conf.h.
+ * Small blocks come from size-class slabs, large blocks from an arena.
+ * Included from lv_mem.h (LV_MEM_CUSTOM_INCLUDE), so it must not include lvgl.h.
+ */
+
+#ifndef MY_MEM_H
+#define MY_MEM_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stddef.h>
+
+#include "lv_conf.h"
+
+#if MY_USE_MEM
+
+/*********************
+ *      DEFINES
+ *********************/
+/* Number of slab size classes: 32, 64, ... 2048 bytes per block */
+#define MY_MEM_SLAB_CLASS_CNT   7
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t alloc_cnt;         /* Successful allocations */
+	uint32_t free_cnt;          /* Frees */
+	uint32_t fail_cnt;          /* Failed allocations */
+	uint32_t sys_cnt;           /* Large blocks which didn't fit into the arena */
+	size_t used;                /* Bytes handed out to the callers */
+	size_t slab_total;          /* Bytes of all slab pages */
+	size_t slab_used;           /* Bytes of the used slab blocks (with headers) */
+	uint32_t slab_blocks[MY_MEM_SLAB_CLASS_CNT];    /* Used blocks per size class */
+	size_t arena_total;         /* Size of the arena */
+	size_t arena_used;          /* Bytes of the used arena blocks (with headers) */
+	size_t arena_free_biggest;  /* The biggest free arena block */
+	uint8_t slab_waste_pct;     /* Unused part of the used slab blocks */
+	uint8_t arena_frag_pct;     /* 100 - biggest free block / all free arena memory */
+} my_mem_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Map the arena of the large blocks.
+ * Called on the first large allocation, call it before `lv_init()`
+ * to have it ready (and locked if `MY_USE_LOCKED_MEM` is 1) at startup.
+ */
+void my_mem_init(void);
+
+/**
+ * releated to LV_MEM_CUSTOM_ALLOC
+ * @param size size of the memory to allocate in bytes
+ * @return pointer to the allocated memory or NULL
+ */
+void *my_mem_alloc(size_t size);
+
+/**
+ * releated to LV_MEM_CUSTOM_FREE
+ * @param p memory from `my_mem_alloc()`. NULL is ignored.
+ */
+void my_mem_free(void *p);
+
+/**
+ * Get the number of usable bytes of an allocated block.
+ * @param p memory from `my_mem_alloc()` or NULL
+ * @return the usable size in bytes
+ */
+size_t my_mem_get_size(const void *p);
+
+/**
+ * Collect the allocation statistics.
+ * @param stats store the result here
+ */
+void my_mem_get_stats(my_mem_stats_t *stats);
+
+/**
+ * Print the allocation statistics with printf.
+ */
+void my_mem_print_stats(void);
+
+#endif /*MY_USE_MEM*/
+
+#endif /*MY_MEM_H*/
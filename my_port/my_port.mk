@@ -0,0 +1,27 @@
+CSRCS += my_flush.c
+CSRCS += my_mem.c
+CSRCS += my_locked.c
+CSRCS += my_img_cache.c
+CSRCS += my_glyph_cache.c
+CSRCS += my_fs.c
+CSRCS += my_font.c
+CSRCS += my_boot.c
+CSRCS += my_splash.c
+CSRCS += my_drm.c
+CSRCS += my_vsync.c
+CSRCS += my_idle.c
+CSRCS += my_trace.c
+CSRCS += my_vnc.c
+CSRCS += my_capture.c
+CSRCS += my_scroll.c
+CSRCS += my_layer.c
+CSRCS += my_cmd.c
+CSRCS += my_sched.c
+CSRCS += my_budget.c
+CSRCS += my_input.c
+CSRCS += my_shadow.c
+
+DEPPATH += --dep-path $(LVGL_DIR)/my_port
+VPATH += :$(LVGL_DIR)/my_port
+
+CFLAGS += "-I$(LVGL_DIR)/my_port"
@@ -0,0 +1,379 @@
+/**
+ * @file my_sched.c
+ * Real-time scheduling and CPU affinity of the port's threads
+ *
+ * Every thread of the port has a role. The setting of a role is
+ * "policy[:priority[:cpus]]" and comes from my_port_conf.h, the config file
+ * and the environment, in this order. A thread calls `my_sched_apply()` with
+ * its role when it starts; threads inherit the policy of their creator, so
+ * the background threads set SCHED_OTHER explicitly.
+ *
+ * The scheduling latency is how late a thread runs after it should have:
+ * the end of a sleep, a posted job, a vblank. Every thread has a histogram
+ * with power of 2 buckets, written only by the thread itself.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <sys/mman.h>
+
+#include "my_sched.h"
+
+#if MY_USE_SCHED
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	int policy;
+	int prio;
+	bool set_cpus;              /* false: every CPU the process could use at start */
+	cpu_set_t cpus;
+} my_sched_conf_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static int my_sched_read_file(const char *path);
+static int my_sched_set(const char *key, const char *value);
+static int my_sched_parse(const char *str, my_sched_conf_t *conf);
+static int my_sched_parse_cpus(const char *str, cpu_set_t *cpus);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static const char * const role_names[_MY_SCHED_ROLE_CNT] = {
+	"render", "flush", "vblank", "background"
+};
+
+static const char * const role_defaults[_MY_SCHED_ROLE_CNT] = {
+	MY_SCHED_RENDER, MY_SCHED_FLUSH, MY_SCHED_VBLANK, MY_SCHED_BACKGROUND
+};
+
+static my_sched_conf_t confs[_MY_SCHED_ROLE_CNT];
+static cpu_set_t all_cpus;
+static bool mlock_all = MY_SCHED_MLOCK;
+
+static my_sched_thread_stats_t threads[MY_SCHED_MAX_THREADS];
+static uint32_t thread_cnt;
+static __thread my_sched_thread_stats_t *self;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int my_sched_init(void)
+{
+	const char *path = getenv("LV_PORT_SCHED_CONF");
+	const char *env;
+	char env_name[32];
+	char *c;
+	uint32_t i;
+	int res = 0;
+
+	if(sched_getaffinity(0, sizeof(all_cpus), &all_cpus) < 0) {
+		perror("can not get the CPU affinity");
+		return -1;
+	}
+
+	for(i = 0; i < _MY_SCHED_ROLE_CNT; i++) {
+		if(my_sched_parse(role_defaults[i], &confs[i]) < 0) res = -1;
+	}
+
+	if(my_sched_read_file(path ? path : MY_SCHED_CONF_FILE) < 0) res = -1;
+
+	for(i = 0; i < _MY_SCHED_ROLE_CNT; i++) {
+		snprintf(env_name, sizeof(env_name), "LV_PORT_SCHED_%s", role_names[i]);
+		for(c = env_name; *c; c++) *c = toupper((unsigned char)*c);
+
+		env = getenv(env_name);
+		if(env && my_sched_set(role_names[i], env) < 0) res = -1;
+	}
+
+	env = getenv("LV_PORT_MLOCK");
+	if(env && my_sched_set("mlock", env) < 0) res = -1;
+
+	if(res < 0) return -1;
+
+	/* No page faults in the render loop, also for the memory allocated later */
+	if(mlock_all && mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+		perror("can not lock the memory");
+	}
+
+	/* Keep the process name of the main thread */
+	my_sched_apply(MY_SCHED_ROLE_RENDER, NULL);
+
+	return 0;
+}
+
+int my_sched_apply(my_sched_role_t role, const char *name)
+{
+	const my_sched_conf_t *conf = &confs[role];
+	struct sched_param param;
+	uint32_t i;
+	int res = 0;
+	int err;
+
+	if(name) pthread_setname_np(pthread_self(), name);
+	else name = "main";
+
+	param.sched_priority = conf->prio;
+	err = pthread_setschedparam(pthread_self(), conf->policy, &param);
+	if(err) {
+		fprintf(stderr, "%s: can not set the scheduling policy: %s\n", name, strerror(err));
+		res = -1;
+	}
+
+	err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), conf->set_cpus ? &conf->cpus : &all_cpus);
+	if(err) {
+		fprintf(stderr, "%s: can not set the CPU affinity: %s\n", name, strerror(err));
+		res = -1;
+	}
+
+	if(self == NULL) {
+		i = __atomic_fetch_add(&thread_cnt, 1, __ATOMIC_RELAXED);
+		if(i < MY_SCHED_MAX_THREADS) self = &threads[i];
+		else LV_LOG_WARN("my_sched_apply: too many threads, increase MY_SCHED_MAX_THREADS");
+	}
+
+	if(self) {
+		self->name = name;
+		self->role = role;
+	}
+
+	return res;
+}
+
+uint64_t my_sched_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void my_sched_woke(uint64_t due_us)
+{
+	uint64_t now = my_sched_now_us();
+	uint32_t late;
+	uint32_t b;
+
+	if(self == NULL) return;
+
+	late = now > due_us ? (uint32_t)LV_MATH_MIN(now - due_us, UINT32_MAX) : 0;
+	b = late ? 32 - __builtin_clz(late) : 0;
+	if(b >= MY_SCHED_HIST_CNT) b = MY_SCHED_HIST_CNT - 1;
+
+	self->hist[b]++;
+	self->cnt++;
+	self->sum_us += late;
+	if(late > self->max_us) self->max_us = late;
+}
+
+uint32_t my_sched_get_stats(my_sched_thread_stats_t *res, uint32_t max)
+{
+	uint32_t cnt = LV_MATH_MIN(__atomic_load_n(&thread_cnt, __ATOMIC_RELAXED), MY_SCHED_MAX_THREADS);
+	uint32_t i;
+
+	for(i = 0; i < cnt && i < max; i++) res[i] = threads[i];
+
+	return i;
+}
+
+void my_sched_print_stats(void)
+{
+	static my_sched_thread_stats_t stats[MY_SCHED_MAX_THREADS];
+	uint32_t cnt = my_sched_get_stats(stats, MY_SCHED_MAX_THREADS);
+	uint32_t i;
+	uint32_t b;
+
+	for(i = 0; i < cnt; i++) {
+		if(stats[i].cnt == 0) continue;
+
+		printf("sched: %s (%s): %u wakeups, latency avg %u us, max %u us\n ",
+				stats[i].name, role_names[stats[i].role], stats[i].cnt,
+				(uint32_t)(stats[i].sum_us / stats[i].cnt), stats[i].max_us);
+		for(b = 0; b < MY_SCHED_HIST_CNT - 1; b++) {
+			if(stats[i].hist[b]) printf(" <%u us: %u", 1u << b, stats[i].hist[b]);
+		}
+		if(stats[i].hist[b]) printf(" >=%u us: %u", 1u << (b - 1), stats[i].hist[b]);
+		printf("\n");
+	}
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Read the `key = value` lines of a config file. '#' starts a comment.
+ * @param path path of the file, it's not an error if it doesn't exist
+ * @return 0 on success, -1 if a line is invalid
+ */
+static int my_sched_read_file(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char line[128];
+	char *key;
+	char *value;
+	char *end;
+	int res = 0;
+
+	if(f == NULL) {
+		if(errno != ENOENT) perror(path);
+		return 0;
+	}
+
+	while(fgets(line, sizeof(line), f)) {
+		end = strchr(line, '#');
+		if(end) *end = '\0';
+
+		/* Trim both sides of the key and the value */
+		for(key = line; isspace((unsigned char)*key); key++);
+		if(*key == '\0') continue;
+
+		value = strchr(key, '=');
+		if(value == NULL) {
+			fprintf(stderr, "%s: invalid line: %s\n", path, key);
+			res = -1;
+			continue;
+		}
+		for(end = value; end > key && isspace((unsigned char)end[-1]); end--);
+		*end = '\0';
+		for(value++; isspace((unsigned char)*value); value++);
+		for(end = value + strlen(value); end > value && isspace((unsigned char)end[-1]); end--);
+		*end = '\0';
+
+		if(my_sched_set(key, value) < 0) res = -1;
+	}
+
+	fclose(f);
+
+	return res;
+}
+
+/**
+ * Change a setting.
+ * @param key name of a role or "mlock"
+ * @param value the setting
+ * @return 0 on success, -1 if the key or the value is invalid
+ */
+static int my_sched_set(const char *key, const char *value)
+{
+	uint32_t i;
+
+	if(strcmp(key, "mlock") == 0) {
+		mlock_all = atoi(value) != 0;
+		return 0;
+	}
+
+	for(i = 0; i < _MY_SCHED_ROLE_CNT; i++) {
+		if(strcmp(key, role_names[i]) == 0) return my_sched_parse(value, &confs[i]);
+	}
+
+	fprintf(stderr, "sched: unknown setting: %s\n", key);
+	return -1;
+}
+
+/**
+ * Parse "policy[:priority[:cpus]]", e.g. "fifo:50:2-3".
+ * @param str the setting
+ * @param conf store the result here
+ * @return 0 on success, -1 if it's invalid
+ */
+static int my_sched_parse(const char *str, my_sched_conf_t *conf)
+{
+	const char *p = str;
+	size_t len = strcspn(p, ":");
+	char *end;
+	long prio = 0;
+
+	if(len == 0 || strncmp(p, "other", len) == 0) conf->policy = SCHED_OTHER;
+	else if(strncmp(p, "fifo", len) == 0) conf->policy = SCHED_FIFO;
+	else if(strncmp(p, "rr", len) == 0) conf->policy = SCHED_RR;
+	else goto invalid;
+	p += len;
+
+	if(*p == ':') {
+		p++;
+		len = strcspn(p, ":");
+		if(len) {
+			prio = strtol(p, &end, 10);
+			if(end != p + len) goto invalid;
+		}
+		p += len;
+	}
+
+	/* SCHED_OTHER has only 0, the real-time policies 1..99 */
+	if(conf->policy == SCHED_OTHER) prio = 0;
+	else if(prio == 0) prio = 1;
+	if(prio < sched_get_priority_min(conf->policy) || prio > sched_get_priority_max(conf->policy)) goto invalid;
+	conf->prio = prio;
+
+	conf->set_cpus = false;
+	if(*p == ':') {
+		p++;
+		if(*p) {
+			if(my_sched_parse_cpus(p, &conf->cpus) < 0) goto invalid;
+			conf->set_cpus = true;
+		}
+	}
+
+	return 0;
+
+invalid:
+	fprintf(stderr, "sched: invalid setting \"%s\", use policy[:priority[:cpus]], e.g. fifo:50:2-3\n", str);
+	return -1;
+}
+
+/**
+ * Parse a CPU list, e.g. "0,2-3".
+ * @param str the list
+ * @param cpus store the result here
+ * @return 0 on success, -1 if it's invalid or empty
+ */
+static int my_sched_parse_cpus(const char *str, cpu_set_t *cpus)
+{
+	const char *p = str;
+	char *end;
+	long first;
+	long last;
+
+	CPU_ZERO(cpus);
+
+	while(1) {
+		first = strtol(p, &end, 10);
+		if(end == p || first < 0) return -1;
+		last = first;
+		p = end;
+
+		if(*p == '-') {
+			p++;
+			last = strtol(p, &end, 10);
+			if(end == p || last < first) return -1;
+			p = end;
+		}
+
+		if(last >= CPU_SETSIZE) return -1;
+		for(; first <= last; first++) CPU_SET(first, cpus);
+
+		if(*p == '\0') break;
+		if(*p != ',') return -1;
+		p++;
+	}
+
+	return CPU_COUNT(cpus) ? 0 : -1;
+}
+
+#endif /*MY_USE_SCHED*/
@@ -0,0 +1,109 @@
+/**
+ * @file my_sched.h
+ * Real-time scheduling and CPU affinity of the port's threads
+ */
+
+#ifndef MY_SCHED_H
+#define MY_SCHED_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_SCHED
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_SCHED_HIST_CNT   16
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+enum {
+	MY_SCHED_ROLE_RENDER,       /* The main loop: input, LVGL tasks, rendering */
+	MY_SCHED_ROLE_FLUSH,        /* Flush workers */
+	MY_SCHED_ROLE_VBLANK,       /* The thread waiting for the vblanks */
+	MY_SCHED_ROLE_BACKGROUND,   /* Image decoders, capture, VNC */
+	_MY_SCHED_ROLE_CNT,
+};
+typedef uint8_t my_sched_role_t;
+
+typedef struct {
+	const char *name;
+	my_sched_role_t role;
+	uint32_t cnt;               /* Wakeups */
+	uint32_t max_us;
+	uint64_t sum_us;
+	uint32_t hist[MY_SCHED_HIST_CNT];   /* [i]: latency < 2^i us, the last one: the rest */
+} my_sched_thread_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Read the settings, lock the memory if enabled and set the calling (main) thread
+ * to MY_SCHED_ROLE_RENDER. Call it before any thread is created.
+ * The settings are read from MY_SCHED_CONF_FILE (`LV_PORT_SCHED_CONF` overrides the path),
+ * then from the environment, e.g. `LV_PORT_SCHED_RENDER=fifo:50:2 LV_PORT_MLOCK=1 ./demo`.
+ * @return 0 on success, -1 if the settings are invalid
+ */
+int my_sched_init(void);
+
+/**
+ * Set the policy, priority and CPUs of the calling thread.
+ * Threads inherit them from their creator, so every thread of the port calls it when it starts.
+ * @param role the settings to use
+ * @param name the name of the thread, shown in the statistics and by `top -H`;
+ *             NULL: keep the name (used for the main thread)
+ * @return 0 on success, -1 on error (e.g. no permission for a real-time policy)
+ */
+int my_sched_apply(my_sched_role_t role, const char *name);
+
+/**
+ * Get the time to pass to `my_sched_woke()`.
+ * @return CLOCK_MONOTONIC in us
+ */
+uint64_t my_sched_now_us(void);
+
+/**
+ * Add the scheduling latency of a wakeup to the calling thread's histogram.
+ * @param due_us when the thread should have run (`my_sched_now_us()` based),
+ *               e.g. the end of a sleep or the time a job was posted
+ */
+void my_sched_woke(uint64_t due_us);
+
+/**
+ * Get the latency statistics of the threads.
+ * @param res store the result here
+ * @param max size of `res`
+ * @return number of threads stored
+ */
+uint32_t my_sched_get_stats(my_sched_thread_stats_t *res, uint32_t max);
+
+/**
+ * Print the latency histograms with printf.
+ */
+void my_sched_print_stats(void);
+
+#else
+
+/* The latency hooks of the main loop do nothing */
+static inline uint64_t my_sched_now_us(void)
+{
+	return 0;
+}
+
+static inline void my_sched_woke(uint64_t due_us)
+{
+	(void)due_us;
+}
+
+#endif /*MY_USE_SCHED*/
+
+#endif /*MY_SCHED_H*/
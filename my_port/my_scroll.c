@@ -0,0 +1,551 @@
+/**
+ * @file my_scroll.c
+ * Scroll pages by moving the pixels already in the framebuffer
+ *
+ * When the scrollable part of a page moves, LVGL invalidates it at the old
+ * and at the new position and renders the whole page again. Here these two
+ * invalidations are taken back: the first one from the list of invalid areas
+ * when the move is signalled, the second one in the rounder, which shrinks
+ * it to a pixel. Before the next refresh the pixels of the page are moved in
+ * the framebuffer by the distance of the scroll and only the uncovered parts
+ * are invalidated.
+ *
+ * It works only if everything inside the page moves with the scrollable:
+ * the background behind it has to be plain and nothing may be over it.
+ * Otherwise the taken back areas are invalidated and the page is rendered as usual.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <string.h>
+
+#include "my_scroll.h"
+#include "my_flush.h"
+#include "my_splash.h"
+
+#if MY_USE_SCROLL_BLIT
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	lv_obj_t *page;
+	lv_obj_t *scrl;
+	lv_signal_cb_t signal_cb;       /* The original signal function of `scrl` */
+} my_scroll_page_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static lv_res_t my_scroll_signal(lv_obj_t *scrl, lv_signal_t sign, void *param);
+static void my_scroll_moved(my_scroll_page_t *p, const lv_area_t *ori);
+static void my_scroll_rounder(lv_disp_drv_t *drv, lv_area_t *area);
+static void my_scroll_refr_task(lv_task_t *task);
+#if MY_SCROLL_BLIT_SCAN_PERIOD
+static void my_scroll_scan_task(lv_task_t *task);
+#endif
+static void my_scroll_blit(void);
+static void my_scroll_fall_back(void);
+static bool my_scroll_can_blit(my_scroll_page_t *p);
+static bool my_scroll_get_blit_area(lv_obj_t *page, lv_area_t *area);
+static bool my_scroll_get_inv_area(lv_obj_t *obj, const lv_area_t *coords, lv_area_t *area);
+static bool my_scroll_bg_is_plain(lv_obj_t *page);
+static bool my_scroll_is_covered(lv_obj_t *page, const lv_area_t *area);
+static bool my_scroll_covers(lv_obj_t *obj, const lv_area_t *area);
+static bool my_scroll_is_page(lv_obj_t *obj);
+static my_scroll_page_t *my_scroll_find(const lv_obj_t *scrl);
+static bool my_scroll_area_eq(const lv_area_t *a, const lv_area_t *b);
+static void my_scroll_join(lv_area_t *res, const lv_area_t *area);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static my_scroll_page_t pages[MY_SCROLL_BLIT_MAX_PAGES];
+static lv_disp_t *scroll_disp;
+static unsigned char *scroll_fb;
+static uint32_t scroll_line_width;
+
+/* The last area seen by the rounder and the number of invalid areas before it */
+static lv_area_t last_inv;
+static uint32_t last_inv_p;
+
+/* The page scrolled since the last refresh */
+static my_scroll_page_t *scrolled;
+static lv_area_t blit_area;         /* The part of the page moving with the scrollable */
+static lv_area_t taken_area;        /* Covers the taken back invalidations */
+static bool taken;
+static lv_coord_t ofs_x;
+static lv_coord_t ofs_y;
+static bool fallback;
+
+/* Shrink this area in the rounder */
+static lv_area_t take_area;
+static bool take_next;
+
+static my_scroll_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int my_scroll_init(lv_disp_t *disp, unsigned char *fb_base, uint32_t line_width)
+{
+#if MY_USE_VNC || MY_USE_CAPTURE
+	/* They copy only the flushed areas, the moved pixels would be missing */
+	LV_LOG_WARN("my_scroll_init: not used with MY_USE_VNC and MY_USE_CAPTURE");
+	return -1;
+#endif
+
+	if(disp->driver.rounder_cb) {
+		LV_LOG_WARN("my_scroll_init: the display already has a rounder");
+		return -1;
+	}
+
+	scroll_disp = disp;
+	scroll_fb = fb_base;
+	scroll_line_width = line_width;
+	disp->driver.rounder_cb = my_scroll_rounder;
+
+	/* Move the pixels right before the refreshes of lv_task_handler() */
+	lv_task_set_cb(_lv_disp_get_refr_task(disp), my_scroll_refr_task);
+
+#if MY_SCROLL_BLIT_SCAN_PERIOD
+	lv_task_create(my_scroll_scan_task, MY_SCROLL_BLIT_SCAN_PERIOD, LV_TASK_PRIO_LOWEST, NULL);
+#endif
+
+	return 0;
+}
+
+void my_scroll_attach(lv_obj_t *page)
+{
+	my_scroll_page_t *p = NULL;
+	lv_obj_t *scrl;
+	uint32_t i;
+
+	if(scroll_disp == NULL) return;
+
+	scrl = lv_page_get_scrollable(page);
+	for(i = 0; i < MY_SCROLL_BLIT_MAX_PAGES; i++) {
+		if(pages[i].scrl == scrl) return;
+		if(pages[i].scrl == NULL && p == NULL) p = &pages[i];
+	}
+
+	if(p == NULL) {
+		LV_LOG_WARN("my_scroll_attach: too many pages, increase MY_SCROLL_BLIT_MAX_PAGES");
+		return;
+	}
+
+	p->page = page;
+	p->scrl = scrl;
+	p->signal_cb = lv_obj_get_signal_cb(scrl);
+	lv_obj_set_signal_cb(scrl, my_scroll_signal);
+}
+
+void my_scroll_attach_all(lv_obj_t *parent)
+{
+	lv_obj_t *child;
+
+	for(child = lv_obj_get_child(parent, NULL); child; child = lv_obj_get_child(parent, child)) {
+		if(my_scroll_is_page(child)) my_scroll_attach(child);
+		my_scroll_attach_all(child);
+	}
+}
+
+void my_scroll_apply(void)
+{
+	if(scrolled == NULL) return;
+
+	take_next = false;
+	if(fallback == false) {
+		if(my_scroll_can_blit(scrolled)) my_scroll_blit();
+		else my_scroll_fall_back();
+	}
+
+	scrolled = NULL;
+}
+
+void my_scroll_get_stats(my_scroll_stats_t *res)
+{
+	*res = stats;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static lv_res_t my_scroll_signal(lv_obj_t *scrl, lv_signal_t sign, void *param)
+{
+	my_scroll_page_t *p = my_scroll_find(scrl);
+	lv_res_t res;
+
+	if(p == NULL) return LV_RES_INV;
+
+	/* Before the page invalidates its scrollbars */
+	if(sign == LV_SIGNAL_COORD_CHG) my_scroll_moved(p, param);
+
+	res = p->signal_cb(scrl, sign, param);
+
+	if(sign == LV_SIGNAL_CLEANUP) {
+		if(scrolled == p) {
+			if(fallback == false) my_scroll_fall_back();
+			scrolled = NULL;
+		}
+		p->page = NULL;
+		p->scrl = NULL;
+	}
+
+	return res;
+}
+
+/**
+ * Take back the invalidations of a scroll, or fall back to rendering the page.
+ * Called when the scrollable has got its new coordinates. `lv_obj_set_pos()` has
+ * invalidated the old position right before and invalidates the new one after.
+ * @param p the scrolled page
+ * @param ori the old coordinates of the scrollable
+ */
+static void my_scroll_moved(my_scroll_page_t *p, const lv_area_t *ori)
+{
+	lv_area_t coords;
+	lv_area_t old_inv;
+	lv_area_t new_inv;
+	uint32_t inv_p = scroll_disp->inv_p;
+
+	if(scrolled == NULL) {
+		scrolled = p;
+		taken = false;
+		ofs_x = 0;
+		ofs_y = 0;
+		fallback = false;
+		if(my_scroll_get_blit_area(p->page, &blit_area) == false) {
+			my_scroll_fall_back();
+			return;
+		}
+	}
+	else if(scrolled != p) {
+		/* Only one page per frame */
+		if(fallback == false) my_scroll_fall_back();
+		return;
+	}
+
+	if(fallback) return;
+
+	lv_obj_get_coords(p->scrl, &coords);
+	if(lv_area_get_width(&coords) != lv_area_get_width(ori) ||
+		lv_area_get_height(&coords) != lv_area_get_height(ori)) {
+		my_scroll_fall_back();
+		return;
+	}
+
+	/* The whole moving part has to be invalidated at both positions */
+	if(my_scroll_get_inv_area(p->scrl, ori, &old_inv) == false ||
+		my_scroll_get_inv_area(p->scrl, &coords, &new_inv) == false ||
+		_lv_area_is_in(&blit_area, &old_inv, 0) == false ||
+		_lv_area_is_in(&blit_area, &new_inv, 0) == false) {
+		my_scroll_fall_back();
+		return;
+	}
+
+	/* If the old position wasn't saved, a larger invalid area covers the page anyway */
+	if(inv_p != last_inv_p + 1 || my_scroll_area_eq(&last_inv, &old_inv) == false ||
+		my_scroll_area_eq(&scroll_disp->inv_areas[inv_p - 1], &old_inv) == false) {
+		my_scroll_fall_back();
+		return;
+	}
+
+	scroll_disp->inv_p--;
+	my_scroll_join(&taken_area, &old_inv);
+	my_scroll_join(&taken_area, &new_inv);
+	ofs_x += coords.x1 - ori->x1;
+	ofs_y += coords.y1 - ori->y1;
+
+	take_area = new_inv;
+	take_next = true;
+}
+
+static void my_scroll_rounder(lv_disp_drv_t *drv, lv_area_t *area)
+{
+	if(take_next && my_scroll_area_eq(area, &take_area)) {
+		/* Only a pixel of the new position is saved, so the invalidations
+		 * in the page until the refresh aren't dropped as covered by it */
+		area->x2 = area->x1;
+		area->y2 = area->y1;
+		take_next = false;
+	}
+
+	last_inv = *area;
+	last_inv_p = scroll_disp->inv_p;
+}
+
+static void my_scroll_refr_task(lv_task_t *task)
+{
+	my_scroll_apply();
+	_lv_disp_refr_task(task);
+}
+
+#if MY_SCROLL_BLIT_SCAN_PERIOD
+static void my_scroll_scan_task(lv_task_t *task)
+{
+	my_scroll_attach_all(lv_scr_act());
+}
+#endif
+
+/**
+ * Move the pixels of the scrolled page in the framebuffer and invalidate
+ * what the move doesn't cover.
+ */
+static void my_scroll_blit(void)
+{
+	lv_disp_drv_t *drv = &scroll_disp->driver;
+	lv_area_t valid;
+	lv_area_t a;
+	uint32_t inv_cnt = scroll_disp->inv_p;
+	uint32_t len;
+	uint32_t i;
+	int32_t y;
+
+	/* The part of the page which is still on the screen after the move */
+	valid.x1 = blit_area.x1 + LV_MATH_MAX(ofs_x, 0);
+	valid.y1 = blit_area.y1 + LV_MATH_MAX(ofs_y, 0);
+	valid.x2 = blit_area.x2 + LV_MATH_MIN(ofs_x, 0);
+	valid.y2 = blit_area.y2 + LV_MATH_MIN(ofs_y, 0);
+	len = lv_area_get_width(&valid) * sizeof(lv_color_t);
+
+	/* The last area of the previous frame might be still being copied */
+	while(drv->buffer->flushing) {
+		if(drv->wait_cb) drv->wait_cb(drv);
+	}
+
+	/* The source and the destination overlap, copy away from the direction of the move */
+	if(ofs_y > 0) {
+		for(y = valid.y2; y >= valid.y1; y--) {
+			memmove(scroll_fb + y * scroll_line_width + valid.x1 * sizeof(lv_color_t),
+					scroll_fb + (y - ofs_y) * scroll_line_width + (valid.x1 - ofs_x) * sizeof(lv_color_t), len);
+		}
+	}
+	else if(ofs_y < 0 || ofs_x != 0) {
+		for(y = valid.y1; y <= valid.y2; y++) {
+			memmove(scroll_fb + y * scroll_line_width + valid.x1 * sizeof(lv_color_t),
+					scroll_fb + (y - ofs_y) * scroll_line_width + (valid.x1 - ofs_x) * sizeof(lv_color_t), len);
+		}
+	}
+
+	/* The not yet rendered areas were moved too */
+	for(i = 0; i < inv_cnt; i++) {
+		a = scroll_disp->inv_areas[i];
+		a.x1 += ofs_x;
+		a.y1 += ofs_y;
+		a.x2 += ofs_x;
+		a.y2 += ofs_y;
+		if(_lv_area_intersect(&a, &a, &valid)) _lv_inv_area(scroll_disp, &a);
+	}
+
+	/* The uncovered parts: up to 4 bands of the taken back area around `valid` */
+	a = taken_area;
+	a.y2 = valid.y1 - 1;
+	if(a.y1 <= a.y2) _lv_inv_area(scroll_disp, &a);
+	a = taken_area;
+	a.y1 = valid.y2 + 1;
+	if(a.y1 <= a.y2) _lv_inv_area(scroll_disp, &a);
+	a.y1 = valid.y1;
+	a.y2 = valid.y2;
+	a.x2 = valid.x1 - 1;
+	if(a.x1 <= a.x2) _lv_inv_area(scroll_disp, &a);
+	a.x1 = valid.x2 + 1;
+	a.x2 = taken_area.x2;
+	if(a.x1 <= a.x2) _lv_inv_area(scroll_disp, &a);
+
+#if MY_USE_TILE_HASH
+	/* The framebuffer has changed under the hashes */
+	my_flush_tile_hash_forget(&valid);
+#endif
+
+	stats.blit_cnt++;
+	stats.px_cnt += lv_area_get_size(&valid);
+}
+
+/**
+ * Give back the taken invalidations, the page is rendered as usual.
+ */
+static void my_scroll_fall_back(void)
+{
+	fallback = true;
+	take_next = false;
+	if(taken) _lv_inv_area(scroll_disp, &taken_area);
+	stats.fallback_cnt++;
+}
+
+static bool my_scroll_can_blit(my_scroll_page_t *p)
+{
+	lv_area_t area;
+
+	/* The page hasn't moved or changed its size */
+	if(my_scroll_get_blit_area(p->page, &area) == false) return false;
+	if(my_scroll_area_eq(&area, &blit_area) == false) return false;
+
+	if(LV_MATH_ABS(ofs_x) >= lv_area_get_width(&area)) return false;
+	if(LV_MATH_ABS(ofs_y) >= lv_area_get_height(&area)) return false;
+
+#if MY_FB_KEEP_SPLASH && MY_SPLASH_FADE_TIME
+	/* The framebuffer has the splash, not the page */
+	if(my_splash_covers()) return false;
+#endif
+
+	/* Both screens are drawn during a screen load animation */
+	if(lv_disp_get_scr_prev(scroll_disp) != NULL) return false;
+	if(lv_obj_get_screen(p->page) != lv_disp_get_scr_act(scroll_disp)) return false;
+
+	if(my_scroll_bg_is_plain(p->page) == false) return false;
+	if(my_scroll_is_covered(p->page, &area)) return false;
+
+	return true;
+}
+
+/**
+ * Get the part of a page which moves with its scrollable.
+ * The border and the rounded corners stay.
+ * @param page the page
+ * @param area store the area here
+ * @return false if nothing moves
+ */
+static bool my_scroll_get_blit_area(lv_obj_t *page, lv_area_t *area)
+{
+	lv_coord_t border = lv_obj_get_style_border_width(page, LV_OBJ_PART_MAIN);
+	lv_coord_t radius = lv_obj_get_style_radius(page, LV_OBJ_PART_MAIN);
+
+	lv_obj_get_coords(page, area);
+	area->x1 += border;
+	area->x2 -= border;
+	area->y1 += LV_MATH_MAX(border, radius);
+	area->y2 -= LV_MATH_MAX(border, radius);
+
+	return area->x1 <= area->x2 && area->y1 <= area->y2;
+}
+
+/**
+ * Get the area `lv_obj_invalidate()` invalidates for an object at the given coordinates.
+ * @param obj the object
+ * @param coords the coordinates of the object
+ * @param area store the area here
+ * @return false if nothing is invalidated
+ */
+static bool my_scroll_get_inv_area(lv_obj_t *obj, const lv_area_t *coords, lv_area_t *area)
+{
+	lv_coord_t ext = lv_obj_get_ext_draw_pad(obj);
+
+	area->x1 = coords->x1 - ext;
+	area->y1 = coords->y1 - ext;
+	area->x2 = coords->x2 + ext;
+	area->y2 = coords->y2 + ext;
+
+	return lv_obj_area_is_visible(obj, area);
+}
+
+/**
+ * Check whether the background behind a page is a single color.
+ * @param page the page
+ * @return true if moving the background doesn't change it
+ */
+static bool my_scroll_bg_is_plain(lv_obj_t *page)
+{
+	lv_obj_t *obj;
+	lv_opa_t opa;
+
+	for(obj = page; obj; obj = lv_obj_get_parent(obj)) {
+		opa = lv_obj_get_style_bg_opa(obj, LV_OBJ_PART_MAIN);
+		if(opa <= LV_OPA_MIN) continue;
+
+		if(lv_obj_get_style_bg_grad_dir(obj, LV_OBJ_PART_MAIN) != LV_GRAD_DIR_NONE) return false;
+		if(lv_obj_get_style_pattern_image(obj, LV_OBJ_PART_MAIN) != NULL) return false;
+
+		return opa >= LV_OPA_MAX;
+	}
+
+	/* The display's background */
+	return true;
+}
+
+/**
+ * Check whether an object is drawn over an area of a page.
+ * @param page the page
+ * @param area the area in the page
+ * @return true if an other object is over `area`
+ */
+static bool my_scroll_is_covered(lv_obj_t *page, const lv_area_t *area)
+{
+	lv_obj_t *obj = page;
+	lv_obj_t *par;
+	lv_obj_t *child;
+
+	/* The younger siblings are drawn later, they are first in the list of children */
+	for(par = lv_obj_get_parent(obj); par; obj = par, par = lv_obj_get_parent(par)) {
+		for(child = lv_obj_get_child(par, NULL); child != obj; child = lv_obj_get_child(par, child)) {
+			if(my_scroll_covers(child, area)) return true;
+		}
+	}
+
+	for(child = lv_obj_get_child(lv_layer_top(), NULL); child; child = lv_obj_get_child(lv_layer_top(), child)) {
+		if(my_scroll_covers(child, area)) return true;
+	}
+
+	for(child = lv_obj_get_child(lv_layer_sys(), NULL); child; child = lv_obj_get_child(lv_layer_sys(), child)) {
+		if(my_scroll_covers(child, area)) return true;
+	}
+
+	return false;
+}
+
+static bool my_scroll_covers(lv_obj_t *obj, const lv_area_t *area)
+{
+	lv_area_t coords;
+
+	if(lv_obj_get_hidden(obj)) return false;
+
+	lv_obj_get_coords(obj, &coords);
+	if(my_scroll_get_inv_area(obj, &coords, &coords) == false) return false;
+
+	return _lv_area_intersect(&coords, &coords, area);
+}
+
+static bool my_scroll_is_page(lv_obj_t *obj)
+{
+	lv_obj_type_t types;
+	uint32_t i;
+
+	lv_obj_get_type(obj, &types);
+	for(i = 0; i < LV_MAX_ANCESTOR_NUM && types.type[i]; i++) {
+		if(strcmp(types.type[i], "lv_page") == 0) return true;
+	}
+
+	return false;
+}
+
+static my_scroll_page_t *my_scroll_find(const lv_obj_t *scrl)
+{
+	uint32_t i;
+
+	for(i = 0; i < MY_SCROLL_BLIT_MAX_PAGES; i++) {
+		if(pages[i].scrl == scrl) return &pages[i];
+	}
+
+	return NULL;
+}
+
+static bool my_scroll_area_eq(const lv_area_t *a, const lv_area_t *b)
+{
+	return a->x1 == b->x1 && a->y1 == b->y1 && a->x2 == b->x2 && a->y2 == b->y2;
+}
+
+static void my_scroll_join(lv_area_t *res, const lv_area_t *area)
+{
+	if(taken == false) {
+		*res = *area;
+		taken = true;
+		return;
+	}
+
+	_lv_area_join(res, res, area);
+}
+
+#endif /*MY_USE_SCROLL_BLIT*/
@@ -0,0 +1,67 @@
+/**
+ * @file my_scroll.h
+ * Scroll pages by moving the pixels already in the framebuffer
+ */
+
+#ifndef MY_SCROLL_H
+#define MY_SCROLL_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_SCROLL_BLIT
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t blit_cnt;          /* Frames scrolled by moving pixels */
+	uint32_t fallback_cnt;      /* Scrolled frames rendered as usual */
+	uint64_t px_cnt;            /* Moved pixels, they were not rendered */
+} my_scroll_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Start to follow the invalidations of a display.
+ * @param disp the display, it's flushed to `fb_base`
+ * @param fb_base start address of the framebuffer
+ * @param line_width length of one framebuffer line in bytes
+ * @return 0 on success, -1 if the moved pixels couldn't be followed
+ */
+int my_scroll_init(lv_disp_t *disp, unsigned char *fb_base, uint32_t line_width);
+
+/**
+ * Scroll a page by moving pixels from now on.
+ * @param page a page or an object based on it (list, table, ...)
+ */
+void my_scroll_attach(lv_obj_t *page);
+
+/**
+ * Attach every page among the children of an object.
+ * @param parent the object to search in, e.g. a screen
+ */
+void my_scroll_attach_all(lv_obj_t *parent);
+
+/**
+ * Move the pixels of the page scrolled since the last refresh and
+ * invalidate the uncovered parts. Called before every refresh.
+ */
+void my_scroll_apply(void);
+
+/**
+ * Get the scroll statistics.
+ * @param stats store the result here
+ */
+void my_scroll_get_stats(my_scroll_stats_t *stats);
+
+#endif /*MY_USE_SCROLL_BLIT*/
+
+#endif /*MY_SCROLL_H*/
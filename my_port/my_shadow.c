@@ -0,0 +1,89 @@
+/**
+ * @file my_shadow.c
+ * Copy of the screen in RAM, shared by the VNC server and the capture
+ *
+ * The flushed areas are copied here once per flush, however many users
+ * there are. The users keep only their own damage (changed areas or tiles)
+ * and copy the damaged pixels out of it.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "my_shadow.h"
+
+#if MY_USE_SHADOW
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_coord_t scr_w;
+static lv_coord_t scr_h;
+static lv_color_t *shadow;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int my_shadow_init(lv_coord_t hor_res, lv_coord_t ver_res)
+{
+	if(shadow) return 0;
+
+	/* Not from the LVGL heap, the users' threads read it */
+	shadow = calloc(hor_res * ver_res, sizeof(lv_color_t));
+	if(shadow == NULL) {
+		perror("can not allocate the copy of the screen");
+		return -1;
+	}
+
+	scr_w = hor_res;
+	scr_h = ver_res;
+
+	return 0;
+}
+
+void my_shadow_flush(const lv_area_t *area, const lv_color_t *color_p)
+{
+	lv_area_t a;
+	int32_t w = lv_area_get_width(area);
+	int32_t y;
+
+	if(shadow == NULL) return;
+
+	/* Only the visible part */
+	a.x1 = 0;
+	a.y1 = 0;
+	a.x2 = scr_w - 1;
+	a.y2 = scr_h - 1;
+	if(_lv_area_intersect(&a, &a, area) == false) return;
+
+	pthread_mutex_lock(&lock);
+	for(y = a.y1; y <= a.y2; y++) {
+		memcpy(&shadow[y * scr_w + a.x1], &color_p[(y - area->y1) * w + (a.x1 - area->x1)],
+				lv_area_get_width(&a) * sizeof(lv_color_t));
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+const lv_color_t *my_shadow_get(void)
+{
+	return shadow;
+}
+
+void my_shadow_lock(void)
+{
+	pthread_mutex_lock(&lock);
+}
+
+void my_shadow_unlock(void)
+{
+	pthread_mutex_unlock(&lock);
+}
+
+#endif /*MY_USE_SHADOW*/
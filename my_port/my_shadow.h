@@ -0,0 +1,63 @@
+/**
+ * @file my_shadow.h
+ * Copy of the screen in RAM, shared by the VNC server and the capture
+ */
+
+#ifndef MY_SHADOW_H
+#define MY_SHADOW_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+/*********************
+ *      DEFINES
+ *********************/
+/* The users of the copy */
+#define MY_USE_SHADOW   (MY_USE_VNC || MY_USE_CAPTURE)
+
+#if MY_USE_SHADOW
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Allocate the copy of the screen. Every user calls it, only the first call allocates.
+ * @param hor_res horizontal resolution of the screen
+ * @param ver_res vertical resolution of the screen
+ * @return 0 on success, -1 on error
+ */
+int my_shadow_init(lv_coord_t hor_res, lv_coord_t ver_res);
+
+/**
+ * Copy the visible part of a flushed area to the copy of the screen.
+ * Call it before the flush callbacks of the users.
+ * @param area the flushed area
+ * @param color_p the rendered pixels of `area`
+ */
+void my_shadow_flush(const lv_area_t *area, const lv_color_t *color_p);
+
+/**
+ * Get the copy of the screen. Only the UI thread writes it (in `my_shadow_flush()`),
+ * so the UI thread can read it any time, other threads only between
+ * `my_shadow_lock()` and `my_shadow_unlock()`.
+ * @return the pixels, `hor_res` pixels per line
+ */
+const lv_color_t *my_shadow_get(void);
+
+/**
+ * Keep the UI thread from writing the copy of the screen.
+ */
+void my_shadow_lock(void);
+
+/**
+ * Let the UI thread write the copy of the screen again.
+ */
+void my_shadow_unlock(void);
+
+#endif /*MY_USE_SHADOW*/
+
+#endif /*MY_SHADOW_H*/
@@ -0,0 +1,104 @@
+/**
+ * @file my_splash.c
+ * Hand over the splash image of the bootloader to LVGL
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "my_splash.h"
+
+#if MY_FB_KEEP_SPLASH && MY_SPLASH_FADE_TIME
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void my_splash_fade_cb(void *img, lv_anim_value_t v);
+static void my_splash_ready_cb(lv_anim_t *a);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_img_dsc_t splash_dsc;
+static bool covers;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_splash_init(const unsigned char *fb_base, uint32_t w, uint32_t h, uint32_t line_width)
+{
+	uint32_t img_line = w * sizeof(lv_color_t);
+	uint8_t *data;
+	lv_obj_t *img;
+	lv_anim_t a;
+	uint32_t y;
+
+	/* Not from the LVGL heap, a full screen doesn't fit in the built-in one */
+	data = malloc(img_line * h);
+	if(data == NULL) {
+		LV_LOG_WARN("my_splash_init: not enough memory for the splash");
+		return;
+	}
+
+	/* The framebuffer has the same pixel format as lv_color_t (see my_disp_flush) */
+	for(y = 0; y < h; y++) {
+		memcpy(data + y * img_line, fb_base + y * line_width, img_line);
+	}
+
+	splash_dsc.header.always_zero = 0;
+	splash_dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+	splash_dsc.header.w = w;
+	splash_dsc.header.h = h;
+	splash_dsc.data_size = img_line * h;
+	splash_dsc.data = data;
+
+	/* Above every screen */
+	img = lv_img_create(lv_layer_top(), NULL);
+	lv_img_set_src(img, &splash_dsc);
+	lv_obj_set_pos(img, 0, 0);
+	covers = true;
+
+	lv_anim_init(&a);
+	lv_anim_set_var(&a, img);
+	lv_anim_set_exec_cb(&a, my_splash_fade_cb);
+	lv_anim_set_values(&a, LV_OPA_COVER, LV_OPA_TRANSP);
+	lv_anim_set_time(&a, MY_SPLASH_FADE_TIME);
+	lv_anim_set_delay(&a, MY_SPLASH_FADE_DELAY);
+	lv_anim_set_ready_cb(&a, my_splash_ready_cb);
+	lv_anim_start(&a);
+}
+
+bool my_splash_covers(void)
+{
+	return covers;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static void my_splash_fade_cb(void *img, lv_anim_value_t v)
+{
+	if(v < LV_OPA_COVER) covers = false;
+
+	lv_obj_set_style_local_image_opa(img, LV_IMG_PART_MAIN, LV_STATE_DEFAULT, v);
+}
+
+/**
+ * Delete the faded out splash and free its pixels.
+ */
+static void my_splash_ready_cb(lv_anim_t *a)
+{
+	covers = false;
+
+	lv_obj_del(a->var);
+	lv_img_cache_invalidate_src(&splash_dsc);
+	free((void *)splash_dsc.data);
+	splash_dsc.data = NULL;
+}
+
+#endif /*MY_FB_KEEP_SPLASH && MY_SPLASH_FADE_TIME*/
@@ -0,0 +1,43 @@
+/**
+ * @file my_splash.h
+ * Hand over the splash image of the bootloader to LVGL
+ */
+
+#ifndef MY_SPLASH_H
+#define MY_SPLASH_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_FB_KEEP_SPLASH && MY_SPLASH_FADE_TIME
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Copy the content of the framebuffer to an image on the top layer
+ * and fade it out after `MY_SPLASH_FADE_DELAY` ms.
+ * @param fb_base start address of the framebuffer
+ * @param w horizontal resolution
+ * @param h vertical resolution
+ * @param line_width length of one framebuffer line in bytes
+ */
+void my_splash_init(const unsigned char *fb_base, uint32_t w, uint32_t h, uint32_t line_width);
+
+/**
+ * Check if the splash still covers the screen with full opacity.
+ * Until then the rendered frames are the splash itself, no need to flush them.
+ * @return true: the framebuffer already shows every rendered pixel
+ */
+bool my_splash_covers(void);
+
+#endif /*MY_FB_KEEP_SPLASH && MY_SPLASH_FADE_TIME*/
+
+#endif /*MY_SPLASH_H*/
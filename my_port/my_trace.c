@@ -0,0 +1,300 @@
+/**
+ * @file my_trace.c
+ * Frame timing trace with Chrome trace export
+ *
+ * Every thread writes its events into its own ring buffer, so adding an
+ * event is a few stores without locks. The export reads the rings while
+ * they are written: the oldest events of a busy thread can be torn,
+ * which is acceptable for a trace.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+#include "my_trace.h"
+
+#if MY_USE_TRACE
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_TRACE_THREAD_MAX     16
+#define MY_TRACE_EXPORT_PERIOD  500     /* Check for SIGUSR1 this often [ms] */
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint64_t ts;                /* Start in us */
+	uint32_t dur;               /* Duration in us, 0: instant */
+	uint8_t type;
+	lv_area_t area;
+	const char *obj;            /* Type of the object covering the area of a long frame */
+} my_trace_event_t;
+
+typedef struct {
+	my_trace_event_t ev[MY_TRACE_RING_SIZE];
+	uint32_t head;              /* Number of events ever written */
+	uint32_t exported;          /* `head` at the last export */
+	int tid;
+	char name[16];
+} my_trace_ring_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static my_trace_ring_t *my_trace_get_ring(void);
+static void my_trace_sig(int sig);
+static void my_trace_export_task(lv_task_t *task);
+static lv_obj_t *my_trace_find_obj(lv_obj_t *parent, const lv_area_t *area);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static my_trace_ring_t *rings[MY_TRACE_THREAD_MAX];
+static uint32_t ring_cnt;
+static __thread my_trace_ring_t *ring;
+static volatile sig_atomic_t export_req;
+static lv_area_t frame_area;        /* The areas flushed since the last frame */
+static bool frame_area_valid;
+static my_trace_stats_t stats;
+
+static const char *names[_MY_TRACE_LAST] = {
+	[MY_TRACE_INPUT] = "input",
+	[MY_TRACE_TASK_HANDLER] = "lv_task_handler",
+	[MY_TRACE_REFR] = "render",
+	[MY_TRACE_FLUSH] = "flush",
+	[MY_TRACE_FLIP] = "flip",
+	[MY_TRACE_VBLANK] = "vblank",
+	[MY_TRACE_FRAME] = "frame",
+};
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+void my_trace_init(void)
+{
+	struct sigaction sa;
+
+	sa.sa_handler = my_trace_sig;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sa, NULL);
+
+	/* The file is written from the main loop, not from the signal handler */
+	lv_task_create(my_trace_export_task, MY_TRACE_EXPORT_PERIOD, LV_TASK_PRIO_LOWEST, NULL);
+}
+
+uint64_t my_trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void my_trace_add(my_trace_type_t type, uint64_t start_us, const lv_area_t *area)
+{
+	my_trace_ring_t *r = my_trace_get_ring();
+	my_trace_event_t *ev;
+	uint64_t now = my_trace_now();
+	uint32_t head;
+
+	if(r == NULL) return;
+
+	head = r->head;
+	ev = &r->ev[head & (MY_TRACE_RING_SIZE - 1)];
+	ev->ts = start_us ? start_us : now;
+	ev->dur = start_us ? now - start_us : 0;
+	ev->type = type;
+	ev->obj = NULL;
+	if(area) lv_area_copy(&ev->area, area);
+	else ev->area.x1 = ev->area.y1 = ev->area.x2 = ev->area.y2 = -1;
+
+	/* Publish the event for the export */
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+
+	if(type == MY_TRACE_FLUSH && area) {
+		if(frame_area_valid) _lv_area_join(&frame_area, &frame_area, area);
+		else lv_area_copy(&frame_area, area);
+		frame_area_valid = true;
+	}
+}
+
+void my_trace_monitor(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px)
+{
+	my_trace_ring_t *r = my_trace_get_ring();
+	my_trace_event_t *ev;
+	lv_obj_t *obj = NULL;
+	lv_obj_type_t obj_type;
+
+	(void)disp_drv;
+
+	if(r == NULL) return;
+
+	stats.frame_cnt++;
+	if(time > stats.frame_max_ms) stats.frame_max_ms = time;
+
+	my_trace_add(MY_TRACE_FRAME, my_trace_now() - (uint64_t)time * 1000, frame_area_valid ? &frame_area : NULL);
+
+	if(time > MY_TRACE_JANK_TIME && frame_area_valid) {
+		stats.jank_cnt++;
+
+		/* LVGL doesn't record who invalidated an area, find the smallest object covering it */
+		obj = my_trace_find_obj(lv_disp_get_scr_act(_lv_refr_get_disp_refreshing()), &frame_area);
+		lv_obj_get_type(obj, &obj_type);
+
+		ev = &r->ev[(r->head - 1) & (MY_TRACE_RING_SIZE - 1)];
+		ev->obj = obj_type.type[0];
+
+		printf("trace: long frame %u ms, %u px, area %d,%d %dx%d, %s\n", time, px,
+				frame_area.x1, frame_area.y1, lv_area_get_width(&frame_area), lv_area_get_height(&frame_area),
+				ev->obj ? ev->obj : "?");
+	}
+
+	frame_area_valid = false;
+}
+
+int my_trace_export(const char *path)
+{
+	FILE *f;
+	uint32_t cnt = __atomic_load_n(&ring_cnt, __ATOMIC_ACQUIRE);
+	uint32_t i;
+	uint32_t e;
+	bool first = true;
+
+	f = fopen(path, "w");
+	if(f == NULL) {
+		perror("can not open trace file");
+		return -1;
+	}
+
+	fprintf(f, "{\"traceEvents\":[\n");
+
+	for(i = 0; i < cnt && i < MY_TRACE_THREAD_MAX; i++) {
+		my_trace_ring_t *r = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+		uint32_t head;
+		uint32_t start;
+
+		/* Being created */
+		if(r == NULL) continue;
+
+		head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		start = head > MY_TRACE_RING_SIZE ? head - MY_TRACE_RING_SIZE : 0;
+
+		if(start > r->exported) stats.lost_cnt += start - r->exported;
+		r->exported = head;
+
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", getpid(), r->tid, r->name);
+		first = false;
+
+		for(e = start; e < head; e++) {
+			my_trace_event_t *ev = &r->ev[e & (MY_TRACE_RING_SIZE - 1)];
+
+			fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%llu,\"pid\":%d,\"tid\":%d",
+					names[ev->type], ev->dur ? "X" : "i", (unsigned long long)ev->ts, getpid(), r->tid);
+			if(ev->dur) fprintf(f, ",\"dur\":%u", ev->dur);
+			else fprintf(f, ",\"s\":\"t\"");
+
+			if(ev->area.x1 >= 0) {
+				fprintf(f, ",\"args\":{\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d", ev->area.x1, ev->area.y1,
+						lv_area_get_width(&ev->area), lv_area_get_height(&ev->area));
+				if(ev->obj) fprintf(f, ",\"jank\":true,\"obj\":\"%s\"", ev->obj);
+				fprintf(f, "}");
+			}
+			fprintf(f, "}");
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+
+	return 0;
+}
+
+void my_trace_get_stats(my_trace_stats_t *res)
+{
+	*res = stats;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Get the ring buffer of the calling thread, create it on the first call.
+ * @return the ring buffer or NULL if there are too many threads
+ */
+static my_trace_ring_t *my_trace_get_ring(void)
+{
+	uint32_t idx;
+
+	if(ring) return ring;
+	if(__atomic_load_n(&ring_cnt, __ATOMIC_RELAXED) >= MY_TRACE_THREAD_MAX) return NULL;
+
+	idx = __atomic_fetch_add(&ring_cnt, 1, __ATOMIC_ACQ_REL);
+	if(idx >= MY_TRACE_THREAD_MAX) return NULL;
+
+	/* Not from the LVGL heap, it's called from other threads too */
+	ring = calloc(1, sizeof(my_trace_ring_t));
+	if(ring == NULL) return NULL;
+
+	ring->tid = syscall(SYS_gettid);
+	prctl(PR_GET_NAME, ring->name);
+	__atomic_store_n(&rings[idx], ring, __ATOMIC_RELEASE);
+
+	return ring;
+}
+
+static void my_trace_sig(int sig)
+{
+	(void)sig;
+
+	export_req = 1;
+}
+
+static void my_trace_export_task(lv_task_t *task)
+{
+	(void)task;
+
+	if(export_req == 0) return;
+	export_req = 0;
+
+	if(my_trace_export(MY_TRACE_FILE) == 0) {
+		printf("trace: written to %s\n", MY_TRACE_FILE);
+	}
+}
+
+/**
+ * Find the deepest object which covers an area.
+ * @param parent start the search here
+ * @param area the area to cover
+ * @return `parent` or one of its descendants
+ */
+static lv_obj_t *my_trace_find_obj(lv_obj_t *parent, const lv_area_t *area)
+{
+	lv_obj_t *child;
+	lv_area_t coords;
+
+	/* The children are listed from the top one */
+	for(child = lv_obj_get_child(parent, NULL); child; child = lv_obj_get_child(parent, child)) {
+		lv_obj_get_coords(child, &coords);
+		if(_lv_area_is_in(area, &coords, 0)) return my_trace_find_obj(child, area);
+	}
+
+	return parent;
+}
+
+#endif /*MY_USE_TRACE*/
@@ -0,0 +1,105 @@
+/**
+ * @file my_trace.h
+ * Frame timing trace with Chrome trace export
+ */
+
+#ifndef MY_TRACE_H
+#define MY_TRACE_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef enum {
+	MY_TRACE_INPUT,             /* An input event was read */
+	MY_TRACE_TASK_HANDLER,      /* `lv_task_handler()` */
+	MY_TRACE_REFR,              /* Rendering of a frame */
+	MY_TRACE_FLUSH,             /* `my_disp_flush()` of an area */
+	MY_TRACE_FLIP,              /* Commit to page flip */
+	MY_TRACE_VBLANK,
+	MY_TRACE_FRAME,             /* A whole refresh, reported by LVGL */
+	_MY_TRACE_LAST
+} my_trace_type_t;
+
+#if MY_USE_TRACE
+
+typedef struct {
+	uint32_t frame_cnt;
+	uint32_t jank_cnt;          /* Frames longer than MY_TRACE_JANK_TIME */
+	uint32_t frame_max_ms;
+	uint32_t lost_cnt;          /* Events overwritten before an export */
+} my_trace_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Start tracing. SIGUSR1 writes the trace to MY_TRACE_FILE.
+ */
+void my_trace_init(void);
+
+/**
+ * Get the time in the trace's clock (CLOCK_MONOTONIC).
+ * @return time in us
+ */
+uint64_t my_trace_now(void);
+
+/**
+ * Add an event of the calling thread which lasted from `start_us` till now.
+ * Lock-free, it can be called from any thread.
+ * @param type type of the event
+ * @param start_us start of the event from `my_trace_now()`, 0: an instant event
+ * @param area the area of the event or NULL
+ */
+void my_trace_add(my_trace_type_t type, uint64_t start_us, const lv_area_t *area);
+
+/**
+ * The `monitor_cb` of the display driver.
+ * Records the refreshed frames and flags the long ones with the
+ * flushed area and the object which covers it.
+ * @param disp_drv the display driver
+ * @param time duration of the refresh in ms
+ * @param px number of rendered pixels
+ */
+void my_trace_monitor(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px);
+
+/**
+ * Write the events in the ring buffers in Chrome trace JSON format.
+ * It can be opened in chrome://tracing or ui.perfetto.dev.
+ * @param path path of the file
+ * @return 0 on success, -1 on error
+ */
+int my_trace_export(const char *path);
+
+/**
+ * Get the frame statistics.
+ * @param stats store the result here
+ */
+void my_trace_get_stats(my_trace_stats_t *stats);
+
+#else
+
+/* The trace points do nothing */
+static inline uint64_t my_trace_now(void)
+{
+	return 0;
+}
+
+static inline void my_trace_add(my_trace_type_t type, uint64_t start_us, const lv_area_t *area)
+{
+	(void)type;
+	(void)start_us;
+	(void)area;
+}
+
+#endif /*MY_USE_TRACE*/
+
+#endif /*MY_TRACE_H*/
@@ -0,0 +1,726 @@
+/**
+ * @file my_vnc.c
+ * RFB (VNC) server fed by the flushed areas
+ *
+ * The flushed areas are collected as damage, their pixels are in the
+ * copy of the screen of my_shadow.c. A server thread serves one client at a time (RFB 3.3 - 3.8,
+ * no authentication): it snapshots the damaged rectangles and sends them
+ * with the Hextile or the Raw encoding. The client's pointer is read by
+ * `my_touchpad_read()` like the touchpad.
+ *
+ * Test it over the loopback with e.g. `vncviewer 127.0.0.1::5900`.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "my_vnc.h"
+#include "my_shadow.h"
+#include "my_sched.h"
+
+#if MY_USE_VNC
+
+/*********************
+ *      DEFINES
+ *********************/
+#define MY_VNC_RECT_MAX     32
+#define MY_VNC_TILE         16
+
+#define MY_VNC_ENC_RAW      0
+#define MY_VNC_ENC_HEXTILE  5
+
+#define MY_VNC_HEXTILE_RAW  1
+#define MY_VNC_HEXTILE_BG   2
+
+/* ServerInit, Hextile and the native rows send lv_color_t as XRGB8888 */
+#if LV_COLOR_DEPTH != 32
+#error "MY_USE_VNC needs LV_COLOR_DEPTH 32"
+#endif
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+/* Pixel format of the client */
+typedef struct {
+	uint8_t bpp;
+	uint8_t big_endian;
+	uint16_t rmax;
+	uint16_t gmax;
+	uint16_t bmax;
+	uint8_t rshift;
+	uint8_t gshift;
+	uint8_t bshift;
+	bool native;                /* Same as lv_color_t: the rows can be copied */
+} my_vnc_pf_t;
+
+typedef struct {
+	uint8_t *data;
+	uint32_t len;
+	uint32_t size;
+} my_vnc_out_t;
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+static void *my_vnc_thread(void *arg);
+static int my_vnc_handshake(int fd);
+static void my_vnc_serve(int fd);
+static int my_vnc_read_msg(int fd);
+static int my_vnc_send_update(int fd);
+static void my_vnc_add_damage(const lv_area_t *area);
+static void my_vnc_encode_raw(my_vnc_out_t *out, const lv_area_t *a);
+static void my_vnc_encode_hextile(my_vnc_out_t *out, const lv_area_t *a);
+static void my_vnc_put_pixel(my_vnc_out_t *out, lv_color_t c);
+static void my_vnc_set_pf(const uint8_t *p);
+static void my_vnc_out_reserve(my_vnc_out_t *out, uint32_t len);
+static void my_vnc_out_u8(my_vnc_out_t *out, uint8_t v);
+static void my_vnc_out_u16(my_vnc_out_t *out, uint16_t v);
+static void my_vnc_out_u32(my_vnc_out_t *out, uint32_t v);
+static int my_vnc_recv_all(int fd, void *buf, uint32_t len);
+static int my_vnc_send_all(int fd, const void *buf, uint32_t len);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_coord_t scr_w;
+static lv_coord_t scr_h;
+static lv_color_t *snap;            /* The damaged areas of the shadow, read by the server */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static lv_area_t damage[MY_VNC_RECT_MAX];
+static uint32_t damage_cnt;
+static int wake_pipe[2] = {-1, -1};
+
+/* State of the connection, used by the server thread only */
+static my_vnc_pf_t pf;
+static bool hextile;
+static bool update_req;
+static my_vnc_out_t out;
+
+/* Pointer of the client, protected by `lock` */
+static lv_point_t ptr_point;
+static bool ptr_pressed;
+static bool ptr_release;
+
+static my_vnc_stats_t stats;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int my_vnc_init(lv_coord_t hor_res, lv_coord_t ver_res)
+{
+	pthread_t thread;
+
+	scr_w = hor_res;
+	scr_h = ver_res;
+
+	if(my_shadow_init(hor_res, ver_res) < 0) return -1;
+
+	/* Not from the LVGL heap, the server thread reads it */
+	snap = calloc(scr_w * scr_h, sizeof(lv_color_t));
+	if(snap == NULL) {
+		perror("can not allocate vnc buffers");
+		return -1;
+	}
+
+	if(pipe(wake_pipe) < 0) {
+		perror("can not create vnc pipe");
+		return -1;
+	}
+	fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+	if(pthread_create(&thread, NULL, my_vnc_thread, NULL) != 0) {
+		perror("can not start the vnc thread");
+		return -1;
+	}
+	pthread_detach(thread);
+
+	return 0;
+}
+
+void my_vnc_flush(lv_disp_drv_t *disp, const lv_area_t *area)
+{
+	lv_area_t a;
+	uint8_t wake = 0;
+
+	/* Only the visible part */
+	a.x1 = 0;
+	a.y1 = 0;
+	a.x2 = scr_w - 1;
+	a.y2 = scr_h - 1;
+	if(stats.connected && _lv_area_intersect(&a, &a, area)) {
+		pthread_mutex_lock(&lock);
+		my_vnc_add_damage(&a);
+		pthread_mutex_unlock(&lock);
+	}
+
+	if(lv_disp_flush_is_last(disp) && stats.connected) {
+		if(write(wake_pipe[1], &wake, 1) < 0 && errno != EAGAIN) {
+			perror("vnc wake error");
+		}
+	}
+}
+
+bool my_vnc_read_pointer(lv_indev_data_t *data)
+{
+	bool res = false;
+
+	pthread_mutex_lock(&lock);
+	if(ptr_pressed || ptr_release) {
+		data->point = ptr_point;
+		data->state = ptr_pressed ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
+		ptr_release = false;
+		res = true;
+	}
+	pthread_mutex_unlock(&lock);
+
+	return res;
+}
+
+void my_vnc_get_stats(my_vnc_stats_t *res)
+{
+	*res = stats;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+/**
+ * Accept the clients one after the other.
+ * @param arg unused
+ * @return NULL on error
+ */
+static void *my_vnc_thread(void *arg)
+{
+	struct sockaddr_in addr;
+	int listen_fd;
+	int fd;
+	int one = 1;
+
+	(void)arg;
+
+#if MY_USE_SCHED
+	my_sched_apply(MY_SCHED_ROLE_BACKGROUND, "lv-vnc");
+#endif
+
+	listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(listen_fd < 0) {
+		perror("can not create vnc socket");
+		return NULL;
+	}
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(MY_VNC_PORT);
+	inet_pton(AF_INET, MY_VNC_ADDR, &addr.sin_addr);
+	if(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 1) < 0) {
+		perror("can not listen on the vnc port");
+		close(listen_fd);
+		return NULL;
+	}
+
+	while(1) {
+		fd = accept(listen_fd, NULL, NULL);
+		if(fd < 0) {
+			if(errno != EINTR) perror("vnc accept error");
+			continue;
+		}
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		if(my_vnc_handshake(fd) == 0) {
+			stats.client_cnt++;
+			my_vnc_serve(fd);
+		}
+		close(fd);
+	}
+
+	return NULL;
+}
+
+/**
+ * Negotiate the version and the security, then send the ServerInit message.
+ * @param fd socket of the client
+ * @return 0 on success, -1 on error
+ */
+static int my_vnc_handshake(int fd)
+{
+	char version[12];
+	uint8_t buf[64];
+	uint32_t minor;
+	uint32_t name_len = strlen(MY_VNC_NAME);
+
+	if(my_vnc_send_all(fd, "RFB 003.008\n", 12) < 0) return -1;
+	if(my_vnc_recv_all(fd, version, 12) < 0) return -1;
+	if(memcmp(version, "RFB 003.", 8) != 0) return -1;
+	minor = (version[8] - '0') * 100 + (version[9] - '0') * 10 + (version[10] - '0');
+
+	if(minor >= 7) {
+		/* One security type: None */
+		buf[0] = 1;
+		buf[1] = 1;
+		if(my_vnc_send_all(fd, buf, 2) < 0) return -1;
+		if(my_vnc_recv_all(fd, buf, 1) < 0 || buf[0] != 1) return -1;
+		/* SecurityResult OK, 3.7 doesn't send it for None */
+		if(minor >= 8) {
+			memset(buf, 0, 4);
+			if(my_vnc_send_all(fd, buf, 4) < 0) return -1;
+		}
+	}
+	else {
+		/* 3.3: the server decides */
+		buf[0] = 0;
+		buf[1] = 0;
+		buf[2] = 0;
+		buf[3] = 1;
+		if(my_vnc_send_all(fd, buf, 4) < 0) return -1;
+	}
+
+	/* ClientInit: the shared flag is ignored, there is one client only */
+	if(my_vnc_recv_all(fd, buf, 1) < 0) return -1;
+
+	/* ServerInit with lv_color_t's format: 32 bpp, depth 24, little endian, true color */
+	buf[0] = scr_w >> 8;
+	buf[1] = scr_w & 0xff;
+	buf[2] = scr_h >> 8;
+	buf[3] = scr_h & 0xff;
+	memcpy(&buf[4], (const uint8_t[16]){32, 24, 0, 1, 0, 255, 0, 255, 0, 255, 16, 8, 0}, 16);
+	buf[20] = name_len >> 24;
+	buf[21] = name_len >> 16;
+	buf[22] = name_len >> 8;
+	buf[23] = name_len;
+	if(my_vnc_send_all(fd, buf, 24) < 0) return -1;
+	if(my_vnc_send_all(fd, MY_VNC_NAME, name_len) < 0) return -1;
+
+	my_vnc_set_pf(&buf[4]);
+
+	return 0;
+}
+
+/**
+ * Serve a client until it disconnects.
+ * @param fd socket of the client
+ */
+static void my_vnc_serve(int fd)
+{
+	struct pollfd pfd[2];
+	uint8_t drain[64];
+	lv_area_t full;
+	bool damaged;
+
+	hextile = false;
+	update_req = false;
+
+	/* Start with the whole screen */
+	full.x1 = 0;
+	full.y1 = 0;
+	full.x2 = scr_w - 1;
+	full.y2 = scr_h - 1;
+	pthread_mutex_lock(&lock);
+	damage_cnt = 0;
+	my_vnc_add_damage(&full);
+	stats.connected = true;
+	pthread_mutex_unlock(&lock);
+
+	pfd[0].fd = fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = wake_pipe[0];
+	pfd[1].events = POLLIN;
+
+	while(1) {
+		if(poll(pfd, 2, -1) < 0) {
+			if(errno == EINTR) continue;
+			break;
+		}
+
+		if(pfd[1].revents & POLLIN) {
+			if(read(wake_pipe[0], drain, sizeof(drain)) < 0) break;
+		}
+
+		if(pfd[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+			if(my_vnc_read_msg(fd) < 0) break;
+		}
+
+		/* The UI thread adds damage while flushing */
+		pthread_mutex_lock(&lock);
+		damaged = damage_cnt != 0;
+		pthread_mutex_unlock(&lock);
+
+		if(update_req && damaged) {
+			if(my_vnc_send_update(fd) < 0) break;
+		}
+	}
+
+	pthread_mutex_lock(&lock);
+	stats.connected = false;
+	/* Release a pressed pointer */
+	if(ptr_pressed) {
+		ptr_pressed = false;
+		ptr_release = true;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Read and process a message of the client.
+ * @param fd socket of the client
+ * @return 0 on success, -1 on error or disconnect
+ */
+static int my_vnc_read_msg(int fd)
+{
+	uint8_t buf[20];
+	uint32_t i;
+	uint32_t len;
+
+	if(my_vnc_recv_all(fd, buf, 1) < 0) return -1;
+
+	switch(buf[0]) {
+		case 0:     /* SetPixelFormat */
+			if(my_vnc_recv_all(fd, buf, 19) < 0) return -1;
+			my_vnc_set_pf(&buf[3]);
+			break;
+
+		case 2:     /* SetEncodings */
+			if(my_vnc_recv_all(fd, buf, 3) < 0) return -1;
+			len = (buf[1] << 8) | buf[2];
+			hextile = false;
+			for(i = 0; i < len; i++) {
+				if(my_vnc_recv_all(fd, buf, 4) < 0) return -1;
+				if(buf[0] == 0 && buf[1] == 0 && buf[2] == 0 && buf[3] == MY_VNC_ENC_HEXTILE) hextile = true;
+			}
+			break;
+
+		case 3: {   /* FramebufferUpdateRequest */
+			lv_area_t a;
+			uint32_t x, y, w, h;
+
+			if(my_vnc_recv_all(fd, buf, 9) < 0) return -1;
+			update_req = true;
+
+			/* Not in lv_coord_t yet: it's 16 bit signed, the client sends up to 65535 */
+			x = (buf[1] << 8) | buf[2];
+			y = (buf[3] << 8) | buf[4];
+			w = (buf[5] << 8) | buf[6];
+			h = (buf[7] << 8) | buf[8];
+			if(buf[0] == 0 && x < (uint32_t)scr_w && y < (uint32_t)scr_h && w > 0 && h > 0) {
+				/* Not incremental: resend the area */
+				a.x1 = x;
+				a.y1 = y;
+				a.x2 = LV_MATH_MIN(x + w, (uint32_t)scr_w) - 1;
+				a.y2 = LV_MATH_MIN(y + h, (uint32_t)scr_h) - 1;
+				pthread_mutex_lock(&lock);
+				my_vnc_add_damage(&a);
+				pthread_mutex_unlock(&lock);
+			}
+			break;
+		}
+
+		case 4:     /* KeyEvent, no keypad */
+			if(my_vnc_recv_all(fd, buf, 7) < 0) return -1;
+			break;
+
+		case 5:     /* PointerEvent */
+			if(my_vnc_recv_all(fd, buf, 5) < 0) return -1;
+			pthread_mutex_lock(&lock);
+			ptr_point.x = LV_MATH_MIN((buf[1] << 8) | buf[2], scr_w - 1);
+			ptr_point.y = LV_MATH_MIN((buf[3] << 8) | buf[4], scr_h - 1);
+			/* The left button touches */
+			if(buf[0] & 1) ptr_pressed = true;
+			else if(ptr_pressed) {
+				ptr_pressed = false;
+				ptr_release = true;
+			}
+			pthread_mutex_unlock(&lock);
+			break;
+
+		case 6:     /* ClientCutText, skipped */
+			if(my_vnc_recv_all(fd, buf, 7) < 0) return -1;
+			len = ((uint32_t)buf[3] << 24) | (buf[4] << 16) | (buf[5] << 8) | buf[6];
+			while(len) {
+				uint32_t n = LV_MATH_MIN(len, sizeof(buf));
+				if(my_vnc_recv_all(fd, buf, n) < 0) return -1;
+				len -= n;
+			}
+			break;
+
+		default:
+			LV_LOG_WARN("my_vnc: unknown message");
+			return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Snapshot the damaged areas and send them in a FramebufferUpdate.
+ * @param fd socket of the client
+ * @return 0 on success, -1 on error
+ */
+static int my_vnc_send_update(int fd)
+{
+	const lv_color_t *shadow;
+	lv_area_t rects[MY_VNC_RECT_MAX];
+	uint32_t cnt;
+	uint32_t i;
+	int32_t y;
+
+	pthread_mutex_lock(&lock);
+	cnt = damage_cnt;
+	memcpy(rects, damage, cnt * sizeof(lv_area_t));
+	damage_cnt = 0;
+	pthread_mutex_unlock(&lock);
+
+	/* Copy the damaged pixels so the UI thread isn't blocked while encoding.
+	 * The shadow is written before the damage is added, so it's at least as new. */
+	shadow = my_shadow_get();
+	my_shadow_lock();
+	for(i = 0; i < cnt; i++) {
+		for(y = rects[i].y1; y <= rects[i].y2; y++) {
+			uint32_t ofs = y * scr_w + rects[i].x1;
+			memcpy(&snap[ofs], &shadow[ofs], lv_area_get_width(&rects[i]) * sizeof(lv_color_t));
+		}
+	}
+	my_shadow_unlock();
+
+	out.len = 0;
+	my_vnc_out_u8(&out, 0);     /* FramebufferUpdate */
+	my_vnc_out_u8(&out, 0);
+	my_vnc_out_u16(&out, cnt);
+
+	for(i = 0; i < cnt; i++) {
+		my_vnc_out_u16(&out, rects[i].x1);
+		my_vnc_out_u16(&out, rects[i].y1);
+		my_vnc_out_u16(&out, lv_area_get_width(&rects[i]));
+		my_vnc_out_u16(&out, lv_area_get_height(&rects[i]));
+		if(hextile) {
+			my_vnc_out_u32(&out, MY_VNC_ENC_HEXTILE);
+			my_vnc_encode_hextile(&out, &rects[i]);
+		}
+		else {
+			my_vnc_out_u32(&out, MY_VNC_ENC_RAW);
+			my_vnc_encode_raw(&out, &rects[i]);
+		}
+		stats.px_cnt += lv_area_get_size(&rects[i]);
+	}
+
+	stats.update_cnt++;
+	stats.rect_cnt += cnt;
+	stats.byte_cnt += out.len;
+	update_req = false;
+
+	return my_vnc_send_all(fd, out.data, out.len);
+}
+
+/**
+ * Add an area to the damage. Areas which are covered by an other are dropped.
+ * If there are too many areas they are joined into one.
+ * Call it with `lock` held.
+ * @param area the changed area
+ */
+static void my_vnc_add_damage(const lv_area_t *area)
+{
+	uint32_t i;
+
+	for(i = 0; i < damage_cnt; i++) {
+		if(_lv_area_is_in(area, &damage[i], 0)) return;
+	}
+
+	if(damage_cnt < MY_VNC_RECT_MAX) {
+		lv_area_copy(&damage[damage_cnt++], area);
+		return;
+	}
+
+	for(i = 1; i < damage_cnt; i++) {
+		_lv_area_join(&damage[0], &damage[0], &damage[i]);
+	}
+	_lv_area_join(&damage[0], &damage[0], area);
+	damage_cnt = 1;
+}
+
+static void my_vnc_encode_raw(my_vnc_out_t *o, const lv_area_t *a)
+{
+	uint32_t w = lv_area_get_width(a);
+	int32_t x;
+	int32_t y;
+
+	my_vnc_out_reserve(o, lv_area_get_size(a) * (pf.bpp / 8));
+
+	for(y = a->y1; y <= a->y2; y++) {
+		const lv_color_t *row = &snap[y * scr_w + a->x1];
+		if(pf.native) {
+			memcpy(&o->data[o->len], row, w * sizeof(lv_color_t));
+			o->len += w * sizeof(lv_color_t);
+		}
+		else {
+			for(x = 0; x < (int32_t)w; x++) my_vnc_put_pixel(o, row[x]);
+		}
+	}
+}
+
+/**
+ * Hextile: solid 16x16 tiles are sent as one pixel, the others raw.
+ * UI screens have many flat tiles, so it's much smaller than Raw without zlib.
+ */
+static void my_vnc_encode_hextile(my_vnc_out_t *o, const lv_area_t *a)
+{
+	lv_area_t tile;
+	int32_t x;
+	int32_t y;
+	bool solid;
+	uint32_t bg;
+
+	for(tile.y1 = a->y1; tile.y1 <= a->y2; tile.y1 += MY_VNC_TILE) {
+		tile.y2 = LV_MATH_MIN(tile.y1 + MY_VNC_TILE - 1, a->y2);
+		for(tile.x1 = a->x1; tile.x1 <= a->x2; tile.x1 += MY_VNC_TILE) {
+			tile.x2 = LV_MATH_MIN(tile.x1 + MY_VNC_TILE - 1, a->x2);
+
+			bg = snap[tile.y1 * scr_w + tile.x1].full & 0xffffff;
+			solid = true;
+			for(y = tile.y1; y <= tile.y2 && solid; y++) {
+				const lv_color_t *row = &snap[y * scr_w];
+				for(x = tile.x1; x <= tile.x2; x++) {
+					if((row[x].full & 0xffffff) != bg) {
+						solid = false;
+						break;
+					}
+				}
+			}
+
+			if(solid) {
+				/* Always specify the background, a raw tile leaves it undefined */
+				my_vnc_out_u8(o, MY_VNC_HEXTILE_BG);
+				my_vnc_put_pixel(o, snap[tile.y1 * scr_w + tile.x1]);
+			}
+			else {
+				my_vnc_out_u8(o, MY_VNC_HEXTILE_RAW);
+				my_vnc_encode_raw(o, &tile);
+			}
+		}
+	}
+}
+
+static void my_vnc_put_pixel(my_vnc_out_t *o, lv_color_t c)
+{
+	uint32_t px;
+	uint32_t bytes = pf.bpp / 8;
+	uint32_t i;
+
+	px = ((c.ch.red * pf.rmax + 127) / 255) << pf.rshift |
+		((c.ch.green * pf.gmax + 127) / 255) << pf.gshift |
+		((c.ch.blue * pf.bmax + 127) / 255) << pf.bshift;
+
+	my_vnc_out_reserve(o, bytes);
+	for(i = 0; i < bytes; i++) {
+		o->data[o->len++] = pf.big_endian ? px >> ((bytes - 1 - i) * 8) : px >> (i * 8);
+	}
+}
+
+/**
+ * Use the pixel format of a ServerInit or SetPixelFormat message.
+ * Color maps are not supported, true color is assumed.
+ * @param p the 16 bytes of the pixel format
+ */
+static void my_vnc_set_pf(const uint8_t *p)
+{
+	pf.bpp = p[0];
+	pf.big_endian = p[2];
+	pf.rmax = (p[4] << 8) | p[5];
+	pf.gmax = (p[6] << 8) | p[7];
+	pf.bmax = (p[8] << 8) | p[9];
+	pf.rshift = p[10];
+	pf.gshift = p[11];
+	pf.bshift = p[12];
+
+	if(pf.bpp != 8 && pf.bpp != 16 && pf.bpp != 32) pf.bpp = 32;
+
+	pf.native = pf.bpp == 32 && pf.big_endian == 0 && pf.rmax == 255 && pf.gmax == 255 && pf.bmax == 255 &&
+				pf.rshift == 16 && pf.gshift == 8 && pf.bshift == 0;
+}
+
+static void my_vnc_out_reserve(my_vnc_out_t *o, uint32_t len)
+{
+	uint8_t *data;
+	uint32_t size;
+
+	if(o->len + len <= o->size) return;
+
+	size = LV_MATH_MAX(o->size * 2, o->len + len);
+	data = realloc(o->data, size);
+	if(data == NULL) {
+		perror("vnc out of memory");
+		abort();
+	}
+	o->data = data;
+	o->size = size;
+}
+
+static void my_vnc_out_u8(my_vnc_out_t *o, uint8_t v)
+{
+	my_vnc_out_reserve(o, 1);
+	o->data[o->len++] = v;
+}
+
+static void my_vnc_out_u16(my_vnc_out_t *o, uint16_t v)
+{
+	my_vnc_out_reserve(o, 2);
+	o->data[o->len++] = v >> 8;
+	o->data[o->len++] = v;
+}
+
+static void my_vnc_out_u32(my_vnc_out_t *o, uint32_t v)
+{
+	my_vnc_out_reserve(o, 4);
+	o->data[o->len++] = v >> 24;
+	o->data[o->len++] = v >> 16;
+	o->data[o->len++] = v >> 8;
+	o->data[o->len++] = v;
+}
+
+static int my_vnc_recv_all(int fd, void *buf, uint32_t len)
+{
+	uint8_t *p = buf;
+	ssize_t n;
+
+	while(len) {
+		n = recv(fd, p, len, 0);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return -1;
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int my_vnc_send_all(int fd, const void *buf, uint32_t len)
+{
+	const uint8_t *p = buf;
+	ssize_t n;
+
+	while(len) {
+		n = send(fd, p, len, MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return -1;
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+#endif /*MY_USE_VNC*/
@@ -0,0 +1,67 @@
+/**
+ * @file my_vnc.h
+ * RFB (VNC) server fed by the flushed areas
+ */
+
+#ifndef MY_VNC_H
+#define MY_VNC_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_VNC
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t client_cnt;        /* Accepted connections */
+	uint32_t update_cnt;        /* Sent framebuffer updates */
+	uint32_t rect_cnt;
+	uint64_t px_cnt;            /* Sent pixels */
+	uint64_t byte_cnt;          /* Sent bytes of the updates */
+	bool connected;
+} my_vnc_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Start the server thread listening on MY_VNC_ADDR:MY_VNC_PORT.
+ * @param hor_res horizontal resolution of the screen
+ * @param ver_res vertical resolution of the screen
+ * @return 0 on success, -1 on error
+ */
+int my_vnc_init(lv_coord_t hor_res, lv_coord_t ver_res);
+
+/**
+ * Add a flushed area to the changes for the client, its pixels must be
+ * in the copy of the screen already (`my_shadow_flush()`).
+ * After the last area of a frame the changed areas are sent to the client.
+ * @param disp the display driver being flushed
+ * @param area the flushed area
+ */
+void my_vnc_flush(lv_disp_drv_t *disp, const lv_area_t *area);
+
+/**
+ * Read the pointer of the client.
+ * @param data store the state and the point here
+ * @return true if the client's pointer is pressed or was just released
+ */
+bool my_vnc_read_pointer(lv_indev_data_t *data);
+
+/**
+ * Get the server's statistics.
+ * @param stats store the result here
+ */
+void my_vnc_get_stats(my_vnc_stats_t *stats);
+
+#endif /*MY_USE_VNC*/
+
+#endif /*MY_VNC_H*/
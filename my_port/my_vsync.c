@@ -0,0 +1,298 @@
+/**
+ * @file my_vsync.c
+ * Refresh the screen in time for the panel's vblank
+ *
+ * LVGL's refresh task is switched off and the main loop renders once per
+ * panel refresh instead. A frame is started `lead` us before a vblank:
+ * the time of the slowest recent frame plus a margin. If a frame misses its
+ * vblank the lead grows, so a screen which is too slow for every vblank
+ * is refreshed on every second one without beating against the scanout.
+ *
+ * The vblank times come from FBIO_WAITFORVSYNC in a thread or from page flip events.
+ * Without them the frames are still paced at the panel's rate, only the phase is unknown.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <sys/ioctl.h>
+
+#include "my_vsync.h"
+#include "my_trace.h"
+#include "my_scroll.h"
+#include "my_cmd.h"
+#include "my_sched.h"
+#include "my_budget.h"
+
+#if MY_USE_VSYNC
+
+/**********************
+ *  STATIC PROTOTYPES
+ **********************/
+#if MY_VSYNC_FB_EVENTS
+static void *my_vsync_fb_thread(void *arg);
+#endif
+static uint64_t my_vsync_next(uint64_t t);
+static uint64_t my_vsync_now_us(void);
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static lv_disp_t *vsync_disp;
+static int vsync_fd = -1;
+static uint64_t phase_us;           /* Time of a vblank, written by the vblank thread too */
+static uint64_t period_us;          /* Written by the vblank thread too */
+static uint64_t tick_us;            /* Time of the last lv_tick_inc() */
+static uint32_t render_peak_us;
+static my_vsync_stats_t stats;
+static pthread_mutex_t pause_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pause_cond = PTHREAD_COND_INITIALIZER;
+static bool paused;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+uint32_t my_vsync_fb_period(const struct fb_var_screeninfo *var)
+{
+	uint64_t htotal = var->xres + var->left_margin + var->right_margin + var->hsync_len;
+	uint64_t vtotal = var->yres + var->upper_margin + var->lower_margin + var->vsync_len;
+
+	if(var->pixclock == 0) return 0;
+
+	/* pixclock is in ps */
+	return var->pixclock * htotal * vtotal / 1000000;
+}
+
+void my_vsync_init(lv_disp_t *disp, uint32_t period, int fb_fd)
+{
+	uint64_t now = my_vsync_now_us();
+
+	vsync_disp = disp;
+
+	/* The refresh is started from `my_vsync_handler()` only */
+	lv_task_set_prio(_lv_disp_get_refr_task(disp), LV_TASK_PRIO_OFF);
+
+	if(period == 0) period = 1000000 / MY_VSYNC_DEFAULT_HZ;
+	__atomic_store_n(&period_us, period, __ATOMIC_RELAXED);
+	__atomic_store_n(&phase_us, now, __ATOMIC_RELAXED);
+	tick_us = now;
+
+	render_peak_us = period / 2;
+	stats.period_us = period;
+	stats.lead_us = render_peak_us + MY_VSYNC_MARGIN_US;
+
+#if MY_VSYNC_FB_EVENTS
+	if(fb_fd >= 0) {
+		pthread_t thread;
+
+		vsync_fd = fb_fd;
+		if(pthread_create(&thread, NULL, my_vsync_fb_thread, NULL) != 0) {
+			perror("can not start the vsync thread");
+		}
+		else {
+			pthread_detach(thread);
+		}
+	}
+#else
+	(void)fb_fd;
+#endif
+}
+
+void my_vsync_vblank(uint64_t us)
+{
+	uint64_t last = __atomic_load_n(&phase_us, __ATOMIC_RELAXED);
+	uint64_t period = __atomic_load_n(&period_us, __ATOMIC_RELAXED);
+	uint64_t delta = us - last;
+
+	/* Refine the period with the consecutive vblanks */
+	if(stats.vblank_events && delta > period / 2 && delta < period + period / 2) {
+		period = (period * 15 + delta) / 16;
+		__atomic_store_n(&period_us, period, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&phase_us, us, __ATOMIC_RELAXED);
+	stats.vblank_events = true;
+}
+
+void my_vsync_handler(void)
+{
+	uint64_t now = my_vsync_now_us();
+	uint64_t vblank = my_vsync_next(now + stats.lead_us);
+	uint64_t wake = vblank - stats.lead_us;
+	uint64_t start;
+	uint32_t render_us;
+	bool dirty;
+	struct timespec ts;
+
+	/* Sleep until the frame of `vblank` has to be started */
+	ts.tv_sec = wake / 1000000;
+	ts.tv_nsec = (wake % 1000000) * 1000;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#if MY_USE_SCHED
+	my_sched_woke(wake);
+#endif
+
+	start = my_vsync_now_us();
+	my_vsync_tick();
+
+#if MY_USE_CMD_QUEUE
+	/* The latest values posted before the frame */
+	my_cmd_handler();
+#endif
+#if MY_USE_TASK_BUDGET
+	my_budget_task_handler();
+#else
+	lv_task_handler();
+#endif
+#if MY_USE_TRACE
+	my_trace_add(MY_TRACE_TASK_HANDLER, start, NULL);
+#endif
+
+	/* The animations are stepped to the time of the frame */
+	lv_anim_refr_now();
+#if MY_USE_SCROLL_BLIT
+	my_scroll_apply();
+#endif
+	dirty = vsync_disp->inv_p != 0;
+	if(dirty == false) return;
+
+#if MY_USE_TRACE
+	uint64_t refr_start = my_trace_now();
+#endif
+#if MY_USE_TASK_BUDGET
+	/* The areas which don't fit in the budget are left for the next frame */
+	my_budget_refr_now(vsync_disp);
+#else
+	lv_refr_now(vsync_disp);
+#endif
+#if MY_USE_TRACE
+	my_trace_add(MY_TRACE_REFR, refr_start, NULL);
+#endif
+
+	now = my_vsync_now_us();
+	render_us = now - start;
+	stats.frame_cnt++;
+	if(render_us > stats.render_max_us) stats.render_max_us = render_us;
+
+	/* Follow the slowest recent frame, fall back slowly after a spike */
+	if(render_us > render_peak_us) render_peak_us = render_us;
+	else render_peak_us -= (render_peak_us - render_us) / 32;
+
+	if(now > vblank) {
+		stats.miss_cnt++;
+		/* Start earlier than the frame which was late */
+		render_peak_us += render_us / 4;
+	}
+	if(render_peak_us > 2 * stats.period_us) render_peak_us = 2 * stats.period_us;
+
+	stats.period_us = __atomic_load_n(&period_us, __ATOMIC_RELAXED);
+	stats.lead_us = render_peak_us + MY_VSYNC_MARGIN_US;
+}
+
+void my_vsync_tick(void)
+{
+	uint32_t elaps_ms = (my_vsync_now_us() - tick_us) / 1000;
+
+	/* Keep the remainder, the tick has ms resolution only */
+	if(elaps_ms) {
+		lv_tick_inc(elaps_ms);
+		tick_us += (uint64_t)elaps_ms * 1000;
+	}
+}
+
+void my_vsync_pause(bool pause)
+{
+	pthread_mutex_lock(&pause_lock);
+	paused = pause;
+	pthread_cond_signal(&pause_cond);
+	pthread_mutex_unlock(&pause_lock);
+}
+
+void my_vsync_get_stats(my_vsync_stats_t *res)
+{
+	*res = stats;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+#if MY_VSYNC_FB_EVENTS
+/**
+ * Wait for the vblanks of the framebuffer and report them.
+ * Exits if the driver doesn't support FBIO_WAITFORVSYNC.
+ * @param arg unused
+ * @return NULL
+ */
+static void *my_vsync_fb_thread(void *arg)
+{
+	uint32_t crtc = 0;
+#if MY_USE_SCHED
+	uint64_t due;
+#endif
+
+	(void)arg;
+
+#if MY_USE_SCHED
+	my_sched_apply(MY_SCHED_ROLE_VBLANK, "lv-vblank");
+#endif
+
+	while(1) {
+		pthread_mutex_lock(&pause_lock);
+		while(paused) pthread_cond_wait(&pause_cond, &pause_lock);
+		pthread_mutex_unlock(&pause_lock);
+
+#if MY_USE_SCHED
+		/* Late against the predicted vblank */
+		due = my_vsync_next(my_vsync_now_us());
+#endif
+		if(ioctl(vsync_fd, FBIO_WAITFORVSYNC, &crtc) < 0) {
+			if(errno == EINTR) continue;
+			LV_LOG_WARN("my_vsync: FBIO_WAITFORVSYNC is not supported, pacing without vblank events");
+			return NULL;
+		}
+
+#if MY_USE_SCHED
+		my_sched_woke(due);
+#endif
+		my_vsync_vblank(my_vsync_now_us());
+#if MY_USE_TRACE
+		my_trace_add(MY_TRACE_VBLANK, 0, NULL);
+#endif
+	}
+
+	return NULL;
+}
+#endif
+
+/**
+ * Get the first vblank at or after a time.
+ * @param t time in CLOCK_MONOTONIC us
+ * @return time of the vblank
+ */
+static uint64_t my_vsync_next(uint64_t t)
+{
+	uint64_t phase = __atomic_load_n(&phase_us, __ATOMIC_RELAXED);
+	uint64_t period = __atomic_load_n(&period_us, __ATOMIC_RELAXED);
+
+	if(t <= phase) return phase;
+
+	return phase + (t - phase + period - 1) / period * period;
+}
+
+static uint64_t my_vsync_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /*MY_USE_VSYNC*/
@@ -0,0 +1,87 @@
+/**
+ * @file my_vsync.h
+ * Refresh the screen in time for the panel's vblank
+ */
+
+#ifndef MY_VSYNC_H
+#define MY_VSYNC_H
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+#include <linux/fb.h>
+
+#include "lvgl/lvgl.h"
+#include "my_port_conf.h"
+
+#if MY_USE_VSYNC
+
+/**********************
+ *      TYPEDEFS
+ **********************/
+typedef struct {
+	uint32_t period_us;         /* Refresh period of the panel */
+	uint32_t lead_us;           /* A frame is started this long before its vblank */
+	uint32_t render_max_us;     /* Longest frame */
+	uint32_t frame_cnt;         /* Rendered frames */
+	uint32_t miss_cnt;          /* Frames which were ready after their vblank */
+	bool vblank_events;         /* The vblank times are reported by the driver */
+} my_vsync_stats_t;
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/**
+ * Get the refresh period from the timing of a framebuffer.
+ * @param var the screen info of the framebuffer
+ * @return the period in us or 0 if the driver doesn't report the pixel clock
+ */
+uint32_t my_vsync_fb_period(const struct fb_var_screeninfo *var);
+
+/**
+ * Take over the refresh of a display from its LVGL task.
+ * @param disp the display to refresh
+ * @param period_us the refresh period of the panel, 0: MY_VSYNC_DEFAULT_HZ
+ * @param fb_fd framebuffer to wait for vblanks with FBIO_WAITFORVSYNC, -1: don't wait
+ */
+void my_vsync_init(lv_disp_t *disp, uint32_t period_us, int fb_fd);
+
+/**
+ * Report a vblank, e.g. from a page flip event.
+ * The next frames are timed from it and the period is refined.
+ * @param us time of the vblank in CLOCK_MONOTONIC us
+ */
+void my_vsync_vblank(uint64_t us);
+
+/**
+ * One iteration of the main loop instead of `lv_task_handler()` + `usleep()`.
+ * Sleep until the next frame has to be started, increment the tick,
+ * run the LVGL tasks and render the frame.
+ */
+void my_vsync_handler(void);
+
+/**
+ * Advance the LVGL tick to the current time.
+ * Used by `my_vsync_handler()`, call it if the main loop runs LVGL tasks elsewhere too.
+ */
+void my_vsync_tick(void);
+
+/**
+ * Stop or restart waiting for the vblanks of the framebuffer,
+ * e.g. while nothing is refreshed.
+ * @param pause true: stop, false: restart
+ */
+void my_vsync_pause(bool pause);
+
+/**
+ * Get the pacing statistics.
+ * @param stats store the result here
+ */
+void my_vsync_get_stats(my_vsync_stats_t *stats);
+
+#endif /*MY_USE_VSYNC*/
+
+#endif /*MY_VSYNC_H*/
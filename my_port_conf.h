@@ -0,0 +1,348 @@
+/**
+ * @file my_port_conf.h
+ * Configuration file of the fbdev/evdev port
+ */
+
+/*
+ * KEEP THIS FILE NEXT TO main.c
+ */
+
+#if 1 /*Set it to "1" to enable content*/
+
+#ifndef MY_PORT_CONF_H
+#define MY_PORT_CONF_H
+/* clang-format off */
+
+#include "lv_conf.h"
+
+/*====================
+   Flush settings
+ *====================*/
+
+/* 1: Copy the rendered areas to the framebuffer in parallel with a pool of worker threads.
+ * Only the copy is parallel, LVGL still renders on the main thread.
+ * Every flushed area is split into horizontal bands, one band per worker.
+ * A second draw buffer is registered so LVGL renders the next area
+ * while the workers are still copying the previous one. */
+#define MY_USE_FLUSH_WORKERS    0
+#if MY_USE_FLUSH_WORKERS
+/* Number of worker threads (usually the number of CPU cores) */
+#  define MY_FLUSH_WORKER_CNT       4
+
+/* Don't split areas into bands smaller than this many lines */
+#  define MY_FLUSH_BAND_MIN_LINES   16
+
+/* 1: Print the time of full screen copies with 1 thread and with the workers after the first frame */
+#  define MY_FLUSH_BENCH            0
+#  if MY_FLUSH_BENCH
+#    define MY_FLUSH_BENCH_LOOPS    20
+#  endif
+#endif  /*MY_USE_FLUSH_WORKERS*/
+
+/* 1: Hash the flushed areas in tiles and write only the tiles which differ from the
+ * framebuffer. LVGL often redraws pixels which don't change (animations, invalidated objects);
+ * they are read from the draw buffer (cached) but not written to the framebuffer (uncached).
+ * `my_flush_print_stats()` shows the saved bytes, MY_TILE_HASH_STATS_PERIOD prints them periodically. */
+#define MY_USE_TILE_HASH        0
+#if MY_USE_TILE_HASH
+#  define MY_TILE_HASH_W            32      /* px */
+#  define MY_TILE_HASH_H            16      /* lines */
+#  define MY_TILE_HASH_STATS_PERIOD 0       /* ms, print the statistics this often, 0: never */
+#endif  /*MY_USE_TILE_HASH*/
+
+/* 1: Scroll pages (lists, tables, ...) by moving the pixels already in the framebuffer,
+ * only the uncovered strips are rendered. Used if the background behind the page is a
+ * single color and nothing is over it; otherwise the page is rendered as usual.
+ * Only with the framebuffer backend, and not with MY_USE_VNC or MY_USE_CAPTURE
+ * (they copy the flushed areas only). */
+#define MY_USE_SCROLL_BLIT      0
+#if MY_USE_SCROLL_BLIT
+#  define MY_SCROLL_BLIT_MAX_PAGES  16
+
+/* Attach the new pages of the active screen this often [ms], 0: only by `my_scroll_attach()` */
+#  define MY_SCROLL_BLIT_SCAN_PERIOD 500
+#endif  /*MY_USE_SCROLL_BLIT*/
+
+/* 1: Cache a static layer (e.g. the background of a screen) marked with `my_layer_set_static()`.
+ * It's drawn once into a full screen buffer, then the invalidated areas of it are copied
+ * from there instead of drawing its objects again. */
+#define MY_USE_LAYER_CACHE      0
+#if MY_USE_LAYER_CACHE
+/* Objects in the layer, the others are drawn as usual */
+#  define MY_LAYER_CACHE_MAX_OBJS   64
+#endif  /*MY_USE_LAYER_CACHE*/
+
+/* 1: Add a DRM/KMS backend with two dumb buffers and page flips.
+ * Select it at runtime with the LV_PORT_BACKEND=drm environment variable
+ * (LV_PORT_DRM_CARD=/dev/dri/cardN selects the device). If it fails the framebuffer is used. */
+#define MY_USE_DRM              0
+#if MY_USE_DRM
+#  define MY_DRM_DEFAULT_CARD       "/dev/dri/card0"
+#endif  /*MY_USE_DRM*/
+
+/*====================
+   Refresh settings
+ *====================*/
+
+/* 1: Refresh the screen once per panel refresh, just in time for the vblank,
+ * instead of every LV_DISP_DEF_REFR_PERIOD ms from a 5 ms loop.
+ * The period is read from the framebuffer's timing (pixclock and margins)
+ * or from the DRM mode. */
+#define MY_USE_VSYNC            0
+#if MY_USE_VSYNC
+/* Refresh rate if the driver doesn't report the timing */
+#  define MY_VSYNC_DEFAULT_HZ       60
+
+/* Start the frames this many us earlier than the slowest recent frame needed */
+#  define MY_VSYNC_MARGIN_US        1000
+
+/* 1: Follow the vblanks of the framebuffer with FBIO_WAITFORVSYNC in a thread.
+ * The page flip events are used with DRM. */
+#  define MY_VSYNC_FB_EVENTS        1
+#endif  /*MY_USE_VSYNC*/
+
+/* 1: Suspend the refresh and the touchpad polling after MY_IDLE_TIME ms
+ * without input and without changes on the screen. The main loop then sleeps
+ * until a touch or the next task of the app, and resumes at the full rate
+ * on the first touch. */
+#define MY_USE_IDLE             0
+#if MY_USE_IDLE
+#  define MY_IDLE_TIME              3000
+
+/* Blank the framebuffer (FBIOBLANK) after this many ms without input. 0: never */
+#  define MY_IDLE_BLANK_TIME        60000
+#endif  /*MY_USE_IDLE*/
+
+/* 1: Give every pass of the main loop a time budget. In a pass over it the tasks with
+ * MY_TASK_BUDGET_DEFER_PRIO or lower priority are put off to the next pass, and a refresh
+ * renders only the invalid areas which fit in the rest of the budget (the others in the
+ * next pass). The input tasks also run between the tasks and the flushes when they are due.
+ * The overruns are printed to stderr with the longest task. */
+#define MY_USE_TASK_BUDGET      0
+#if MY_USE_TASK_BUDGET
+#  define MY_TASK_BUDGET_MS         12
+#  define MY_TASK_BUDGET_DEFER_PRIO LV_TASK_PRIO_LOW
+#  define MY_TASK_BUDGET_DEFER_MAX  8       /* Put off a task in at most this many passes in a row */
+#  define MY_TASK_BUDGET_MAX_TASKS  32
+#  define MY_TASK_BUDGET_LOG_PERIOD 1000    /* Print at most one overrun this often [ms], 0: never */
+#endif  /*MY_USE_TASK_BUDGET*/
+
+/* 1: Record the input events, `lv_task_handler()` passes, frames, flushes and flips
+ * into per-thread ring buffers. `kill -USR1 <pid>` writes them to MY_TRACE_FILE
+ * in Chrome trace format (chrome://tracing or ui.perfetto.dev). */
+#define MY_USE_TRACE            0
+#if MY_USE_TRACE
+/* Events per thread. Must be a power of 2 */
+#  define MY_TRACE_RING_SIZE        4096
+#  define MY_TRACE_FILE             "/tmp/lvgl-trace.json"
+
+/* Print and flag the frames longer than this many ms */
+#  define MY_TRACE_JANK_TIME        33
+#endif  /*MY_USE_TRACE*/
+
+/* 1: Serve the screen over RFB (VNC) from the flushed areas.
+ * Only the changed areas are sent (Hextile or Raw) from a separate thread,
+ * and the client's pointer works like the touchpad.
+ * There is no authentication: keep it on the loopback and tunnel it (e.g. `ssh -L 5900:localhost:5900`). */
+#define MY_USE_VNC              0
+#if MY_USE_VNC
+#  define MY_VNC_ADDR               "127.0.0.1"
+#  define MY_VNC_PORT               5900
+#  define MY_VNC_NAME               "lvgl"
+#endif  /*MY_USE_VNC*/
+
+/* 1: Keep a copy of the screen for screenshots (`my_capture_screenshot()`, QOI or PNG)
+ * and for a continuous capture of the changed tiles (`my_capture_start()`).
+ * The images are encoded on a separate thread. `kill -USR2 <pid>` writes a screenshot to MY_CAPTURE_FILE. */
+#define MY_USE_CAPTURE          0
+#if MY_USE_CAPTURE
+#  define MY_CAPTURE_FILE           "/tmp/lvgl-screenshot.qoi"
+#endif  /*MY_USE_CAPTURE*/
+
+/*====================
+   Thread settings
+ *====================*/
+
+/* 1: Let other threads change the UI by posting commands (e.g. `my_cmd_label_set_text()`).
+ * The queue is lock-free and drained by the main loop once per frame; repeated changes
+ * of the same property are coalesced, only the latest value is applied. */
+#define MY_USE_CMD_QUEUE        0
+#if MY_USE_CMD_QUEUE
+#  define MY_CMD_QUEUE_SIZE         256     /* Commands, a power of 2 */
+#  define MY_CMD_TEXT_LEN           64      /* Longest text of a command, with the closing '\0' */
+#endif  /*MY_USE_CMD_QUEUE*/
+
+/* 1: Set the scheduling policy, priority and CPUs of the port's threads and lock the memory.
+ * A setting is "policy[:priority[:cpus]]" with `fifo`, `rr` or `other`, e.g. "fifo:50:2-3".
+ * MY_SCHED_CONF_FILE overrides them with lines like `render = fifo:50:2` or `mlock = 1`,
+ * and the environment overrides both (`LV_PORT_SCHED_RENDER`, `LV_PORT_MLOCK`, ...).
+ * The real-time policies need root or CAP_SYS_NICE. `my_sched_print_stats()` shows
+ * the scheduling latency histogram of every thread. */
+#define MY_USE_SCHED            0
+#if MY_USE_SCHED
+#  define MY_SCHED_RENDER           "fifo:50"   /* The main loop: input, LVGL tasks, rendering */
+#  define MY_SCHED_FLUSH            "fifo:50"   /* MY_USE_FLUSH_WORKERS */
+#  define MY_SCHED_VBLANK           "fifo:60"   /* The vblank thread of MY_USE_VSYNC */
+#  define MY_SCHED_BACKGROUND       "other"     /* Image decoders, capture, VNC */
+#  define MY_SCHED_MLOCK            0           /* 1: `mlockall()` */
+#  define MY_SCHED_CONF_FILE        "/etc/lv_port_sched.conf"
+#  define MY_SCHED_MAX_THREADS      32
+#endif  /*MY_USE_SCHED*/
+
+/*====================
+   Input settings
+ *====================*/
+
+/* 1: Timestamp the touch events on CLOCK_MONOTONIC in the kernel (EVIOCSCLOCKID) and report
+ * the position to LVGL at evenly spaced times, interpolated between the timestamped samples.
+ * LVGL computes the drag throw and the gestures from the movement per read, so the late
+ * reads and the processing delay of the events don't distort the velocity. */
+#define MY_USE_INPUT_TIMESTAMPS 0
+#if MY_USE_INPUT_TIMESTAMPS
+#  define MY_INPUT_HISTORY          16      /* Samples kept */
+
+/* Report the position this far behind the clock [us]. More: interpolated more often, less: lower latency */
+#  define MY_INPUT_DELAY_US         8000
+
+/* Extrapolate at most this far after the newest sample [us] */
+#  define MY_INPUT_PREDICT_MAX_US   16000
+
+/* Fit the velocity to the samples of this long [us] */
+#  define MY_INPUT_VELOCITY_WINDOW_US 40000
+#endif  /*MY_USE_INPUT_TIMESTAMPS*/
+
+/*====================
+   Startup settings
+ *====================*/
+
+/* 1: Print the duration of each startup phase up to the first frame */
+#define MY_USE_BOOT_TIMING      0
+
+/* 1: Don't clear the framebuffer in `my_fb_init()` if LV_HOR_RES_MAX x LV_VER_RES_MAX
+ * is the panel's resolution, LVGL redraws the whole screen in the first frame anyway. Render the first frame as soon as the app is created
+ * instead of waiting for the first refresh period. */
+#define MY_FAST_STARTUP         0
+
+/* 1: Keep the content of the framebuffer (e.g. the splash image of the bootloader)
+ * until LVGL's first frame replaces it */
+#define MY_FB_KEEP_SPLASH       0
+#if MY_FB_KEEP_SPLASH
+/* Cross-fade from the splash to the app in this many ms.
+ * 0: no fade, the first frame simply overwrites the splash */
+#  define MY_SPLASH_FADE_TIME       500
+
+/* Keep showing the splash this many ms before the fade.
+ * The frames of this period are not flushed, they would only rewrite the splash. */
+#  define MY_SPLASH_FADE_DELAY      300
+#endif  /*MY_FB_KEEP_SPLASH*/
+
+/*=========================
+   Memory manager settings
+ *=========================*/
+
+/* The pooled allocator (`my_mem_alloc`) is used if `MY_USE_MEM` is 1 in lv_conf.h.
+ * Blocks up to 2 kB come from size-class slabs, which are carved from pages of this size */
+#define MY_MEM_SLAB_PAGE_SIZE   (64 * 1024)
+
+/* Larger blocks come from an arena of this size. Only the touched pages use RAM,
+ * unless MY_USE_LOCKED_MEM locks all of it. If the arena is full, `malloc` is used. */
+#define MY_MEM_ARENA_SIZE       (16 * 1024 * 1024)
+
+/* 1: Back the draw buffers with huge pages and lock them into RAM at startup.
+ * With `MY_USE_MEM` 1 the arena (decoded images, font caches, ...) is locked too and all of
+ * MY_MEM_ARENA_SIZE (16 MB) is resident from the start; with `MY_USE_MEM` 0 only the draw
+ * buffers are locked, LVGL's heap isn't.
+ * Redraws then never wait for page faults. Needs CAP_IPC_LOCK or a big enough RLIMIT_MEMLOCK. */
+#define MY_USE_LOCKED_MEM       0
+#if MY_USE_LOCKED_MEM
+/* 1: Try hugetlb pages first (reserve them in /proc/sys/vm/nr_hugepages).
+ * Transparent huge pages are used if they are not available. */
+#  define MY_LOCKED_MEM_HUGETLB     1
+#endif  /*MY_USE_LOCKED_MEM*/
+
+/*========================
+ * Image decoder and cache
+ *========================*/
+
+/* 1: Keep decoded images (files, PNG, JPG, ...) in the LVGL heap between screens.
+ * Images are keyed by source and size, stored in the framebuffer's pixel format
+ * and evicted least recently used first. */
+#define MY_USE_IMG_CACHE        0
+#if MY_USE_IMG_CACHE
+/* Memory budget of the cached pixels in bytes */
+#  define MY_IMG_CACHE_SIZE         (4 * 1024 * 1024)
+
+/* Decode the missing images on this many threads, 0: decode them while drawing.
+ * A placeholder is drawn until an image is decoded, then only its image objects are redrawn.
+ * Needs LV_MEM_CUSTOM (MY_USE_MEM or malloc) and reentrant image decoders and file system drivers. */
+#  define MY_IMG_CACHE_WORKER_CNT   0
+#  if MY_IMG_CACHE_WORKER_CNT
+#    define MY_IMG_CACHE_PLACEHOLDER_COLOR  0x808080
+#    define MY_IMG_CACHE_PLACEHOLDER_OPA    LV_OPA_30
+/* Check for decoded images this often [ms] */
+#    define MY_IMG_CACHE_DONE_PERIOD        10
+#  endif
+#endif  /*MY_USE_IMG_CACHE*/
+
+/*=================
+ *  File system
+ *=================*/
+
+/* 1: Register a read-only LVGL file system driver which maps the files with `mmap`.
+ * Only the pages of a file which are actually read are loaded from the disk.
+ * Paths with ".." are rejected, the drive can't leave MY_FS_ROOT. */
+#define MY_USE_FS               0
+#if MY_USE_FS
+/* Drive letter of the driver, e.g. "M:img/logo.bin" */
+#  define MY_FS_LETTER              'M'
+
+/* Directory on the host file system which is the root of the drive */
+#  define MY_FS_ROOT                "/usr/share/lvgl"
+
+/* Files up to this size are read ahead when opened (MADV_WILLNEED),
+ * larger ones are marked as read sequentially (MADV_SEQUENTIAL) */
+#  define MY_FS_WILLNEED_MAX        (256 * 1024)
+
+/* 1: Draw LVGL's true color binary images of the drive straight from the mapping */
+#  define MY_FS_IMG_DECODER         0
+
+/* 1: Register a read() based driver too and print the throughput of both
+ * for MY_FS_BENCH_FILE at startup */
+#  define MY_FS_BENCH               0
+#  if MY_FS_BENCH
+#    define MY_FS_BENCH_LETTER      'R'
+#    define MY_FS_BENCH_FILE        "img/bench.bin"
+#    define MY_FS_BENCH_LOOPS       10
+#  endif
+#endif  /*MY_USE_FS*/
+
+/*==================
+ *    FONT USAGE
+ *===================*/
+
+/* 1: Load the fonts which are not compiled in (see lv_conf.h) from files
+ * on first use with `my_font_get()`.
+ * `lv_font_load()` copies the whole font to the LVGL heap, so a loaded font takes as much RAM
+ * as a compiled in one. It saves binary size and the fonts which are never used, not RAM. */
+#define MY_USE_FONT_LOADER      0
+#if MY_USE_FONT_LOADER
+/* Directory of the font files created with `lv_font_conv --format bin`.
+ * The files have to be installed there, the M: drive needs MY_USE_FS. */
+#  define MY_FONT_PATH              "M:fonts/"
+#endif  /*MY_USE_FONT_LOADER*/
+
+/* 1: Cache the decompressed glyph bitmaps of the compressed and theme fonts as 8 bpp maps.
+ * Other fonts can be added with `my_glyph_cache_add_font()` */
+#define MY_USE_GLYPH_CACHE      0
+#if MY_USE_GLYPH_CACHE
+/* Number of glyphs in the table. Must be a power of 2 */
+#  define MY_GLYPH_CACHE_SLOTS      1024
+
+/* Memory budget of the cached bitmaps in bytes. They are in the LVGL heap (LV_MEM_SIZE
+ * with the built-in allocator), leave room there for the objects and styles */
+#  define MY_GLYPH_CACHE_SIZE       (48 * 1024)
+#endif  /*MY_USE_GLYPH_CACHE*/
+
+#endif /*MY_PORT_CONF_H*/
+
+#endif /*End of "Content enable"*/
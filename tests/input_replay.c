@@ -0,0 +1,169 @@
+/**
+ * @file input_replay.c
+ * Replay a synthetic touch stream through my_input.c on the host
+ *
+ * A finger moves at a constant velocity. The kernel timestamps of the
+ * samples jitter a little around the sampling period, the reads of LVGL
+ * come late by a random amount and the lateness adds up, like the runs of
+ * an LVGL task. LVGL computes the drag throw from the movement of
+ * `data.point` per read, so that must stay even anyway: no read may move
+ * much more or less than the average. The velocity of the touch is checked
+ * too.
+ *
+ * Built and run by `make test` with the host compiler.
+ */
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "my_port_conf.h"
+
+/* Test the module even if it's disabled in the configuration */
+#if MY_USE_INPUT_TIMESTAMPS == 0
+#undef MY_USE_INPUT_TIMESTAMPS
+#define MY_USE_INPUT_TIMESTAMPS     1
+#define MY_INPUT_HISTORY            16
+#define MY_INPUT_DELAY_US           8000
+#define MY_INPUT_PREDICT_MAX_US     16000
+#define MY_INPUT_VELOCITY_WINDOW_US 40000
+#endif
+
+/* The module reads the clock of the replay */
+static int replay_clock_gettime(clockid_t clk, struct timespec *ts);
+#define clock_gettime replay_clock_gettime
+
+#include "my_port/my_input.c"
+
+#undef clock_gettime
+
+/*********************
+ *      DEFINES
+ *********************/
+#define VELOCITY            1000    /* px/s along x */
+#define SAMPLE_PERIOD_US    8000    /* 125 Hz touch controller */
+#define SAMPLE_JITTER_US    1000    /* +- on the kernel timestamps */
+#define READ_LATE_MAX_US    15000   /* The task handler is late by up to this */
+#define DURATION_US         2000000
+#define WARMUP_US           100000  /* Fill the velocity window first */
+
+/* The bounds checked */
+#define VELOCITY_MEAN_TOL   (VELOCITY / 50)     /* px/s */
+#define VELOCITY_SD_MAX     (VELOCITY / 25)     /* px/s */
+#define STEP_SD_MAX         3.0                 /* px, of ~37 px per read */
+#define STEP_DEV_MAX        8.0                 /* px, from the average movement per read */
+
+/**********************
+ *  STATIC VARIABLES
+ **********************/
+static uint64_t now_us;
+
+/**********************
+ *   GLOBAL FUNCTIONS
+ **********************/
+
+int main(void)
+{
+	lv_indev_drv_t drv = {0};
+	lv_indev_data_t data = {0};
+	struct input_event ev = {0};
+	uint64_t start_us = 1000000;
+	uint64_t next_sample_us = start_us;
+	uint64_t next_read_us = start_us;
+	double v_sum = 0, v_sq = 0;
+	uint32_t v_cnt = 0;
+	double v_mean, v_sd;
+	lv_point_t v;
+	static double steps[DURATION_US / (LV_INDEV_DEF_READ_PERIOD * 1000) + 1];
+	uint32_t step_cnt = 0;
+	lv_coord_t last_x = 0;
+	bool have_last = false;
+	double step_mean = 0, step_sd = 0, step_dev = 0;
+	uint32_t i;
+	int fail = 0;
+
+	srand(1);
+
+	/* No read task: LV_INDEV_DEF_READ_PERIOD is used */
+	drv.read_task = NULL;
+
+	while(next_read_us < start_us + DURATION_US) {
+		/* The samples which happened until the read, with their jittered timestamps */
+		while(next_sample_us <= next_read_us) {
+			uint64_t t = next_sample_us + rand() % (2 * SAMPLE_JITTER_US + 1) - SAMPLE_JITTER_US;
+
+			ev.input_event_sec = t / 1000000;
+			ev.input_event_usec = t % 1000000;
+			my_input_sample(&ev, (lv_coord_t)(((int64_t)t - (int64_t)start_us) * VELOCITY / 1000000), 100, true);
+			next_sample_us += SAMPLE_PERIOD_US;
+		}
+
+		now_us = next_read_us;
+		my_input_read(&drv, &data);
+
+		if(now_us - start_us >= WARMUP_US) {
+			my_input_get_velocity(&v);
+			v_sum += v.x;
+			v_sq += (double)v.x * v.x;
+			v_cnt++;
+
+			/* The movement LVGL sees */
+			if(have_last) steps[step_cnt++] = data.point.x - last_x;
+			last_x = data.point.x;
+			have_last = true;
+		}
+
+		next_read_us += LV_INDEV_DEF_READ_PERIOD * 1000 + rand() % (READ_LATE_MAX_US + 1);
+	}
+
+	v_mean = v_sum / v_cnt;
+	v_sd = sqrt(v_sq / v_cnt - v_mean * v_mean);
+
+	for(i = 0; i < step_cnt; i++) step_mean += steps[i];
+	step_mean /= step_cnt;
+	for(i = 0; i < step_cnt; i++) {
+		step_sd += (steps[i] - step_mean) * (steps[i] - step_mean);
+		step_dev = LV_MATH_MAX(step_dev, fabs(steps[i] - step_mean));
+	}
+	step_sd = sqrt(step_sd / step_cnt);
+
+	printf("input_replay: velocity %.1f +- %.1f px/s (%u reads), per read %.1f +- %.2f px (max dev %.1f px)\n",
+			v_mean, v_sd, v_cnt, step_mean, step_sd, step_dev);
+
+	if(fabs(v_mean - VELOCITY) > VELOCITY_MEAN_TOL) {
+		printf("input_replay: FAIL: mean velocity is off by more than %d px/s\n", VELOCITY_MEAN_TOL);
+		fail = 1;
+	}
+	if(v_sd > VELOCITY_SD_MAX) {
+		printf("input_replay: FAIL: velocity deviation is over %d px/s\n", VELOCITY_SD_MAX);
+		fail = 1;
+	}
+	if(step_sd > STEP_SD_MAX) {
+		printf("input_replay: FAIL: movement per read deviation is over %.1f px\n", STEP_SD_MAX);
+		fail = 1;
+	}
+	if(step_dev > STEP_DEV_MAX) {
+		printf("input_replay: FAIL: a read moved %.1f px off the average\n", step_dev);
+		fail = 1;
+	}
+
+	return fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**********************
+ *   STATIC FUNCTIONS
+ **********************/
+
+static int replay_clock_gettime(clockid_t clk, struct timespec *ts)
+{
+	(void)clk;
+
+	ts->tv_sec = now_us / 1000000;
+	ts->tv_nsec = (now_us % 1000000) * 1000;
+
+	return 0;
+}